@@ -0,0 +1,224 @@
+#include "../src/image_filters.h"
+#include "../src/planar_image.h"
+#include "../src/remap.h"
+#include "../src/simd.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Size {
+    const char *name;
+    int width, height;
+};
+
+const Size kSizes[] = {
+    {"thumbnail", 256, 256},
+    {"1mp", 1024, 1024},
+    {"12mp", 4000, 3000},
+    {"100mp", 10000, 10000},
+};
+
+struct Result {
+    std::string name;
+    const Size *size;
+    std::vector<double> ms;
+};
+
+// Плавный градиент с шумом: сжимается примерно как фотография, а не как заливка.
+Image makeSynthetic(int width, int height) {
+    Image img(width, height);
+    parallelForEachPixel(img, [](Pixel &p, int x, int y) {
+        std::uint32_t h = static_cast<std::uint32_t>(x) * 0x9E3779B1u ^ static_cast<std::uint32_t>(y) * 0x85EBCA77u;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        int noise = static_cast<int>(h & 15) - 8;
+        p = Pixel{static_cast<std::uint8_t>(std::clamp((x >> 2) + noise, 0, 255)),
+                  static_cast<std::uint8_t>(std::clamp((y >> 2) + noise, 0, 255)),
+                  static_cast<std::uint8_t>(std::clamp(((x + y) >> 3) - noise, 0, 255)), 255};
+    });
+    return img;
+}
+
+double percentile(std::vector<double> values, double q) {
+    std::sort(values.begin(), values.end());
+    std::size_t rank = static_cast<std::size_t>(std::ceil(q * values.size()));
+    return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+}
+
+/// Вызывает prepare() вне замера и run() под замером warmup + repeats раз.
+std::vector<double> measure(int warmup, int repeats, const std::function<void()> &prepare,
+                            const std::function<void()> &run) {
+    std::vector<double> ms;
+    for (int i = 0; i < warmup + repeats; ++i) {
+        prepare();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (i >= warmup)
+            ms.push_back(elapsed);
+    }
+    return ms;
+}
+
+void writeJson(std::ostream &out, const std::vector<Result> &results, int warmup, int repeats) {
+    out << "{\n  \"simd\": \"" << simdLevelName(activeSimdLevel()) << "\",\n  \"threads\": " << getThreadCount()
+        << ",\n  \"warmup\": " << warmup << ",\n  \"repeats\": " << repeats << ",\n  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        double megapixels = static_cast<double>(r.size->width) * r.size->height / 1e6;
+        double median = percentile(r.ms, 0.5);
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\", \"size\": \"" << r.size->name
+            << "\", \"width\": " << r.size->width << ", \"height\": " << r.size->height
+            << ", \"median_ms\": " << median << ", \"p95_ms\": " << percentile(r.ms, 0.95)
+            << ", \"mp_per_s\": " << megapixels / (median / 1000.0) << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int warmup = 1;
+    int repeats = 5;
+    double maxMegapixels = 100;
+    std::string filter;
+    std::string outputFile;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            setThreadCount(std::atoi(argv[++i]));
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmup = std::max(std::atoi(argv[++i]), 0);
+        } else if (arg == "--repeats" && i + 1 < argc) {
+            repeats = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--max-mp" && i + 1 < argc) {
+            maxMegapixels = std::atof(argv[++i]);
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else {
+            std::cerr << "Использование: " << argv[0]
+                      << " [--threads N] [--warmup N] [--repeats N] [--max-mp N] [--filter NAME] [--json FILE]\n";
+            return 1;
+        }
+    }
+
+    struct Case {
+        const char *name;
+        std::function<void(Image &)> apply;
+    };
+    const std::vector<Case> cases = {
+        {"solar", [](Image &img) { applySolarRays(img); }},
+        {"wave", [](Image &img) { applyWaveDistortion(img, 10.0f); }},
+        {"noise", [](Image &img) { applyColorNoise(img, 0.1f, 1); }},
+        {"glitch", [](Image &img) { applyGlitch(img, 1); }},
+        {"grayscale", [](Image &img) { applyGrayscale(img); }},
+    };
+    struct PlanarCase {
+        const char *name;
+        std::function<void(PlanarImage &)> apply;
+    };
+    const std::vector<PlanarCase> planarCases = {
+        {"planar_solar", [](PlanarImage &img) { applySolarRays(img); }},
+        {"planar_wave", [](PlanarImage &img) { applyWaveDistortion(img, 10.0f); }},
+        {"planar_noise", [](PlanarImage &img) { applyColorNoise(img, 0.1f, 1); }},
+        {"planar_glitch", [](PlanarImage &img) { applyGlitch(img, 1); }},
+        {"planar_grayscale", [](PlanarImage &img) { applyGrayscale(img); }},
+    };
+    auto selected = [&filter](const std::string &name) {
+        return filter.empty() || filter == name;
+    };
+
+    fs::path scratch = fs::temp_directory_path() / "image_filters_bench.png";
+    std::vector<Result> results;
+    for (const Size &size : kSizes) {
+        if (static_cast<double>(size.width) * size.height / 1e6 > maxMegapixels)
+            continue;
+        std::cerr << size.name << " (" << size.width << "x" << size.height << ")\n";
+        const Image source = makeSynthetic(size.width, size.height);
+        Image work;
+
+        for (const Case &c : cases) {
+            if (!selected(c.name))
+                continue;
+            results.push_back({c.name, &size,
+                               measure(warmup, repeats, [&] { work = source; }, [&] { c.apply(work); })});
+        }
+
+        if (selected("remap_bilinear")) {
+            // Плотное поле с большим reach: плитки по копии источника и билинейная выборка.
+            const DisplacementField swirl = swirlField(size.width, size.height, 2.0f);
+            const RemapOptions options{SampleMode::Bilinear, EdgeMode::Clamp};
+            results.push_back({"remap_bilinear", &size, measure(warmup, repeats, [&] { work = source; },
+                                                                [&] { remap(work, swirl, options); })});
+        }
+
+        const PlanarImage planarSource(source);
+        PlanarImage planarWork;
+        for (const PlanarCase &c : planarCases) {
+            if (!selected(c.name))
+                continue;
+            results.push_back({c.name, &size, measure(warmup, repeats, [&] { planarWork = planarSource; },
+                                                      [&] { c.apply(planarWork); })});
+        }
+        if (selected("deinterleave"))
+            results.push_back({"deinterleave", &size, measure(warmup, repeats, [] {}, [&] { planarWork.assign(source); })});
+        if (selected("interleave"))
+            results.push_back({"interleave", &size, measure(warmup, repeats, [] {}, [&] { planarSource.copyTo(work); })});
+
+        bool saved = true;
+        if (selected("save"))
+            results.push_back({"save", &size, measure(warmup, repeats, [] {}, [&] {
+                                   saved = source.save(scratch.string()) && saved;
+                               })});
+        if (selected("save_fast"))
+            results.push_back({"save_fast", &size, measure(warmup, repeats, [] {}, [&] {
+                                   saved = source.save(scratch.string(), SaveOptions::fast()) && saved;
+                               })});
+        if (selected("save_gray_reduce")) {
+            // Типичный результат applyGrayscale: RGBA с R == G == B и непрозрачной альфой.
+            Image gray = source;
+            applyGrayscale(gray);
+            SaveOptions options;
+            options.reduceFormat = true;
+            results.push_back({"save_gray_reduce", &size, measure(warmup, repeats, [] {}, [&] {
+                                   saved = gray.save(scratch.string(), options) && saved;
+                               })});
+        }
+        if (selected("load")) {
+            saved = source.save(scratch.string()) && saved;
+            results.push_back({"load", &size, measure(warmup, repeats, [] {}, [&] {
+                                   saved = work.load(scratch.string()) && saved;
+                               })});
+        }
+        if (!saved) {
+            std::cerr << "Ошибка: не удалось записать или прочитать " << scratch << "\n";
+            return 1;
+        }
+    }
+    std::error_code ignored;
+    fs::remove(scratch, ignored);
+
+    if (outputFile.empty()) {
+        writeJson(std::cout, results, warmup, repeats);
+        return 0;
+    }
+    std::ofstream out(outputFile);
+    writeJson(out, results, warmup, repeats);
+    return out ? 0 : 1;
+}
@@ -1,12 +1,248 @@
+#include "src/batch.h"
+#include "src/filter_pipeline.h"
+#include "src/frame_sequence.h"
 #include "src/image_filters.h"
+#include "src/planar_image.h"
+#include "src/png_stream.h"
+#include "src/result_cache.h"
+#include "src/server.h"
+#include "src/stats.h"
+#include "src/tiled_image.h"
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <random>
 #include <string>
 
 namespace fs = std::filesystem;
 
-int main() {
+static std::atomic<bool> stopServer{false};
+
+static void requestStop(int) { stopServer = true; }
+
+// Разбирает область в виде X,Y,W,H.
+static bool parseRegion(const std::string &text, Region &region) {
+    char tail = 0;
+    return std::sscanf(text.c_str(), "%d,%d,%d,%d%c", &region.x, &region.y, &region.width, &region.height, &tail) ==
+               4 &&
+           !region.empty();
+}
+
+int main(int argc, char *argv[]) {
+    FilterParams params;
+    params.seed = std::random_device{}();
+    bool stream = false;
+    std::string chainSpec;
+    BatchOptions batch;
+    bool batchMode = false;
+    bool stats = false;
+    bool tiled = false;
+    bool planar = false;
+    TiledOptions tiledOptions;
+    std::string servePath;
+    ResultCacheOptions cacheOptions;
+    SequenceOptions sequence;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            setThreadCount(std::atoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            params.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "--chain" && i + 1 < argc) {
+            chainSpec = argv[++i];
+        } else if ((arg == "--input" || arg == "--list") && i + 1 < argc) {
+            batchMode = true;
+            if (!collectInputs(argv[++i], batch.inputs)) {
+                std::cerr << "Ошибка: не удалось прочитать " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--sequence" && i + 1 < argc) {
+            sequence.input = argv[++i];
+        } else if (arg == "--fps" && i + 1 < argc) {
+            int fps = std::atoi(argv[++i]);
+            if (fps <= 0 || fps > 1000) {
+                std::cerr << "Ошибка: неверная частота кадров " << argv[i] << "\n";
+                return 1;
+            }
+            sequence.timing = FrameTiming{1, static_cast<std::uint16_t>(fps)};
+        } else if (arg == "--loops" && i + 1 < argc) {
+            sequence.loops = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--vary-seed") {
+            sequence.varySeed = true;
+        } else if (arg == "--output" && i + 1 < argc) {
+            batch.outputDir = argv[++i];
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            batch.jobs = std::atoi(argv[++i]);
+        } else if (arg == "--png-level" && i + 1 < argc) {
+            batch.save.compressionLevel = std::atoi(argv[++i]);
+        } else if (arg == "--png-fast") {
+            batch.save = SaveOptions::fast();
+        } else if (arg == "--png-reduce") {
+            batch.save.reduceFormat = true;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--tiled") {
+            tiled = true;
+        } else if (arg == "--planar") {
+            planar = true;
+        } else if (arg == "--scratch" && i + 1 < argc) {
+            tiled = true;
+            tiledOptions.scratchDir = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            PixelFormat format;
+            if (!parsePixelFormat(argv[++i], format)) {
+                std::cerr << "Ошибка: неизвестный формат пикселей " << argv[i] << "\n";
+                return 1;
+            }
+            batch.load.format = format;
+        } else if (arg == "--serve" && i + 1 < argc) {
+            servePath = argv[++i];
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cacheOptions.directory = argv[++i];
+        } else if (arg == "--cache-size" && i + 1 < argc) {
+            cacheOptions.maxBytes = std::strtoull(argv[++i], nullptr, 10) << 20;
+        } else if ((arg == "--crop" || arg == "--roi") && i + 1 < argc) {
+            Region region;
+            if (!parseRegion(argv[++i], region)) {
+                std::cerr << "Ошибка: неверная область " << argv[i] << "\n";
+                return 1;
+            }
+            if (arg == "--crop")
+                batch.load.crop = region;
+            else
+                batch.region = region;
+        } else {
+            std::cerr << "Использование: " << argv[0] << " [--threads N] [--seed N] [--stream | --tiled [--scratch DIR] | --planar]\n"
+                      << "       [--chain SPEC] [--png-level N | --png-fast] [--png-reduce] [--format F]\n"
+                      << "       [--crop X,Y,W,H] [--roi X,Y,W,H] [--stats]\n"
+                      << "       " << argv[0]
+                      << " --input DIR | --list FILE --output DIR --chain SPEC [--jobs N] [--threads N] [--seed N]\n"
+                      << "       [--png-level N | --png-fast] [--png-reduce] [--format F] [--crop X,Y,W,H] [--roi X,Y,W,H]\n"
+                      << "       [--cache DIR [--cache-size MB]] [--stats]\n"
+                      << "       " << argv[0]
+                      << " --serve SOCKET | - [--threads N] [--seed N] [--png-level N | --png-fast] [--png-reduce]\n"
+                      << "       [--format F] [--crop X,Y,W,H] [--cache DIR [--cache-size MB]] [--stats]\n"
+                      << "       " << argv[0]
+                      << " --sequence APNG | DIR --output OUT.png | DIR --chain SPEC [--fps N] [--loops N] [--vary-seed]\n"
+                      << "       [--threads N] [--seed N] [--png-level N | --png-fast] [--stats]\n"
+                      << "SPEC: фильтры через запятую, например grayscale,noise:0.3:seed=7,solar,wave:15,glitch\n"
+                      << "F: формат пикселей g8, ga8, rgb8, rgba8, g16 или rgba16; по умолчанию формат файла\n"
+                      << "--crop: загрузить только область (строки ниже неё не распаковываются)\n"
+                      << "--roi: применить фильтры только к области; с --stream и --tiled не используются\n"
+                      << "--cache: хранить результаты в каталоге и отдавать повторные без обработки (по умолчанию до 1024 МБ)\n"
+                      << "--planar: обрабатывать каналы RGBA8 в отдельных плоскостях (см. src/planar_image.h)\n"
+                      << "--sequence: обработать кадры APNG или каталога с пронумерованными PNG и записать APNG\n"
+                      << "            (OUT.png) или каталог кадров; --fps и --loops задают анимацию для кадров из каталога\n"
+                      << "--serve: обслуживать запросы через Unix-сокет или stdin/stdout (-), см. src/server.h\n";
+            return 1;
+        }
+    }
+
+    if ((stream || tiled) && (batch.load.crop || batch.region)) {
+        std::cerr << "Ошибка: --crop и --roi не поддерживаются с --stream и --tiled\n";
+        return 1;
+    }
+    if (stream && (batch.save.reduceFormat || batch.load.format)) {
+        std::cerr << "Ошибка: --png-reduce и --format не поддерживаются с --stream\n";
+        return 1;
+    }
+    if (planar && (stream || tiled || batch.region)) {
+        std::cerr << "Ошибка: --planar не используется с --stream, --tiled и --roi\n";
+        return 1;
+    }
+
+    FilterPipeline pipeline;
+    if (!chainSpec.empty() && !FilterPipeline::parse(chainSpec, pipeline, params.seed)) {
+        std::cerr << "Ошибка: неверное описание цепочки фильтров: " << chainSpec << "\n";
+        return 1;
+    }
+
+    std::optional<ResultCache> cache;
+    if (!cacheOptions.directory.empty()) {
+        cache.emplace(cacheOptions);
+        if (!cache->isOpen()) {
+            std::cerr << "Ошибка: не удалось открыть каталог кеша " << cacheOptions.directory << "\n";
+            return 1;
+        }
+        batch.cache = &*cache;
+    }
+    auto printCacheStats = [&cache] {
+        if (!cache)
+            return;
+        ResultCacheStats counters = cache->stats();
+        std::cerr << "cache: hits " << counters.hits << ", misses " << counters.misses << ", stores " << counters.stores
+                  << ", evictions " << counters.evictions << ", " << counters.entries << " files, " << counters.bytes
+                  << " B\n";
+    };
+
+    if (!servePath.empty()) {
+        ServerOptions server;
+        server.save = batch.save;
+        server.load = batch.load;
+        server.seed = params.seed;
+        server.cache = batch.cache;
+        bool served = false;
+        if (servePath == "-") {
+            served = serveStream(0, 1, server);
+        } else {
+            std::signal(SIGINT, requestStop);
+            std::signal(SIGTERM, requestStop);
+            served = serveUnixSocket(servePath, server, &stopServer);
+        }
+        if (!served)
+            std::cerr << "Ошибка: сервер завершился с ошибкой\n";
+        if (stats) {
+            printStats(std::cerr);
+            printCacheStats();
+        }
+        return served ? 0 : 1;
+    }
+
+    if (!sequence.input.empty()) {
+        if (pipeline.empty() || batch.outputDir.empty()) {
+            std::cerr << "Ошибка: для обработки последовательности нужны --chain и --output\n";
+            return 1;
+        }
+        sequence.output = batch.outputDir;
+        sequence.pipeline = pipeline;
+        sequence.save = batch.save;
+        SequenceResult result = runSequence(sequence);
+        std::cout << "Обработано кадров: " << result.frames << ", время: " << result.seconds << " с\n"
+                  << "Производительность: " << result.framesPerSecond() << " кадр./с, "
+                  << result.megapixelsPerSecond() << " Мпикс/с\n";
+        if (!result.ok)
+            std::cerr << "Ошибка: не удалось обработать последовательность " << sequence.input << "\n";
+        if (stats)
+            printStats(std::cerr);
+        return result.ok ? 0 : 1;
+    }
+
+    if (batchMode) {
+        if (pipeline.empty() || batch.outputDir.empty()) {
+            std::cerr << "Ошибка: для пакетной обработки нужны --chain и --output\n";
+            return 1;
+        }
+        batch.pipeline = pipeline;
+        BatchResult result = runBatch(batch);
+        std::cout << "Обработано файлов: " << result.processed << ", ошибок: " << result.failed << ", время: "
+                  << result.seconds << " с\n"
+                  << "Производительность: " << result.imagesPerSecond() << " изобр./с, "
+                  << result.megapixelsPerSecond() << " Мпикс/с\n";
+        if (stats) {
+            printStats(std::cerr);
+            printCacheStats();
+        }
+        return result.failed == 0 ? 0 : 1;
+    }
+
     std::string inputFileName, outputFile;
     std::cout << "Введите название файла для обработки: ";
     std::getline(std::cin, inputFileName);
@@ -15,43 +251,60 @@ int main() {
         inputFileName = "input.png"; 
     }
 
+    std::string inputPath = fs::exists(inputFileName) ? inputFileName : "../" + inputFileName;
     Image image;
-    if (!image.load(inputFileName)) {
-        std::string rootPath = "../" + inputFileName;
-        if (!image.load(rootPath)) {
-            std::cerr << "Ошибка при загрузке изображения: файл " << inputFileName
-                      << " не найден ни в build, ни в корневой директории\n";
+    TiledImage tiledImage(tiledOptions);
+    bool loaded = stream                ? true
+                  : tiled               ? tiledImage.load(inputPath)
+                                        : image.load(inputPath, batch.load);
+    if (!fs::exists(inputPath) || !loaded) {
+        std::cerr << "Ошибка при загрузке изображения: файл " << inputFileName
+                  << " не найден ни в build, ни в корневой директории\n";
+        return 1;
+    }
+
+    if (pipeline.empty()) {
+        std::cout << "Выберите фильтр:\n1. Солнечные лучи\n2. Волны\n3. Цветовой шум\n4. Глитч\n5. Ч/Б\nВыбор: ";
+        int choice;
+        std::cin >> choice;
+        std::cin.ignore();
+
+        FilterType type;
+        switch (choice) {
+        case 1:
+            type = FilterType::SolarRays;
+            break;
+        case 2:
+            type = FilterType::WaveDistortion;
+            break;
+        case 3:
+            type = FilterType::ColorNoise;
+            break;
+        case 4:
+            type = FilterType::Glitch;
+            break;
+        case 5:
+            type = FilterType::Grayscale;
+            break;
+        default:
+            std::cerr << "Ошибка: неверный выбор фильтра\n";
             return 1;
         }
+        pipeline.add(type, params);
     }
 
-    std::cout << "Выберите фильтр:\n1. Солнечные лучи\n2. Волны\n3. Цветовой шум\n4. Глитч\n5. Ч/Б\nВыбор: ";
-    int choice;
-    std::cin >> choice;
-
-    switch (choice) {
-    case 1:
-        applySolarRays(image);
-        break;
-    case 2:
-        applyWaveDistortion(image);
-        break;
-    case 3:
-        applyColorNoise(image);
-        break;
-    case 4:
-        applyGlitch(image);
-        break;
-    case 5:
-        applyGrayscale(image);
-        break;
-    default:
-        std::cerr << "Ошибка: неверный выбор фильтра\n";
-        return 1;
-    }
+    if (tiled) {
+        applyPipeline(tiledImage, pipeline);
+    } else if (planar) {
+        PlanarImage planes(image);
+        applyPipeline(planes, pipeline);
+        planes.copyTo(image);
+    } else if (batch.region)
+        pipeline.apply(image, *batch.region);
+    else if (!stream)
+        pipeline.apply(image);
 
     std::cout << "Введите имя выходного файла: ";
-    std::cin.ignore(); 
     std::getline(std::cin, outputFile);
 
     if (outputFile.empty()) {
@@ -66,12 +319,17 @@ int main() {
 
     outputFile = outputDir + outputFile;
 
-    if (!image.save(outputFile)) {
+    bool saved = stream  ? streamFilter(inputPath, outputFile, pipeline, batch.save)
+                 : tiled ? tiledImage.save(outputFile, batch.save)
+                         : image.save(outputFile, batch.save);
+    if (!saved) {
         std::cerr << "Ошибка при сохранении изображения\n";
         return 1;
     }
 
     std::cout << "Обработанное изображение сохранено в " << outputFile << "\n";
+    if (stats)
+        printStats(std::cerr);
 
     return 0;
 }
@@ -0,0 +1,175 @@
+#include "batch.h"
+#include "bounded_queue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct BatchItem {
+    std::size_t index = 0;
+    Image image;
+    std::string cacheKey; ///< Ключ для записи результата в кеш; пуст без кеша.
+};
+
+} // namespace
+
+bool collectInputs(const std::string &path, std::vector<std::string> &inputs) {
+    std::error_code error;
+    if (fs::is_directory(path, error)) {
+        std::vector<std::string> found;
+        for (const fs::directory_entry &entry : fs::directory_iterator(path, error)) {
+            if (entry.is_regular_file(error) && entry.path().extension() == ".png")
+                found.push_back(entry.path().string());
+        }
+        if (error)
+            return false;
+        std::sort(found.begin(), found.end());
+        inputs.insert(inputs.end(), found.begin(), found.end());
+        return true;
+    }
+
+    std::ifstream list(path);
+    if (!list)
+        return false;
+    std::string line;
+    while (std::getline(list, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty())
+            inputs.push_back(line);
+    }
+    return true;
+}
+
+BatchResult runBatch(const BatchOptions &options) {
+    auto start = std::chrono::steady_clock::now();
+    BatchResult result;
+
+    std::error_code error;
+    fs::create_directories(options.outputDir, error);
+    if (!fs::is_directory(options.outputDir, error)) {
+        result.failed = options.inputs.size();
+        return result;
+    }
+
+    int jobs = options.jobs > 0 ? options.jobs : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::size_t depth = options.queueDepth ? options.queueDepth : static_cast<std::size_t>(2 * jobs);
+    BoundedQueue<BatchItem> decoded(depth);
+    BoundedQueue<BatchItem> filtered(depth);
+
+    std::atomic<std::size_t> nextInput{0};
+    std::atomic<int> decodersLeft{jobs};
+    std::atomic<std::size_t> processed{0};
+    std::atomic<std::size_t> failed{0};
+    std::atomic<std::uint64_t> pixels{0};
+
+    auto outputPath = [&options](std::size_t index) {
+        return fs::path(options.outputDir) / fs::path(options.inputs[index]).filename();
+    };
+
+    // Файлы с одинаковым именем из разных каталогов записывались бы в один путь
+    // одновременно из разных потоков записи, поэтому все они считаются ошибочными.
+    std::unordered_map<std::string, std::size_t> nameCounts;
+    for (const std::string &input : options.inputs)
+        ++nameCounts[fs::path(input).filename().string()];
+    std::vector<bool> conflicting(options.inputs.size());
+    for (std::size_t i = 0; i < options.inputs.size(); ++i)
+        conflicting[i] = nameCounts[fs::path(options.inputs[i]).filename().string()] > 1;
+
+    auto decode = [&] {
+        for (std::size_t i = nextInput++; i < options.inputs.size(); i = nextInput++) {
+            if (conflicting[i]) {
+                ++failed;
+                continue;
+            }
+            BatchItem item;
+            item.index = i;
+            if (options.cache) {
+                std::vector<std::uint8_t> input, cached;
+                if (!readFileBytes(options.inputs[i], input)) {
+                    ++failed;
+                    continue;
+                }
+                Span<const std::uint8_t> bytes(input.data(), input.size());
+                item.cacheKey = ResultCache::makeKey(bytes, options.pipeline, options.save, options.load, options.region);
+                if (options.cache->lookup(item.cacheKey, cached)) {
+                    bool written = writeFileBytes(outputPath(item.index).string(),
+                                                  Span<const std::uint8_t>(cached.data(), cached.size()));
+                    if (written)
+                        ++processed;
+                    else
+                        ++failed;
+                    continue;
+                }
+                if (!item.image.loadFromMemory(bytes, options.load)) {
+                    ++failed;
+                    continue;
+                }
+            } else if (!item.image.load(options.inputs[i], options.load)) {
+                ++failed;
+                continue;
+            }
+            decoded.push(std::move(item));
+        }
+        if (--decodersLeft == 0)
+            decoded.close();
+    };
+
+    auto filter = [&] {
+        BatchItem item;
+        while (decoded.pop(item)) {
+            if (options.region)
+                options.pipeline.apply(item.image, *options.region);
+            else
+                options.pipeline.apply(item.image);
+            filtered.push(std::move(item));
+        }
+        filtered.close();
+    };
+
+    auto encode = [&] {
+        BatchItem item;
+        std::vector<std::uint8_t> encoded;
+        while (filtered.pop(item)) {
+            bool saved;
+            if (item.cacheKey.empty()) {
+                saved = item.image.save(outputPath(item.index).string(), options.save);
+            } else {
+                saved = item.image.saveToBuffer(encoded, options.save);
+                Span<const std::uint8_t> bytes(encoded.data(), encoded.size());
+                saved = saved && writeFileBytes(outputPath(item.index).string(), bytes);
+                if (saved)
+                    options.cache->store(item.cacheKey, bytes);
+            }
+            if (saved) {
+                ++processed;
+                pixels += static_cast<std::uint64_t>(item.image.getWidth()) * item.image.getHeight();
+            } else {
+                ++failed;
+            }
+            item.image = Image();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < jobs; ++i)
+        threads.emplace_back(decode);
+    threads.emplace_back(filter);
+    for (int i = 0; i < jobs; ++i)
+        threads.emplace_back(encode);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    result.processed = processed;
+    result.failed = failed;
+    result.megapixels = pixels / 1e6;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
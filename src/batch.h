@@ -0,0 +1,85 @@
+#ifndef IMAGE_FILTERS_BATCH_H
+#define IMAGE_FILTERS_BATCH_H
+
+#include "filter_pipeline.h"
+#include "result_cache.h"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \brief Пакетная обработка множества файлов с перекрытием чтения, фильтрации и записи
+ */
+
+/**
+ * @brief Параметры пакетной обработки.
+ */
+struct BatchOptions {
+    std::vector<std::string> inputs; ///< Пути к исходным PNG-файлам.
+    std::string outputDir;           ///< Каталог для результатов; имена файлов сохраняются.
+    FilterPipeline pipeline;         ///< Цепочка фильтров.
+    int jobs = 0;                    ///< Число потоков чтения и число потоков записи; 0 — по числу ядер.
+    std::size_t queueDepth = 0;      ///< Ёмкость очередей между стадиями; 0 — 2 * jobs.
+    SaveOptions save;                ///< Параметры записи результатов.
+    LoadOptions load;                ///< Формат и область, с которыми загружаются исходные файлы.
+    std::optional<Region> region;    ///< Обрабатываемая область; без неё фильтруется всё изображение.
+    ResultCache *cache = nullptr;    ///< Кеш результатов: при попадании файл копируется без декодирования.
+};
+
+/**
+ * @brief Итоги пакетной обработки.
+ */
+struct BatchResult {
+    std::size_t processed = 0; ///< Число успешно обработанных файлов.
+    std::size_t failed = 0;    ///< Число файлов, которые не удалось прочитать или записать.
+    double seconds = 0.0;      ///< Общее время обработки в секундах.
+    double megapixels = 0.0;   ///< Суммарная площадь обработанных изображений в мегапикселях.
+
+    /**
+     * @brief Возвращает пропускную способность в изображениях в секунду.
+     *
+     * @return Изображений в секунду; 0, если время равно нулю.
+     */
+    double imagesPerSecond() const { return seconds > 0 ? processed / seconds : 0.0; }
+
+    /**
+     * @brief Возвращает пропускную способность в мегапикселях в секунду.
+     *
+     * @return Мегапикселей в секунду; 0, если время равно нулю.
+     */
+    double megapixelsPerSecond() const { return seconds > 0 ? megapixels / seconds : 0.0; }
+};
+
+/**
+ * @brief Собирает список входных файлов.
+ *
+ * Если путь указывает на каталог, возвращаются все файлы *.png в нём (без вложенных
+ * каталогов) в лексикографическом порядке. Иначе путь считается списком файлов:
+ * по одному пути в строке, пустые строки пропускаются.
+ *
+ * @param path Каталог или файл со списком.
+ * @param inputs Вектор, в который добавляются пути.
+ * @return true, если каталог или список удалось прочитать.
+ */
+bool collectInputs(const std::string &path, std::vector<std::string> &inputs);
+
+/**
+ * @brief Обрабатывает набор файлов конвейером из трёх стадий.
+ *
+ * Потоки чтения распаковывают PNG, одна стадия фильтрации применяет цепочку
+ * (распараллеливая каждое изображение в общем пуле), потоки записи сжимают и
+ * сохраняют результат. Стадии связаны ограниченными очередями, поэтому распаковка
+ * и сжатие zlib идут одновременно с фильтрацией других изображений.
+ *
+ * Результат записывается в outputDir под именем исходного файла. Входные файлы с
+ * совпадающими именами (например, a/x.png и b/x.png) не обрабатываются и
+ * учитываются в BatchResult::failed, чтобы не перезаписывать результаты друг друга.
+ *
+ * @param options Параметры обработки.
+ * @return Итоги обработки.
+ */
+BatchResult runBatch(const BatchOptions &options);
+
+#endif // IMAGE_FILTERS_BATCH_H
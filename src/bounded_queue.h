@@ -0,0 +1,87 @@
+#ifndef IMAGE_FILTERS_BOUNDED_QUEUE_H
+#define IMAGE_FILTERS_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/**
+ * \file
+ * \brief Ограниченная очередь для связи стадий конвейера
+ */
+
+/**
+ * @class BoundedQueue
+ * @brief Потокобезопасная очередь фиксированной ёмкости.
+ *
+ * push() ждёт, пока в очереди не появится место, pop() — пока не появится элемент.
+ * После close() новые элементы не принимаются, а pop() возвращает false, когда
+ * очередь опустеет. Ограничение ёмкости не даёт быстрой стадии накопить в памяти
+ * много изображений впереди медленной.
+ *
+ * @tparam T Тип элементов.
+ */
+template <typename T> class BoundedQueue {
+public:
+    /**
+     * @brief Создаёт очередь заданной ёмкости.
+     *
+     * @param capacity Максимальное число элементов, не меньше 1.
+     */
+    explicit BoundedQueue(std::size_t capacity) : limit(capacity ? capacity : 1) {}
+
+    /**
+     * @brief Добавляет элемент, ожидая свободного места.
+     *
+     * @param value Элемент.
+     * @return true, если элемент добавлен; false, если очередь закрыта.
+     */
+    bool push(T value) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < limit; });
+        if (closed)
+            return false;
+        items.push_back(std::move(value));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Извлекает элемент, ожидая его появления.
+     *
+     * @param value Переменная для извлечённого элемента.
+     * @return true, если элемент извлечён; false, если очередь закрыта и пуста.
+     */
+    bool pop(T &value) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        value = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Закрывает очередь и будит все ожидающие потоки.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::size_t limit;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    bool closed = false;
+};
+
+#endif // IMAGE_FILTERS_BOUNDED_QUEUE_H
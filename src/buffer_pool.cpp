@@ -0,0 +1,224 @@
+#include "buffer_pool.h"
+#include "stats.h"
+#include <array>
+#include <new>
+
+namespace {
+
+constexpr int kClassesPerDoubling = 4;
+
+/// Номер наименьшего класса, вмещающего bytes байтов.
+constexpr int sizeClassOf(std::size_t bytes) {
+    if (bytes <= BufferPool::kMinBlockBytes)
+        return 0;
+    int doubling = 0;
+    std::size_t base = BufferPool::kMinBlockBytes;
+    while (base * 2 < bytes) {
+        base *= 2;
+        ++doubling;
+    }
+    std::size_t step = base / kClassesPerDoubling;
+    return doubling * kClassesPerDoubling + static_cast<int>((bytes - base + step - 1) / step);
+}
+
+constexpr std::size_t classBytes(int sizeClass) {
+    std::size_t base = BufferPool::kMinBlockBytes << (sizeClass / kClassesPerDoubling);
+    return base + base / kClassesPerDoubling * (sizeClass % kClassesPerDoubling);
+}
+
+constexpr int kClassCount = sizeClassOf(BufferPool::kMaxPooledBytes) + 1;
+constexpr int kThreadClasses = sizeClassOf(BufferPool::kThreadCacheMaxBytes) + 1;
+
+static_assert(classBytes(sizeClassOf(1000)) >= 1000 && classBytes(sizeClassOf(1000) - 1) < 1000,
+              "size classes must round up to the nearest class");
+
+void *systemAllocate(std::size_t bytes) {
+    IMAGE_FILTERS_STAT_ADD("pool.miss", allocations, 1);
+    IMAGE_FILTERS_STAT_ADD("pool.miss", bytesOut, bytes);
+    return ::operator new(bytes, std::align_val_t(BufferPool::kAlignment));
+}
+
+void systemFree(void *block) noexcept { ::operator delete(block, std::align_val_t(BufferPool::kAlignment)); }
+
+thread_local bool threadCacheDestroyed = false;
+
+} // namespace
+
+/// Кеш свободных блоков одного потока: несколько блоков каждого малого класса.
+struct ThreadBlockCache {
+    static constexpr int kBlocksPerClass = 4;
+    static constexpr std::size_t kMaxBytes = 8u << 20;
+
+    ~ThreadBlockCache() {
+        flush();
+        threadCacheDestroyed = true;
+    }
+
+    void *take(int sizeClass) {
+        if (counts[sizeClass] == 0)
+            return nullptr;
+        bytes -= classBytes(sizeClass);
+        return blocks[sizeClass][--counts[sizeClass]];
+    }
+
+    bool put(void *block, int sizeClass) {
+        std::size_t size = classBytes(sizeClass);
+        if (counts[sizeClass] == kBlocksPerClass || bytes + size > kMaxBytes)
+            return false;
+        blocks[sizeClass][counts[sizeClass]++] = block;
+        bytes += size;
+        return true;
+    }
+
+    /// Передаёт все блоки в общий кеш.
+    void flush() noexcept {
+        BufferPool &pool = BufferPool::shared();
+        for (int c = 0; c < kThreadClasses; ++c) {
+            while (counts[c] > 0) {
+                pool.cached.fetch_sub(classBytes(c), std::memory_order_relaxed);
+                pool.releaseToShared(blocks[c][--counts[c]], c);
+            }
+        }
+        bytes = 0;
+    }
+
+    std::array<std::array<void *, kBlocksPerClass>, kThreadClasses> blocks{};
+    std::array<int, kThreadClasses> counts{};
+    std::size_t bytes = 0;
+};
+
+namespace {
+
+ThreadBlockCache *threadCache() {
+    if (threadCacheDestroyed)
+        return nullptr;
+    thread_local ThreadBlockCache cache;
+    return &cache;
+}
+
+} // namespace
+
+BufferPool::BufferPool() : freeBlocks(kClassCount) {}
+
+BufferPool &BufferPool::shared() {
+    // Не уничтожается: потоки возвращают блоки и после завершения main.
+    static BufferPool *pool = new BufferPool();
+    return *pool;
+}
+
+void *BufferPool::allocate(std::size_t bytes) {
+    if (bytes == 0)
+        return nullptr;
+    requests.fetch_add(1, std::memory_order_relaxed);
+    std::size_t size = bytes;
+    void *block = nullptr;
+    if (bytes <= kMaxPooledBytes) {
+        int sizeClass = sizeClassOf(bytes);
+        size = classBytes(sizeClass);
+        ThreadBlockCache *cache = sizeClass < kThreadClasses ? threadCache() : nullptr;
+        if (cache)
+            block = cache->take(sizeClass);
+        if (!block) {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<void *> &list = freeBlocks[sizeClass];
+            if (!list.empty()) {
+                block = list.back();
+                list.pop_back();
+            }
+        }
+    }
+    if (block) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        cached.fetch_sub(size, std::memory_order_relaxed);
+        inUse.fetch_add(size, std::memory_order_relaxed);
+        return block;
+    }
+
+    block = systemAllocate(size);
+    std::size_t held = inUse.fetch_add(size, std::memory_order_relaxed) + size + cached.load(std::memory_order_relaxed);
+    std::size_t peak = highWater.load(std::memory_order_relaxed);
+    while (held > peak && !highWater.compare_exchange_weak(peak, held, std::memory_order_relaxed)) {
+    }
+    return block;
+}
+
+void BufferPool::deallocate(void *block, std::size_t bytes) noexcept {
+    if (!block)
+        return;
+    if (bytes > kMaxPooledBytes) {
+        inUse.fetch_sub(bytes, std::memory_order_relaxed);
+        systemFree(block);
+        return;
+    }
+    int sizeClass = sizeClassOf(bytes);
+    std::size_t size = classBytes(sizeClass);
+    inUse.fetch_sub(size, std::memory_order_relaxed);
+    ThreadBlockCache *cache = sizeClass < kThreadClasses ? threadCache() : nullptr;
+    if (cache && cache->put(block, sizeClass)) {
+        cached.fetch_add(size, std::memory_order_relaxed);
+        return;
+    }
+    releaseToShared(block, sizeClass);
+}
+
+void BufferPool::releaseToShared(void *block, int sizeClass) noexcept {
+    std::size_t size = classBytes(sizeClass);
+    if (cached.load(std::memory_order_relaxed) + size <= cacheLimit.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        try {
+            freeBlocks[sizeClass].push_back(block);
+            cached.fetch_add(size, std::memory_order_relaxed);
+            return;
+        } catch (const std::bad_alloc &) {
+            // Список не удалось расширить: блок возвращается системе.
+        }
+    }
+    systemFree(block);
+}
+
+void BufferPool::trim() noexcept {
+    if (ThreadBlockCache *cache = threadCache())
+        cache->flush();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int c = 0; c < kClassCount; ++c) {
+        for (void *block : freeBlocks[c]) {
+            cached.fetch_sub(classBytes(c), std::memory_order_relaxed);
+            systemFree(block);
+        }
+        freeBlocks[c].clear();
+    }
+}
+
+BufferPoolStats BufferPool::stats() const noexcept {
+    BufferPoolStats values;
+    values.requests = requests.load(std::memory_order_relaxed);
+    values.hits = hits.load(std::memory_order_relaxed);
+    values.inUse = inUse.load(std::memory_order_relaxed);
+    values.cached = cached.load(std::memory_order_relaxed);
+    values.highWater = highWater.load(std::memory_order_relaxed);
+    return values;
+}
+
+void BufferPool::resetStats() noexcept {
+    requests.store(0, std::memory_order_relaxed);
+    hits.store(0, std::memory_order_relaxed);
+    highWater.store(inUse.load(std::memory_order_relaxed) + cached.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+}
+
+void *poolMalloc(std::size_t bytes) noexcept {
+    try {
+        auto *block = static_cast<unsigned char *>(BufferPool::shared().allocate(bytes + BufferPool::kAlignment));
+        *reinterpret_cast<std::size_t *>(block) = bytes;
+        return block + BufferPool::kAlignment;
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void poolFree(void *block) noexcept {
+    if (!block)
+        return;
+    auto *start = static_cast<unsigned char *>(block) - BufferPool::kAlignment;
+    BufferPool::shared().deallocate(start, *reinterpret_cast<std::size_t *>(start) + BufferPool::kAlignment);
+}
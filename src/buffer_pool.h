@@ -0,0 +1,173 @@
+#ifndef IMAGE_FILTERS_BUFFER_POOL_H
+#define IMAGE_FILTERS_BUFFER_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * \file
+ * \brief Пул буферов по классам размеров для пикселей, промежуточных буферов и памяти zlib/libpng
+ */
+
+/**
+ * @brief Счётчики пула буферов.
+ */
+struct BufferPoolStats {
+    std::uint64_t requests = 0; ///< Число выданных блоков.
+    std::uint64_t hits = 0;     ///< Блоки, выданные из кеша без обращения к системному аллокатору.
+    std::size_t inUse = 0;      ///< Байты в выданных блоках (по размеру класса).
+    std::size_t cached = 0;     ///< Байты в свободных блоках общего кеша и кешей потоков.
+    std::size_t highWater = 0;  ///< Наибольшее значение inUse + cached с последнего resetStats().
+
+    /**
+     * @brief Возвращает долю запросов, обслуженных из кеша.
+     *
+     * @return Число от 0 до 1; 0, если запросов не было.
+     */
+    double hitRate() const { return requests ? static_cast<double>(hits) / requests : 0.0; }
+};
+
+/**
+ * @class BufferPool
+ * @brief Процессный пул блоков памяти, выровненных по kAlignment байтов.
+ *
+ * Размер запроса округляется вверх до класса: на каждое удвоение от kMinBlockBytes
+ * приходится четыре класса, поэтому потери не превышают 25%. Освобождённый блок
+ * остаётся в кеше своего класса и выдаётся следующему запросу того же класса; в
+ * установившемся режиме (изображения одного размера) обработка не обращается к
+ * системному аллокатору.
+ *
+ * Блоки до kThreadCacheMaxBytes сначала попадают в кеш текущего потока, который не
+ * требует блокировок; остальные и переполнение кеша потока — в общий кеш под мьютексом.
+ * Блоки больше kMaxPooledBytes выделяются напрямую. Общий кеш ограничен
+ * setCacheLimit(); блоки сверх предела возвращаются системе.
+ */
+class BufferPool {
+public:
+    static constexpr std::size_t kAlignment = 64;                  ///< Выравнивание каждого блока.
+    static constexpr std::size_t kMinBlockBytes = 64;              ///< Наименьший класс.
+    static constexpr std::size_t kThreadCacheMaxBytes = 1u << 20;  ///< Наибольший класс в кешах потоков.
+    static constexpr std::size_t kMaxPooledBytes = sizeof(std::size_t) >= 8 ? std::size_t(1) << 36 : std::size_t(1) << 30;
+
+    /**
+     * @brief Возвращает пул процесса.
+     *
+     * Пул не уничтожается до завершения процесса, поэтому им можно пользоваться из
+     * деструкторов статических объектов и потоков.
+     *
+     * @return Ссылка на пул.
+     */
+    static BufferPool &shared();
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    /**
+     * @brief Выделяет блок не меньше bytes байтов.
+     *
+     * @param bytes Размер; 0 возвращает nullptr.
+     * @return Блок, выровненный по kAlignment.
+     * @throws std::bad_alloc Если системный аллокатор не выделил память.
+     */
+    void *allocate(std::size_t bytes);
+
+    /**
+     * @brief Возвращает блок в пул.
+     *
+     * @param block Блок из allocate() или nullptr.
+     * @param bytes Тот же размер, что был передан в allocate().
+     */
+    void deallocate(void *block, std::size_t bytes) noexcept;
+
+    /**
+     * @brief Возвращает системе свободные блоки общего кеша и кеша текущего потока.
+     */
+    void trim() noexcept;
+
+    /**
+     * @brief Задаёт наибольший объём свободных блоков в общем кеше.
+     *
+     * @param bytes Предел в байтах; по умолчанию 1 ГБ.
+     */
+    void setCacheLimit(std::size_t bytes) noexcept { cacheLimit.store(bytes, std::memory_order_relaxed); }
+
+    /**
+     * @brief Возвращает текущие счётчики.
+     *
+     * @return Снимок счётчиков.
+     */
+    BufferPoolStats stats() const noexcept;
+
+    /**
+     * @brief Обнуляет requests и hits и сбрасывает highWater до текущего объёма.
+     */
+    void resetStats() noexcept;
+
+private:
+    friend struct ThreadBlockCache;
+
+    BufferPool();
+
+    void releaseToShared(void *block, int sizeClass) noexcept;
+
+    std::mutex mutex;
+    std::vector<std::vector<void *>> freeBlocks;
+    std::atomic<std::size_t> cacheLimit{std::size_t(1) << 30};
+    std::atomic<std::uint64_t> requests{0};
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::size_t> inUse{0};
+    std::atomic<std::size_t> cached{0};
+    std::atomic<std::size_t> highWater{0};
+};
+
+/**
+ * @brief Аллокатор стандартных контейнеров, берущий память из BufferPool::shared().
+ *
+ * Блоки выровнены по BufferPool::kAlignment, поэтому подходит и для строк Image.
+ *
+ * @tparam T Тип элементов; alignof(T) не больше BufferPool::kAlignment.
+ */
+template <typename T> struct PoolAllocator {
+    static_assert(alignof(T) <= BufferPool::kAlignment, "PoolAllocator cannot satisfy this alignment");
+
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U> PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n) { return static_cast<T *>(BufferPool::shared().allocate(n * sizeof(T))); }
+
+    void deallocate(T *p, std::size_t n) noexcept { BufferPool::shared().deallocate(p, n * sizeof(T)); }
+
+    template <typename U> bool operator==(const PoolAllocator<U> &) const noexcept { return true; }
+    template <typename U> bool operator!=(const PoolAllocator<U> &) const noexcept { return false; }
+};
+
+/**
+ * @brief Вектор, хранящий элементы в BufferPool::shared().
+ *
+ * @tparam T Тип элементов.
+ */
+template <typename T> using PooledVector = std::vector<T, PoolAllocator<T>>;
+
+/**
+ * @brief Выделяет память для C-библиотек, которые освобождают её без размера (zlib, libpng).
+ *
+ * Размер хранится перед блоком.
+ *
+ * @param bytes Размер.
+ * @return Блок, выровненный по BufferPool::kAlignment; nullptr при нехватке памяти.
+ */
+void *poolMalloc(std::size_t bytes) noexcept;
+
+/**
+ * @brief Освобождает блок, выделенный poolMalloc().
+ *
+ * @param block Блок или nullptr.
+ */
+void poolFree(void *block) noexcept;
+
+#endif // IMAGE_FILTERS_BUFFER_POOL_H
@@ -0,0 +1,295 @@
+#include "filter_kernels.h"
+#include "philox.h"
+#include "simd.h"
+#include <algorithm>
+#include <array>
+
+namespace {
+
+constexpr std::uint32_t kNoiseStream = 1;
+constexpr std::uint32_t kGlitchStream = 2;
+constexpr std::uint32_t kGlitchBlockStream = 3;
+
+template <typename Traits> using SampleOf = typename Traits::Sample;
+
+// Пиксель формата Traits как значение; используется для перестановок пикселей.
+template <typename Traits> using PixelOf = std::array<SampleOf<Traits>, Traits::kChannels>;
+
+template <typename Traits> PixelOf<Traits> *pixelsOf(std::uint8_t *row) {
+    return reinterpret_cast<PixelOf<Traits> *>(row);
+}
+
+template <typename Traits> void addIntensity(std::uint8_t *row, const std::uint8_t *intensity, int count) {
+    if constexpr (Traits::kFormat == PixelFormat::RGBA8) {
+        addSaturatedRow(reinterpret_cast<Pixel *>(row), intensity, count);
+    } else {
+        PixelOf<Traits> *pixels = pixelsOf<Traits>(row);
+        for (int x = 0; x < count; ++x)
+            for (int c = 0; c < Traits::kColorChannels; ++c)
+                pixels[x][c] = static_cast<SampleOf<Traits>>(
+                    std::min(Traits::kMax, pixels[x][c] + intensity[x] * Traits::kScale));
+    }
+}
+
+template <typename Traits> void solarRow(const SolarRaysKernel &kernel, std::uint8_t *row, int width, int y) {
+    if (kernel.field) {
+        addIntensity<Traits>(row, kernel.field->row(y), width);
+        return;
+    }
+    constexpr int kChunk = 256;
+    std::uint8_t intensity[kChunk];
+    for (int x0 = 0; x0 < width; x0 += kChunk) {
+        int n = std::min(kChunk, width - x0);
+        computeSolarRaysRow(kernel.width, kernel.height, y, x0, n, intensity);
+        addIntensity<Traits>(row + static_cast<std::size_t>(x0) * sizeof(PixelOf<Traits>), intensity, n);
+    }
+}
+
+template <typename Traits> void noiseRow(const ColorNoiseKernel &kernel, std::uint8_t *row, int width, int y) {
+    constexpr int kChunk = 64;
+    float noiseFactor = kernel.intensity * 3.5f;
+    PixelOf<Traits> *pixels = pixelsOf<Traits>(row);
+
+    std::uint32_t words[4 * kChunk];
+    for (int x0 = 0; x0 < width; x0 += kChunk) {
+        int count = std::min(kChunk, width - x0);
+        philoxFillRow(kernel.seed, kNoiseStream, x0, y, count, words);
+        for (int i = 0; i < count; ++i) {
+            PixelOf<Traits> &pixel = pixels[x0 + i];
+            for (int c = 0; c < Traits::kColorChannels; ++c) {
+                int noise = static_cast<int>(philoxUniformInt(words[4 * i + c], -250, 250) * noiseFactor);
+                pixel[c] = static_cast<SampleOf<Traits>>(std::clamp(pixel[c] + noise * Traits::kScale, 0, Traits::kMax));
+            }
+        }
+    }
+}
+
+template <typename Traits> void boostChannel(std::uint8_t *row, int width, int channel, std::uint8_t boost) {
+    if constexpr (Traits::kFormat == PixelFormat::RGBA8) {
+        Pixel addend{0, 0, 0, 0};
+        addend[channel] = boost;
+        addConstantSaturatedRow(reinterpret_cast<Pixel *>(row), width, addend);
+    } else {
+        PixelOf<Traits> *pixels = pixelsOf<Traits>(row);
+        for (int x = 0; x < width; ++x)
+            pixels[x][channel] =
+                static_cast<SampleOf<Traits>>(std::min(Traits::kMax, pixels[x][channel] + boost * Traits::kScale));
+    }
+}
+
+template <typename Traits> void glitchRow(const GlitchKernel &kernel, std::uint8_t *row, int width, int y) {
+    if (width == 0)
+        return;
+    const GlitchOptions &options = kernel.options;
+    PixelOf<Traits> *pixels = pixelsOf<Traits>(row);
+    auto rotateRight = [pixels, width](int shift) {
+        shift %= width;
+        if (shift < 0)
+            shift += width;
+        std::rotate(pixels, pixels + width - shift, pixels + width);
+    };
+    // В серых форматах усиления красного и зелёного приходятся на канал яркости.
+    constexpr int kGreen = Traits::kColorChannels == 1 ? 0 : 1;
+
+    if (options.rowStep > 0 && y % options.rowStep == 0) {
+        rotateRight(philoxUniformInt(philoxAt(kernel.seed, kGlitchStream, 0, y)[0], 0, options.maxShift));
+        if (y % 20 == 0)
+            boostChannel<Traits>(row, width, 0, options.boost);
+        else if (y % 15 == 0)
+            boostChannel<Traits>(row, width, kGreen, options.boost);
+    }
+
+    if (options.blockHeight <= 0)
+        return;
+    PhiloxCounter block = philoxAt(kernel.seed, kGlitchBlockStream, 0, y / options.blockHeight);
+    if (block[0] >= options.blockChance * 4294967296.0)
+        return;
+    rotateRight(philoxUniformInt(block[1], -options.blockMaxShift, options.blockMaxShift));
+
+    if constexpr (Traits::kColorChannels == 3) {
+        if (options.channelOffset <= 0)
+            return;
+        int offset = philoxUniformInt(block[2], 1, options.channelOffset) % width;
+        thread_local std::vector<PixelOf<Traits>> original;
+        original.assign(pixels, pixels + width);
+        for (int x = 0; x < width; ++x) {
+            pixels[x][0] = original[(x + offset) % width][0];
+            pixels[x][2] = original[(x + width - offset) % width][2];
+        }
+    }
+}
+
+template <typename Traits> void grayRow(std::uint8_t *row, int width) {
+    if constexpr (Traits::kFormat == PixelFormat::RGBA8) {
+        grayscaleRow(reinterpret_cast<Pixel *>(row), width);
+    } else if constexpr (Traits::kColorChannels == 3) {
+        // Те же веса с фиксированной точкой, что и в simd.cpp.
+        PixelOf<Traits> *pixels = pixelsOf<Traits>(row);
+        for (int x = 0; x < width; ++x) {
+            PixelOf<Traits> &p = pixels[x];
+            auto gray = static_cast<SampleOf<Traits>>((9798ull * p[0] + 19235ull * p[1] + 3735ull * p[2] + 16384) >> 15);
+            p[0] = p[1] = p[2] = gray;
+        }
+    }
+}
+
+void solarPlanes(const SolarRaysKernel &kernel, const PlanarRow &row, int y) {
+    int width = static_cast<int>(row.width);
+    if (kernel.field) {
+        for (int c = 0; c < 3; ++c)
+            addSaturatedPlane(row.planes[c], kernel.field->row(y), width);
+        return;
+    }
+    constexpr int kChunk = 256;
+    std::uint8_t intensity[kChunk];
+    for (int x0 = 0; x0 < width; x0 += kChunk) {
+        int n = std::min(kChunk, width - x0);
+        computeSolarRaysRow(kernel.width, kernel.height, y, x0, n, intensity);
+        for (int c = 0; c < 3; ++c)
+            addSaturatedPlane(row.planes[c] + x0, intensity, n);
+    }
+}
+
+void noisePlanes(const ColorNoiseKernel &kernel, const PlanarRow &row, int y) {
+    constexpr int kChunk = 64;
+    float noiseFactor = kernel.intensity * 3.5f;
+    int width = static_cast<int>(row.width);
+
+    std::uint32_t words[4 * kChunk];
+    for (int x0 = 0; x0 < width; x0 += kChunk) {
+        int count = std::min(kChunk, width - x0);
+        philoxFillRow(kernel.seed, kNoiseStream, x0, y, count, words);
+        for (int c = 0; c < 3; ++c) {
+            std::uint8_t *plane = row.planes[c] + x0;
+            for (int i = 0; i < count; ++i) {
+                int noise = static_cast<int>(philoxUniformInt(words[4 * i + c], -250, 250) * noiseFactor);
+                plane[i] = static_cast<std::uint8_t>(std::clamp(plane[i] + noise, 0, 255));
+            }
+        }
+    }
+}
+
+// Сдвиг строки — поворот каждой плоскости, расхождение каналов — поворот плоскостей R и B
+// в разные стороны, без копии строки.
+void glitchPlanes(const GlitchKernel &kernel, const PlanarRow &row, int y) {
+    int width = static_cast<int>(row.width);
+    if (width == 0)
+        return;
+    const GlitchOptions &options = kernel.options;
+    auto rotateRight = [width](std::uint8_t *plane, int shift) {
+        shift %= width;
+        if (shift < 0)
+            shift += width;
+        std::rotate(plane, plane + width - shift, plane + width);
+    };
+
+    if (options.rowStep > 0 && y % options.rowStep == 0) {
+        int shift = philoxUniformInt(philoxAt(kernel.seed, kGlitchStream, 0, y)[0], 0, options.maxShift);
+        for (std::uint8_t *plane : row.planes)
+            rotateRight(plane, shift);
+        if (y % 20 == 0)
+            addConstantSaturatedPlane(row.planes[0], width, options.boost);
+        else if (y % 15 == 0)
+            addConstantSaturatedPlane(row.planes[1], width, options.boost);
+    }
+
+    if (options.blockHeight <= 0)
+        return;
+    PhiloxCounter block = philoxAt(kernel.seed, kGlitchBlockStream, 0, y / options.blockHeight);
+    if (block[0] >= options.blockChance * 4294967296.0)
+        return;
+    int shift = philoxUniformInt(block[1], -options.blockMaxShift, options.blockMaxShift);
+    for (std::uint8_t *plane : row.planes)
+        rotateRight(plane, shift);
+
+    if (options.channelOffset <= 0)
+        return;
+    int offset = philoxUniformInt(block[2], 1, options.channelOffset) % width;
+    rotateRight(row.planes[0], -offset);
+    rotateRight(row.planes[2], offset);
+}
+
+} // namespace
+
+SolarRaysKernel::SolarRaysKernel(int width, int height, bool useCache)
+    : width(width), height(height), field(useCache ? cachedSolarRaysField(width, height) : nullptr) {}
+
+void SolarRaysKernel::operator()(Span<Pixel> row, int y) const {
+    solarRow<PixelTraits<PixelFormat::RGBA8>>(*this, reinterpret_cast<std::uint8_t *>(row.data()),
+                                             static_cast<int>(row.size()), y);
+}
+
+void SolarRaysKernel::operator()(const PlanarRow &row, int y) const { solarPlanes(*this, row, y); }
+
+void SolarRaysKernel::apply(PixelFormat format, std::uint8_t *row, int width, int y) const {
+    dispatchPixelFormat(format, [&](auto traits) { solarRow<decltype(traits)>(*this, row, width, y); });
+}
+
+void ColorNoiseKernel::operator()(Span<Pixel> row, int y) const {
+    noiseRow<PixelTraits<PixelFormat::RGBA8>>(*this, reinterpret_cast<std::uint8_t *>(row.data()),
+                                             static_cast<int>(row.size()), y);
+}
+
+void ColorNoiseKernel::operator()(const PlanarRow &row, int y) const { noisePlanes(*this, row, y); }
+
+void ColorNoiseKernel::apply(PixelFormat format, std::uint8_t *row, int width, int y) const {
+    dispatchPixelFormat(format, [&](auto traits) { noiseRow<decltype(traits)>(*this, row, width, y); });
+}
+
+void GlitchKernel::operator()(Span<Pixel> row, int y) const {
+    glitchRow<PixelTraits<PixelFormat::RGBA8>>(*this, reinterpret_cast<std::uint8_t *>(row.data()),
+                                              static_cast<int>(row.size()), y);
+}
+
+void GlitchKernel::operator()(const PlanarRow &row, int y) const { glitchPlanes(*this, row, y); }
+
+void GlitchKernel::apply(PixelFormat format, std::uint8_t *row, int width, int y) const {
+    dispatchPixelFormat(format, [&](auto traits) { glitchRow<decltype(traits)>(*this, row, width, y); });
+}
+
+WaveKernel::WaveKernel(float amplitude, int width, int height, bool useCache) {
+    if (useCache)
+        field = cachedWaveField(amplitude, width, height);
+    if (!field)
+        field = std::make_shared<const DisplacementField>(waveField(amplitude, width, height));
+}
+
+void WaveKernel::operator()(Span<Pixel> row, int y, const Pixel *const *window) const {
+    remapRow(PixelFormat::RGBA8, *field, RemapOptions{}, reinterpret_cast<std::uint8_t *>(row.data()), y,
+             reinterpret_cast<const std::uint8_t *const *>(window));
+}
+
+void WaveKernel::operator()(const PlanarRow &row, int y, const PlanarRow *window) const {
+    remapRow(*field, RemapOptions{}, row, y, window);
+}
+
+void WaveKernel::apply(PixelFormat format, std::uint8_t *row, int y, const std::uint8_t *const *window) const {
+    remapRow(format, *field, RemapOptions{}, row, y, window);
+}
+
+void GrayscaleKernel::operator()(Span<Pixel> row, int) const { grayscaleRow(row.data(), row.size()); }
+
+void GrayscaleKernel::operator()(const PlanarRow &row, int) const {
+    grayscalePlanes(row.planes[0], row.planes[1], row.planes[2], row.width);
+}
+
+void GrayscaleKernel::apply(PixelFormat format, std::uint8_t *row, int width, int) const {
+    dispatchPixelFormat(format, [&](auto traits) { grayRow<decltype(traits)>(row, width); });
+}
+
+bool isRowLocal(FilterType type) { return type != FilterType::WaveDistortion; }
+
+RowKernel makeRowKernel(FilterType type, const FilterParams &params, int width, int height, bool useCache) {
+    switch (type) {
+    case FilterType::SolarRays:
+        return SolarRaysKernel{width, height, useCache};
+    case FilterType::ColorNoise:
+        return ColorNoiseKernel{params.intensity, params.seed};
+    case FilterType::Glitch:
+        return GlitchKernel{params.seed, params.glitch};
+    case FilterType::Grayscale:
+        return GrayscaleKernel{};
+    default:
+        return {};
+    }
+}
@@ -0,0 +1,303 @@
+#ifndef IMAGE_FILTERS_FILTER_KERNELS_H
+#define IMAGE_FILTERS_FILTER_KERNELS_H
+
+#include "geometry_cache.h"
+#include "image_filters.h"
+#include "planar_image.h"
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+/**
+ * \file
+ * \brief Построчные ядра фильтров, общие для обработки в памяти и потоковой обработки
+ */
+
+/**
+ * @brief Ядро эффекта солнечных лучей для одной строки.
+ *
+ * Зависит только от размеров всего изображения и координат пикселя. Яркость
+ * берётся из общего кеша таблиц (см. cachedSolarRaysField), а если таблица не
+ * помещается в кеш — вычисляется для каждой строки заново.
+ */
+struct SolarRaysKernel {
+    /**
+     * @brief Создаёт ядро для изображения заданного размера.
+     *
+     * @param width Ширина всего изображения.
+     * @param height Высота всего изображения.
+     * @param useCache true — брать таблицу из общего кеша; false — всегда считать строки
+     *                 заново (для потоковой обработки, где важна память, а не время).
+     */
+    SolarRaysKernel(int width, int height, bool useCache = true);
+
+    int width;                                   ///< Ширина всего изображения.
+    int height;                                  ///< Высота всего изображения.
+    std::shared_ptr<const SolarRaysField> field; ///< Таблица яркости; nullptr, если не кешируется.
+
+    /**
+     * @brief Обрабатывает строку y на месте.
+     *
+     * @param row Пиксели строки.
+     * @param y Номер строки в изображении.
+     */
+    void operator()(Span<Pixel> row, int y) const;
+
+    /**
+     * @brief Обрабатывает строку y изображения с плоскостями каналов на месте.
+     *
+     * @param row Строки плоскостей.
+     * @param y Номер строки в изображении.
+     */
+    void operator()(const PlanarRow &row, int y) const;
+
+    /**
+     * @brief Обрабатывает строку y изображения в формате format на месте.
+     *
+     * @param format Формат пикселей строки.
+     * @param row Данные строки.
+     * @param width Число пикселей в строке.
+     * @param y Номер строки в изображении.
+     */
+    void apply(PixelFormat format, std::uint8_t *row, int width, int y) const;
+};
+
+/**
+ * @brief Ядро цветового шума для одной строки.
+ */
+struct ColorNoiseKernel {
+    float intensity = 0.1f; ///< Интенсивность шума.
+    std::uint64_t seed = 0; ///< Зерно генератора Philox.
+
+    /**
+     * @brief Обрабатывает строку y на месте.
+     *
+     * @param row Пиксели строки.
+     * @param y Номер строки в изображении.
+     */
+    void operator()(Span<Pixel> row, int y) const;
+
+    /**
+     * @brief Обрабатывает строку y изображения с плоскостями каналов на месте.
+     *
+     * @param row Строки плоскостей.
+     * @param y Номер строки в изображении.
+     */
+    void operator()(const PlanarRow &row, int y) const;
+
+    /**
+     * @brief Обрабатывает строку y изображения в формате format на месте.
+     *
+     * @param format Формат пикселей строки.
+     * @param row Данные строки.
+     * @param width Число пикселей в строке.
+     * @param y Номер строки в изображении.
+     */
+    void apply(PixelFormat format, std::uint8_t *row, int width, int y) const;
+};
+
+/**
+ * @brief Ядро глитча для одной строки.
+ *
+ * Сдвиги выполняются циклическим поворотом непрерывной строки, усиление каналов —
+ * векторным сложением с насыщением.
+ */
+struct GlitchKernel {
+    std::uint64_t seed = 0; ///< Зерно генератора Philox.
+    GlitchOptions options;  ///< Параметры эффекта.
+
+    /**
+     * @brief Проверяет, может ли ядро изменить строку y.
+     *
+     * @param y Номер строки.
+     * @return false, если строка гарантированно остаётся без изменений.
+     */
+    bool touches(int y) const { return options.blockHeight > 0 || (options.rowStep > 0 && y % options.rowStep == 0); }
+
+    /**
+     * @brief Обрабатывает строку y на месте.
+     *
+     * @param row Пиксели строки.
+     * @param y Номер строки в изображении.
+     */
+    void operator()(Span<Pixel> row, int y) const;
+
+    /**
+     * @brief Обрабатывает строку y изображения с плоскостями каналов на месте.
+     *
+     * @param row Строки плоскостей.
+     * @param y Номер строки в изображении.
+     */
+    void operator()(const PlanarRow &row, int y) const;
+
+    /**
+     * @brief Обрабатывает строку y изображения в формате format на месте.
+     *
+     * @param format Формат пикселей строки.
+     * @param row Данные строки.
+     * @param width Число пикселей в строке.
+     * @param y Номер строки в изображении.
+     */
+    void apply(PixelFormat format, std::uint8_t *row, int width, int y) const;
+};
+
+/**
+ * @brief Ядро перевода в оттенки серого для одной строки.
+ */
+struct GrayscaleKernel {
+    /**
+     * @brief Обрабатывает строку на месте.
+     *
+     * @param row Пиксели строки.
+     * @param y Номер строки (не используется).
+     */
+    void operator()(Span<Pixel> row, int y) const;
+
+    /**
+     * @brief Обрабатывает строку изображения с плоскостями каналов на месте.
+     *
+     * @param row Строки плоскостей.
+     * @param y Номер строки (не используется).
+     */
+    void operator()(const PlanarRow &row, int y) const;
+
+    /**
+     * @brief Обрабатывает строку y изображения в формате format на месте.
+     *
+     * @param format Формат пикселей строки.
+     * @param row Данные строки.
+     * @param width Число пикселей в строке.
+     * @param y Номер строки в изображении.
+     */
+    void apply(PixelFormat format, std::uint8_t *row, int width, int y) const;
+};
+
+/**
+ * @brief Ядро волнового искажения для одной строки.
+ *
+ * Смещения задаются разделимым полем waveField, которое берётся из общего кеша и
+ * переиспользуется изображениями того же размера; строки формируются общим
+ * сэмплером remapRow. Строка y результата зависит только от исходных строк
+ * [y - reach(), y + reach()].
+ */
+class WaveKernel {
+public:
+    /**
+     * @brief Получает поле смещений для изображения заданного размера.
+     *
+     * @param amplitude Амплитуда искажения.
+     * @param width Ширина всего изображения.
+     * @param height Высота всего изображения.
+     * @param useCache true — брать поле из общего кеша; false — всегда строить своё.
+     */
+    WaveKernel(float amplitude, int width, int height, bool useCache = true);
+
+    /**
+     * @brief Возвращает максимальное вертикальное смещение в строках.
+     *
+     * @return Радиус окна исходных строк.
+     */
+    int reach() const { return field->reach(); }
+
+    /**
+     * @brief Возвращает поле смещений.
+     *
+     * @return Разделимое поле размером с изображение.
+     */
+    const DisplacementField &getField() const { return *field; }
+
+    /**
+     * @brief Формирует строку y результата из окна исходных строк.
+     *
+     * @param row Строка результата; не должна совпадать ни с одной строкой окна.
+     * @param y Номер строки.
+     * @param window 2 * reach() + 1 указателей: window[k] — исходная строка
+     *               y - reach() + k или nullptr, если она вне изображения.
+     */
+    void operator()(Span<Pixel> row, int y, const Pixel *const *window) const;
+
+    /**
+     * @brief Формирует строку y результата с плоскостями каналов из окна исходных строк.
+     *
+     * @param row Строка результата; не должна совпадать ни с одной строкой окна.
+     * @param y Номер строки.
+     * @param window 2 * reach() + 1 строк: window[k] — исходная строка y - reach() + k;
+     *               у строк вне изображения указатели равны nullptr.
+     */
+    void operator()(const PlanarRow &row, int y, const PlanarRow *window) const;
+
+    /**
+     * @brief Формирует строку y результата в формате format из окна исходных строк.
+     *
+     * @param format Формат пикселей.
+     * @param row Строка результата из width пикселей.
+     * @param y Номер строки.
+     * @param window Окно исходных строк, как в operator().
+     */
+    void apply(PixelFormat format, std::uint8_t *row, int y, const std::uint8_t *const *window) const;
+
+private:
+    std::shared_ptr<const DisplacementField> field;
+};
+
+/**
+ * @brief Построчное ядро любого построчного фильтра; std::monostate — нет ядра.
+ *
+ * Тип ядра хранится в std::variant, а не стирается в std::function: проход
+ * выбирает ядро через std::visit один раз на полосу строк (см. applyRowKernels), а
+ * внутри полосы вызывает перегрузку для своей раскладки или формата напрямую.
+ */
+using RowKernel = std::variant<std::monostate, SolarRaysKernel, ColorNoiseKernel, GlitchKernel, GrayscaleKernel>;
+
+/**
+ * @brief Проверяет, обрабатывает ли фильтр каждую строку независимо от других.
+ *
+ * Такие фильтры можно объединять в один проход по памяти и обрабатывать потоково
+ * по одной строке. Волновое искажение читает соседние строки и к ним не относится.
+ *
+ * @param type Вид фильтра.
+ * @return true для построчных фильтров.
+ */
+bool isRowLocal(FilterType type);
+
+/**
+ * @brief Создаёт построчное ядро для фильтра.
+ *
+ * @param type Вид фильтра; должен удовлетворять isRowLocal(type).
+ * @param params Параметры фильтра.
+ * @param width Ширина всего изображения.
+ * @param height Высота всего изображения.
+ * @param useCache Разрешает использовать кеш геометрических таблиц.
+ * @return Ядро; std::monostate, если фильтр не построчный.
+ */
+RowKernel makeRowKernel(FilterType type, const FilterParams &params, int width, int height, bool useCache = true);
+
+/**
+ * @brief Применяет ядра объединённого прохода к полосе строк [y0, y1).
+ *
+ * Ядра применяются по очереди ко всей полосе, поэтому полоса должна помещаться в
+ * кеш (см. parallelBands). Для каждого ядра std::visit выполняется один раз, а
+ * rowOp(kernel, y) инстанцируется для конкретного типа ядра: перегрузка для
+ * Span<Pixel>, PlanarRow или apply(format, ...) выбирается при компиляции.
+ *
+ * @param kernels Ядра в порядке применения.
+ * @param y0 Первая строка полосы.
+ * @param y1 Строка за последней.
+ * @param rowOp Обобщённая функция rowOp(const auto &kernel, int y), обрабатывающая строку y.
+ */
+template <typename RowOp> void applyRowKernels(const std::vector<RowKernel> &kernels, int y0, int y1, RowOp &&rowOp) {
+    for (const RowKernel &kernel : kernels) {
+        std::visit(
+            [&](const auto &typed) {
+                if constexpr (!std::is_same_v<std::decay_t<decltype(typed)>, std::monostate>)
+                    for (int y = y0; y < y1; ++y)
+                        rowOp(typed, y);
+            },
+            kernel);
+    }
+}
+
+#endif // IMAGE_FILTERS_FILTER_KERNELS_H
@@ -0,0 +1,220 @@
+#include "filter_pipeline.h"
+#include "filter_kernels.h"
+#include "stats.h"
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+struct FilterName {
+    const char *name;
+    FilterType type;
+};
+
+const FilterName kFilterNames[] = {
+    {"solar", FilterType::SolarRays}, {"wave", FilterType::WaveDistortion}, {"noise", FilterType::ColorNoise},
+    {"glitch", FilterType::Glitch},   {"grayscale", FilterType::Grayscale}, {"gray", FilterType::Grayscale},
+};
+
+std::vector<std::string> split(const std::string &text, char separator) {
+    std::vector<std::string> parts;
+    std::string part;
+    std::istringstream stream(text);
+    while (std::getline(stream, part, separator)) {
+        std::size_t first = part.find_first_not_of(" \t");
+        std::size_t last = part.find_last_not_of(" \t");
+        parts.push_back(first == std::string::npos ? std::string() : part.substr(first, last - first + 1));
+    }
+    return parts;
+}
+
+bool parseFloat(const std::string &text, float &value) {
+    char *end = nullptr;
+    value = std::strtof(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+bool parseInt(const std::string &text, int &value) {
+    char *end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    value = static_cast<int>(parsed);
+    return !text.empty() && *end == '\0' && parsed >= 0 && parsed <= 1 << 20;
+}
+
+bool parseGlitchOption(const std::string &key, const std::string &value, GlitchOptions &options) {
+    int boost = 0;
+    if (key == "step")
+        return parseInt(value, options.rowStep);
+    if (key == "shift")
+        return parseInt(value, options.maxShift);
+    if (key == "boost") {
+        bool ok = parseInt(value, boost) && boost <= 255;
+        options.boost = static_cast<std::uint8_t>(boost);
+        return ok;
+    }
+    if (key == "block")
+        return parseInt(value, options.blockHeight);
+    if (key == "chance")
+        return parseFloat(value, options.blockChance);
+    if (key == "blockshift")
+        return parseInt(value, options.blockMaxShift);
+    if (key == "offset")
+        return parseInt(value, options.channelOffset);
+    return false;
+}
+
+bool parseSeed(const std::string &text, std::uint64_t &value) {
+    char *end = nullptr;
+    value = std::strtoull(text.c_str(), &end, 10);
+    return !text.empty() && text[0] != '-' && *end == '\0';
+}
+
+bool parseStage(const std::string &text, std::uint64_t defaultSeed, FilterStage &stage) {
+    std::vector<std::string> tokens = split(text, ':');
+    if (tokens.empty())
+        return false;
+
+    bool known = false;
+    for (const FilterName &entry : kFilterNames) {
+        if (tokens[0] == entry.name) {
+            stage.type = entry.type;
+            known = true;
+        }
+    }
+    if (!known)
+        return false;
+
+    stage.params = FilterParams{};
+    stage.params.seed = defaultSeed;
+    bool hasAmplitude = stage.type == FilterType::WaveDistortion;
+    bool hasIntensity = stage.type == FilterType::ColorNoise;
+    bool hasSeed = stage.type == FilterType::ColorNoise || stage.type == FilterType::Glitch;
+
+    for (std::size_t i = 1; i < tokens.size(); ++i) {
+        const std::string &token = tokens[i];
+        std::size_t eq = token.find('=');
+        std::string key = eq == std::string::npos ? std::string() : token.substr(0, eq);
+        std::string value = eq == std::string::npos ? token : token.substr(eq + 1);
+        bool ok = false;
+        if ((key.empty() || key == "amplitude") && hasAmplitude)
+            ok = parseFloat(value, stage.params.amplitude);
+        else if ((key.empty() || key == "intensity") && hasIntensity)
+            ok = parseFloat(value, stage.params.intensity);
+        else if (key == "seed" && hasSeed)
+            ok = parseSeed(value, stage.params.seed);
+        else if (!key.empty() && stage.type == FilterType::Glitch)
+            ok = parseGlitchOption(key, value, stage.params.glitch);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+FilterPipeline &FilterPipeline::add(FilterType type, const FilterParams &params) {
+    stageList.push_back({type, params});
+    return *this;
+}
+
+bool FilterPipeline::parse(const std::string &spec, FilterPipeline &pipeline, std::uint64_t defaultSeed) {
+    FilterPipeline parsed;
+    for (const std::string &text : split(spec, ',')) {
+        FilterStage stage{};
+        if (!parseStage(text, defaultSeed, stage))
+            return false;
+        parsed.stageList.push_back(stage);
+    }
+    if (parsed.empty())
+        return false;
+    pipeline = std::move(parsed);
+    return true;
+}
+
+std::string FilterPipeline::toString() const {
+    std::ostringstream out;
+    for (std::size_t i = 0; i < stageList.size(); ++i) {
+        const FilterStage &stage = stageList[i];
+        if (i > 0)
+            out << ',';
+        switch (stage.type) {
+        case FilterType::SolarRays:
+            out << "solar";
+            break;
+        case FilterType::WaveDistortion:
+            out << "wave:" << stage.params.amplitude;
+            break;
+        case FilterType::ColorNoise:
+            out << "noise:" << stage.params.intensity << ":seed=" << stage.params.seed;
+            break;
+        case FilterType::Glitch: {
+            const GlitchOptions &options = stage.params.glitch;
+            const GlitchOptions defaults;
+            out << "glitch:seed=" << stage.params.seed;
+            if (options.rowStep != defaults.rowStep)
+                out << ":step=" << options.rowStep;
+            if (options.maxShift != defaults.maxShift)
+                out << ":shift=" << options.maxShift;
+            if (options.boost != defaults.boost)
+                out << ":boost=" << static_cast<int>(options.boost);
+            if (options.blockHeight != defaults.blockHeight)
+                out << ":block=" << options.blockHeight;
+            if (options.blockChance != defaults.blockChance)
+                out << ":chance=" << options.blockChance;
+            if (options.blockMaxShift != defaults.blockMaxShift)
+                out << ":blockshift=" << options.blockMaxShift;
+            if (options.channelOffset != defaults.channelOffset)
+                out << ":offset=" << options.channelOffset;
+            break;
+        }
+        case FilterType::Grayscale:
+            out << "grayscale";
+            break;
+        }
+    }
+    return out.str();
+}
+
+int FilterPipeline::passCount() const {
+    int passes = 0;
+    bool inFusedPass = false;
+    for (const FilterStage &stage : stageList) {
+        bool rowLocal = isRowLocal(stage.type);
+        if (!rowLocal || !inFusedPass)
+            ++passes;
+        inFusedPass = rowLocal;
+    }
+    return passes;
+}
+
+void FilterPipeline::apply(Image &img) const { apply(img, img.bounds()); }
+
+void FilterPipeline::apply(Image &img, const Region &region) const {
+    Region area = region.clippedTo(img.getWidth(), img.getHeight());
+    std::size_t i = 0;
+    while (i < stageList.size()) {
+        if (!isRowLocal(stageList[i].type)) {
+            applyFilter(img, stageList[i].type, stageList[i].params, area);
+            ++i;
+            continue;
+        }
+
+        std::vector<RowKernel> fused;
+        for (; i < stageList.size() && isRowLocal(stageList[i].type); ++i)
+            fused.push_back(makeRowKernel(stageList[i].type, stageList[i].params, area.width, area.height));
+
+        if (fused.size() == 1 && stageList[i - 1].type == FilterType::Glitch) {
+            applyGlitch(img, stageList[i - 1].params.seed, stageList[i - 1].params.glitch, area);
+            continue;
+        }
+        IMAGE_FILTERS_STAT_TIMER("filter.fused");
+        IMAGE_FILTERS_STAT_ADD("filter.fused", pixels, static_cast<std::size_t>(area.width) * area.height);
+        PixelFormat format = img.getFormat();
+        std::size_t offset = static_cast<std::size_t>(area.x) * img.getBytesPerPixel();
+        parallelBands(area.height, static_cast<std::size_t>(area.width) * img.getBytesPerPixel(), [&](int y0, int y1) {
+            applyRowKernels(fused, y0, y1, [&](const auto &kernel, int y) {
+                kernel.apply(format, img.row(area.y + y) + offset, area.width, y);
+            });
+        });
+    }
+}
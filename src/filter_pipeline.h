@@ -0,0 +1,108 @@
+#ifndef IMAGE_FILTERS_FILTER_PIPELINE_H
+#define IMAGE_FILTERS_FILTER_PIPELINE_H
+
+#include "image_filters.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \brief Цепочка фильтров с объединением построчных фильтров в один проход
+ */
+
+/**
+ * @brief Один фильтр цепочки с параметрами.
+ */
+struct FilterStage {
+    FilterType type;     ///< Вид фильтра.
+    FilterParams params; ///< Параметры фильтра.
+};
+
+/**
+ * @class FilterPipeline
+ * @brief Последовательность фильтров, применяемая к изображению.
+ *
+ * Соседние построчные фильтры (солнечные лучи, шум, глитч, оттенки серого)
+ * объединяются в один проход: каждая полоса строк проходит через все такие фильтры,
+ * пока находится в кеше. Волновое искажение читает соседние строки и поэтому
+ * разделяет проходы. Результат совпадает с последовательным вызовом фильтров.
+ */
+class FilterPipeline {
+public:
+    /**
+     * @brief Добавляет фильтр в конец цепочки.
+     *
+     * @param type Вид фильтра.
+     * @param params Параметры фильтра.
+     * @return Ссылка на цепочку для последовательных вызовов.
+     */
+    FilterPipeline &add(FilterType type, const FilterParams &params = {});
+
+    /**
+     * @brief Разбирает описание цепочки.
+     *
+     * Фильтры перечисляются через запятую, параметры фильтра — через двоеточие:
+     * "grayscale,noise:0.3:seed=7,solar,wave:15,glitch:seed=3". Имена: solar, wave,
+     * noise, glitch, grayscale (или gray). Число без имени задаёт амплитуду волн или
+     * интенсивность шума; также допустимы amplitude=, intensity= и seed=. Для глитча
+     * доступны параметры GlitchOptions: step=, shift=, boost=, block=, chance=,
+     * blockshift= и offset=.
+     *
+     * @param spec Описание цепочки.
+     * @param pipeline Цепочка, в которую записывается результат.
+     * @param defaultSeed Зерно для фильтров, у которых seed не указан.
+     * @return true, если описание корректно; false, если оно пустое или содержит ошибку.
+     */
+    static bool parse(const std::string &spec, FilterPipeline &pipeline, std::uint64_t defaultSeed = 0);
+
+    /**
+     * @brief Возвращает каноническое описание цепочки, которое принимает parse().
+     *
+     * @return Строка с описанием всех фильтров и их параметров.
+     */
+    std::string toString() const;
+
+    /**
+     * @brief Возвращает фильтры цепочки.
+     *
+     * @return Фильтры в порядке применения.
+     */
+    const std::vector<FilterStage> &stages() const { return stageList; }
+
+    /**
+     * @brief Проверяет, пуста ли цепочка.
+     *
+     * @return true, если в цепочке нет фильтров.
+     */
+    bool empty() const { return stageList.empty(); }
+
+    /**
+     * @brief Возвращает число проходов по памяти после объединения фильтров.
+     *
+     * @return Число проходов.
+     */
+    int passCount() const;
+
+    /**
+     * @brief Применяет цепочку к изображению.
+     *
+     * @param img Изображение.
+     */
+    void apply(Image &img) const;
+
+    /**
+     * @brief Применяет цепочку к области изображения.
+     *
+     * Область обрабатывается как отдельное изображение, см. applyFilter(Image&, FilterType, const FilterParams&, const Region&).
+     *
+     * @param img Изображение.
+     * @param region Обрабатываемая область.
+     */
+    void apply(Image &img, const Region &region) const;
+
+private:
+    std::vector<FilterStage> stageList;
+};
+
+#endif // IMAGE_FILTERS_FILTER_PIPELINE_H
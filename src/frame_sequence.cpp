@@ -0,0 +1,554 @@
+#include "frame_sequence.h"
+#include "batch.h"
+#include "bounded_queue.h"
+#include "result_cache.h"
+#include "stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::uint8_t kSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+// Смещения полей fcTL: sequence_number, width, height, x_offset, y_offset,
+// delay_num, delay_den, dispose_op, blend_op — всего 26 байтов.
+constexpr std::size_t kFrameControlSize = 26;
+constexpr std::uint8_t kDisposeNone = 0;
+constexpr std::uint8_t kDisposeBackground = 1;
+constexpr std::uint8_t kDisposePrevious = 2;
+constexpr std::uint8_t kBlendOver = 1;
+
+std::uint32_t readU32(const std::uint8_t *p) {
+    return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) |
+           (static_cast<std::uint32_t>(p[2]) << 8) | p[3];
+}
+
+std::uint16_t readU16(const std::uint8_t *p) { return static_cast<std::uint16_t>((p[0] << 8) | p[1]); }
+
+void writeU32(std::uint8_t *p, std::uint32_t value) {
+    p[0] = static_cast<std::uint8_t>(value >> 24);
+    p[1] = static_cast<std::uint8_t>(value >> 16);
+    p[2] = static_cast<std::uint8_t>(value >> 8);
+    p[3] = static_cast<std::uint8_t>(value);
+}
+
+void writeU16(std::uint8_t *p, std::uint16_t value) {
+    p[0] = static_cast<std::uint8_t>(value >> 8);
+    p[1] = static_cast<std::uint8_t>(value);
+}
+
+// Сравнивает имена файлов в естественном порядке: группы цифр — как числа
+// (frame_2.png < frame_10.png), остальное — посимвольно; при равенстве — как строки.
+bool naturalLess(const std::string &a, const std::string &b) {
+    std::string left = fs::path(a).filename().string(), right = fs::path(b).filename().string();
+    std::size_t i = 0, j = 0;
+    auto isDigit = [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; };
+    while (i < left.size() && j < right.size()) {
+        if (isDigit(left[i]) && isDigit(right[j])) {
+            std::size_t endI = i, endJ = j;
+            while (endI < left.size() && isDigit(left[endI]))
+                ++endI;
+            while (endJ < right.size() && isDigit(right[endJ]))
+                ++endJ;
+            std::size_t startI = i, startJ = j;
+            while (startI + 1 < endI && left[startI] == '0')
+                ++startI;
+            while (startJ + 1 < endJ && right[startJ] == '0')
+                ++startJ;
+            int order = endI - startI == endJ - startJ
+                            ? left.compare(startI, endI - startI, right, startJ, endJ - startJ)
+                            : (endI - startI < endJ - startJ ? -1 : 1);
+            if (order != 0)
+                return order < 0;
+            i = endI;
+            j = endJ;
+        } else {
+            if (left[i] != right[j])
+                return static_cast<unsigned char>(left[i]) < static_cast<unsigned char>(right[j]);
+            ++i;
+            ++j;
+        }
+    }
+    if (i != left.size() || j != right.size())
+        return left.size() - i < right.size() - j;
+    return a < b;
+}
+
+std::uint32_t chunkCrc(const char *type, const std::uint8_t *data, std::size_t length) {
+    uLong crc = crc32(0, reinterpret_cast<const Bytef *>(type), 4);
+    if (length)
+        crc = crc32(crc, data, static_cast<uInt>(length));
+    return static_cast<std::uint32_t>(crc);
+}
+
+// Дописывает чанк: длина, тип, данные (prefix, затем data) и CRC.
+void appendChunk(std::vector<std::uint8_t> &out, const char *type, const std::uint8_t *prefix, std::size_t prefixLength,
+                 const std::uint8_t *data, std::size_t length) {
+    std::size_t start = out.size();
+    out.resize(start + 8 + prefixLength + length + 4);
+    std::uint8_t *p = out.data() + start;
+    writeU32(p, static_cast<std::uint32_t>(prefixLength + length));
+    std::memcpy(p + 4, type, 4);
+    if (prefixLength)
+        std::memcpy(p + 8, prefix, prefixLength);
+    if (length)
+        std::memcpy(p + 8 + prefixLength, data, length);
+    uLong crc = crc32(0, p + 4, static_cast<uInt>(4 + prefixLength + length));
+    writeU32(p + 8 + prefixLength + length, static_cast<std::uint32_t>(crc));
+}
+
+void appendChunk(std::vector<std::uint8_t> &out, const char *type, const std::uint8_t *data, std::size_t length) {
+    appendChunk(out, type, nullptr, 0, data, length);
+}
+
+bool isType(const std::uint8_t *p, const char *type) { return std::memcmp(p, type, 4) == 0; }
+
+// Накладывает пиксель src на dst (blend_op OVER из спецификации APNG).
+void blendOver(const Pixel &src, Pixel &dst) {
+    if (src[3] == 255) {
+        dst = src;
+        return;
+    }
+    if (src[3] == 0)
+        return;
+    unsigned u = src[3] * 255u;
+    unsigned v = (255u - src[3]) * dst[3];
+    unsigned alpha = u + v;
+    for (int c = 0; c < 3; ++c)
+        dst[c] = static_cast<std::uint8_t>((src[c] * u + dst[c] * v) / alpha);
+    dst[3] = static_cast<std::uint8_t>(alpha / 255);
+}
+
+void fillRect(Image &img, int x, int y, int width, int height, Pixel value) {
+    for (int row = y; row < y + height; ++row)
+        std::fill_n(img.rowPixels(row).data() + x, width, value);
+}
+
+// Копирует область источника размером w x h из (sx, sy) в (dx, dy).
+void copyRect(const Image &src, int sx, int sy, Image &dst, int dx, int dy, int width, int height) {
+    for (int row = 0; row < height; ++row)
+        std::copy_n(src.rowPixels(sy + row).data() + sx, width, dst.rowPixels(dy + row).data() + dx);
+}
+
+void copyImage(const Image &src, Image &dst) {
+    if (dst.getWidth() != src.getWidth() || dst.getHeight() != src.getHeight() || dst.getFormat() != src.getFormat())
+        dst = Image(src.getWidth(), src.getHeight(), src.getFormat());
+    copyRect(src, 0, 0, dst, 0, 0, src.getWidth(), src.getHeight());
+}
+
+} // namespace
+
+bool ApngReader::open(const std::string &filename) {
+    std::vector<std::uint8_t> data;
+    return readFileBytes(filename, data) && openFromMemory(std::move(data));
+}
+
+bool ApngReader::openFromMemory(std::vector<std::uint8_t> data) {
+    bytes = std::move(data);
+    shared.clear();
+    frames.clear();
+    animated = false;
+    plays = 0;
+    width = height = 0;
+    nextFrame = 0;
+    canvas = Image();
+
+    if (bytes.size() < sizeof(kSignature) || std::memcmp(bytes.data(), kSignature, sizeof(kSignature)) != 0)
+        return false;
+
+    bool seenHeader = false;
+    bool seenData = false;
+    std::size_t pos = sizeof(kSignature);
+    while (pos + 12 <= bytes.size()) {
+        const std::uint8_t *p = bytes.data() + pos;
+        std::size_t length = readU32(p);
+        if (length > bytes.size() - pos - 12)
+            return false;
+        const std::uint8_t *body = p + 8;
+        if (chunkCrc(reinterpret_cast<const char *>(p + 4), body, length) != readU32(body + length))
+            return false;
+
+        if (isType(p + 4, "IHDR")) {
+            if (length != 13)
+                return false;
+            ihdr = pos + 8;
+            width = static_cast<int>(readU32(body));
+            height = static_cast<int>(readU32(body + 4));
+            seenHeader = true;
+        } else if (isType(p + 4, "acTL")) {
+            if (length != 8)
+                return false;
+            animated = true;
+            plays = readU32(body + 4);
+        } else if (isType(p + 4, "fcTL")) {
+            if (length != kFrameControlSize)
+                return false;
+            Frame frame;
+            frame.width = static_cast<int>(readU32(body + 4));
+            frame.height = static_cast<int>(readU32(body + 8));
+            frame.x = static_cast<int>(readU32(body + 12));
+            frame.y = static_cast<int>(readU32(body + 16));
+            frame.timing.delayNum = readU16(body + 20);
+            frame.timing.delayDen = readU16(body + 22);
+            frame.dispose = body[24];
+            frame.blend = body[25];
+            if (frame.width <= 0 || frame.height <= 0 || frame.x < 0 || frame.y < 0 ||
+                frame.x > width - frame.width || frame.y > height - frame.height)
+                return false;
+            frames.push_back(frame);
+        } else if (isType(p + 4, "IDAT")) {
+            seenData = true;
+            // IDAT — первый кадр анимации, только если перед ним был fcTL.
+            if (!frames.empty())
+                frames.back().data.push_back({pos + 8, length});
+        } else if (isType(p + 4, "fdAT")) {
+            if (frames.empty() || length < 4)
+                return false;
+            frames.back().data.push_back({pos + 12, length - 4});
+        } else if (isType(p + 4, "IEND")) {
+            break;
+        } else if (!seenData) {
+            shared.push_back({pos, length + 12});
+        }
+        pos += length + 12;
+    }
+    if (!seenHeader || !seenData || width <= 0 || height <= 0)
+        return false;
+    if (animated) {
+        if (frames.empty())
+            return false;
+        for (const Frame &frame : frames)
+            if (frame.data.empty())
+                return false;
+    }
+    return true;
+}
+
+bool ApngReader::decodeFrame(const Frame &info) {
+    scratch.assign(kSignature, kSignature + sizeof(kSignature));
+    std::uint8_t header[13];
+    std::memcpy(header, bytes.data() + ihdr, sizeof(header));
+    writeU32(header, static_cast<std::uint32_t>(info.width));
+    writeU32(header + 4, static_cast<std::uint32_t>(info.height));
+    appendChunk(scratch, "IHDR", header, sizeof(header));
+    for (const Chunk &chunk : shared)
+        scratch.insert(scratch.end(), bytes.begin() + chunk.offset, bytes.begin() + chunk.offset + chunk.length);
+    for (const Chunk &chunk : info.data)
+        appendChunk(scratch, "IDAT", bytes.data() + chunk.offset, chunk.length);
+    appendChunk(scratch, "IEND", nullptr, 0);
+    return region.loadFromMemory(Span<const std::uint8_t>(scratch.data(), scratch.size()), PixelFormat::RGBA8);
+}
+
+bool ApngReader::next(Image &frame, FrameTiming &timing) {
+    IMAGE_FILTERS_STAT_TIMER("sequence.decode");
+    if (bytes.empty() || nextFrame >= frameCount())
+        return false;
+
+    if (!animated) {
+        ++nextFrame;
+        timing = FrameTiming{};
+        Span<const std::uint8_t> data(bytes.data(), bytes.size());
+        return frame.loadFromMemory(data, PixelFormat::RGBA8);
+    }
+
+    const Frame &info = frames[nextFrame];
+    if (!decodeFrame(info) || region.getWidth() != info.width || region.getHeight() != info.height)
+        return false;
+
+    if (canvas.getWidth() != width || canvas.getHeight() != height)
+        canvas = Image(width, height);
+    if (nextFrame == 0)
+        fillRect(canvas, 0, 0, width, height, Pixel{0, 0, 0, 0});
+
+    // Для PREVIOUS запоминаем область до наложения; у первого кадра PREVIOUS равен BACKGROUND.
+    std::uint8_t dispose = info.dispose == kDisposePrevious && nextFrame == 0 ? kDisposeBackground : info.dispose;
+    if (dispose == kDisposePrevious) {
+        if (saved.getWidth() != info.width || saved.getHeight() != info.height)
+            saved = Image(info.width, info.height);
+        copyRect(canvas, info.x, info.y, saved, 0, 0, info.width, info.height);
+    }
+
+    if (info.blend == kBlendOver) {
+        for (int y = 0; y < info.height; ++y) {
+            const Pixel *src = region.rowPixels(y).data();
+            Pixel *dst = canvas.rowPixels(info.y + y).data() + info.x;
+            for (int x = 0; x < info.width; ++x)
+                blendOver(src[x], dst[x]);
+        }
+    } else {
+        copyRect(region, 0, 0, canvas, info.x, info.y, info.width, info.height);
+    }
+
+    copyImage(canvas, frame);
+    timing = info.timing;
+
+    if (dispose == kDisposeBackground)
+        fillRect(canvas, info.x, info.y, info.width, info.height, Pixel{0, 0, 0, 0});
+    else if (dispose == kDisposePrevious)
+        copyRect(saved, 0, 0, canvas, info.x, info.y, info.width, info.height);
+    ++nextFrame;
+    return true;
+}
+
+ApngWriter::ApngWriter(const SaveOptions &options, std::uint32_t loops) : options(options), loops(loops) {
+    this->options.reduceFormat = false;
+}
+
+ApngWriter::~ApngWriter() {
+    if (file.is_open())
+        close();
+}
+
+bool ApngWriter::open(const std::string &filename) {
+    file.open(filename, std::ios::binary | std::ios::trunc);
+    frames = 0;
+    sequence = 0;
+    failed = !file;
+    return !failed;
+}
+
+bool ApngWriter::add(const Image &frame, const FrameTiming &timing) {
+    IMAGE_FILTERS_STAT_TIMER("sequence.encode");
+    if (failed || !file.is_open() || !frame.saveToBuffer(encoded, options)) {
+        failed = true;
+        return false;
+    }
+
+    // Чанки сжатого кадра: IHDR, служебные чанки до IDAT, IDAT..., IEND.
+    chunk.clear();
+    const std::uint8_t *ihdr = nullptr;
+    std::vector<std::pair<std::size_t, std::size_t>> data;
+    std::size_t pos = sizeof(kSignature);
+    while (pos + 12 <= encoded.size()) {
+        const std::uint8_t *p = encoded.data() + pos;
+        std::size_t length = readU32(p);
+        if (length > encoded.size() - pos - 12)
+            break;
+        if (isType(p + 4, "IHDR") && length == 13)
+            ihdr = p + 8;
+        else if (isType(p + 4, "IDAT"))
+            data.emplace_back(pos + 8, length);
+        else if (isType(p + 4, "IEND"))
+            break;
+        else if (frames == 0 && data.empty())
+            chunk.insert(chunk.end(), p, p + length + 12);
+        pos += length + 12;
+    }
+    if (!ihdr || data.empty() || (frames > 0 && std::memcmp(ihdr, header, sizeof(header)) != 0)) {
+        failed = true;
+        return false;
+    }
+
+    std::vector<std::uint8_t> out;
+    if (frames == 0) {
+        std::memcpy(header, ihdr, sizeof(header));
+        out.assign(kSignature, kSignature + sizeof(kSignature));
+        appendChunk(out, "IHDR", header, sizeof(header));
+        std::uint8_t control[8];
+        writeU32(control, 0); // число кадров дописывается в close()
+        writeU32(control + 4, loops);
+        appendChunk(out, "acTL", control, sizeof(control));
+        out.insert(out.end(), chunk.begin(), chunk.end());
+    }
+
+    std::uint8_t control[kFrameControlSize] = {};
+    writeU32(control, sequence++);
+    std::memcpy(control + 4, header, 8); // ширина и высота кадра совпадают с холстом
+    writeU16(control + 20, timing.delayNum);
+    writeU16(control + 22, timing.delayDen);
+    control[24] = kDisposeNone;
+    control[25] = 0; // blend_op SOURCE
+    appendChunk(out, "fcTL", control, sizeof(control));
+    for (const auto &[offset, length] : data) {
+        if (frames == 0) {
+            appendChunk(out, "IDAT", encoded.data() + offset, length);
+        } else {
+            std::uint8_t number[4];
+            writeU32(number, sequence++);
+            appendChunk(out, "fdAT", number, sizeof(number), encoded.data() + offset, length);
+        }
+    }
+
+    file.write(reinterpret_cast<const char *>(out.data()), static_cast<std::streamsize>(out.size()));
+    failed = !file;
+    if (!failed)
+        ++frames;
+    return !failed;
+}
+
+bool ApngWriter::close() {
+    if (!file.is_open())
+        return false;
+    bool ok = !failed && frames > 0;
+    if (ok) {
+        std::vector<std::uint8_t> end;
+        appendChunk(end, "IEND", nullptr, 0);
+        file.write(reinterpret_cast<const char *>(end.data()), static_cast<std::streamsize>(end.size()));
+
+        // acTL идёт сразу за сигнатурой и IHDR (8 + 25 байтов).
+        std::vector<std::uint8_t> actl;
+        std::uint8_t control[8];
+        writeU32(control, static_cast<std::uint32_t>(frames));
+        writeU32(control + 4, loops);
+        appendChunk(actl, "acTL", control, sizeof(control));
+        file.seekp(sizeof(kSignature) + 25);
+        file.write(reinterpret_cast<const char *>(actl.data()), static_cast<std::streamsize>(actl.size()));
+        ok = static_cast<bool>(file);
+    }
+    file.close();
+    return ok && !file.fail();
+}
+
+namespace {
+
+struct SequenceItem {
+    std::size_t index = 0;
+    Image image;
+    FrameTiming timing;
+};
+
+bool isApngPath(const std::string &path) {
+    std::string extension = fs::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".png";
+}
+
+// Цепочка для кадра index: к зёрнам шума и глитча прибавляется номер кадра.
+FilterPipeline framePipeline(const FilterPipeline &pipeline, std::size_t index) {
+    FilterPipeline result;
+    for (const FilterStage &stage : pipeline.stages()) {
+        FilterParams params = stage.params;
+        params.seed += index;
+        result.add(stage.type, params);
+    }
+    return result;
+}
+
+} // namespace
+
+std::string sequenceFrameName(std::size_t index) {
+    std::string number = std::to_string(index);
+    if (number.size() < 5)
+        number.insert(0, 5 - number.size(), '0');
+    return "frame_" + number + ".png";
+}
+
+SequenceResult runSequence(const SequenceOptions &options) {
+    auto start = std::chrono::steady_clock::now();
+    SequenceResult result;
+
+    std::error_code error;
+    bool inputIsDirectory = fs::is_directory(options.input, error);
+    std::vector<std::string> inputs;
+    ApngReader reader;
+    if (inputIsDirectory ? !collectInputs(options.input, inputs) || inputs.empty() : !reader.open(options.input))
+        return result;
+    // collectInputs упорядочивает пути как строки; кадры без ведущих нулей (1.png, 2.png,
+    // 10.png) идут в порядке номеров.
+    std::sort(inputs.begin(), inputs.end(), naturalLess);
+
+    bool writeApng = isApngPath(options.output);
+    ApngWriter writer(options.save, inputIsDirectory ? options.loops : reader.loopCount());
+    if (writeApng) {
+        if (!writer.open(options.output))
+            return result;
+    } else {
+        fs::create_directories(options.output, error);
+        if (!fs::is_directory(options.output, error))
+            return result;
+    }
+
+    BoundedQueue<SequenceItem> decoded(options.queueDepth);
+    BoundedQueue<SequenceItem> filtered(options.queueDepth);
+    std::atomic<bool> failed{false};
+    std::uint64_t pixels = 0;
+
+    auto decode = [&] {
+        for (std::size_t i = 0;; ++i) {
+            SequenceItem item;
+            item.index = i;
+            if (inputIsDirectory) {
+                if (i >= inputs.size())
+                    break;
+                IMAGE_FILTERS_STAT_TIMER("sequence.decode");
+                item.timing = options.timing;
+                if (!item.image.load(inputs[i], PixelFormat::RGBA8)) {
+                    failed = true;
+                    break;
+                }
+            } else {
+                if (i >= reader.frameCount())
+                    break;
+                if (!reader.next(item.image, item.timing)) {
+                    failed = true;
+                    break;
+                }
+            }
+            if (!decoded.push(std::move(item)))
+                break;
+        }
+        decoded.close();
+    };
+
+    auto filter = [&] {
+        SequenceItem item;
+        while (decoded.pop(item)) {
+            IMAGE_FILTERS_STAT_TIMER("sequence.filter");
+            IMAGE_FILTERS_STAT_ADD("sequence.filter", pixels,
+                                   static_cast<std::size_t>(item.image.getWidth()) * item.image.getHeight());
+            if (options.varySeed)
+                framePipeline(options.pipeline, item.index).apply(item.image);
+            else
+                options.pipeline.apply(item.image);
+            if (!filtered.push(std::move(item)))
+                break;
+        }
+        filtered.close();
+        decoded.close();
+    };
+
+    auto encode = [&] {
+        SequenceItem item;
+        while (filtered.pop(item)) {
+            bool saved;
+            if (writeApng) {
+                saved = writer.add(item.image, item.timing);
+            } else {
+                IMAGE_FILTERS_STAT_TIMER("sequence.encode");
+                saved = item.image.save((fs::path(options.output) / sequenceFrameName(item.index)).string(),
+                                        options.save);
+            }
+            if (!saved) {
+                failed = true;
+                break;
+            }
+            ++result.frames;
+            pixels += static_cast<std::uint64_t>(item.image.getWidth()) * item.image.getHeight();
+            item.image = Image();
+        }
+        filtered.close();
+        decoded.close();
+    };
+
+    std::thread decoder(decode);
+    std::thread encoder(encode);
+    filter();
+    decoder.join();
+    encoder.join();
+
+    if (writeApng && !writer.close())
+        failed = true;
+    result.ok = !failed;
+    result.megapixels = pixels / 1e6;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
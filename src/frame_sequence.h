@@ -0,0 +1,246 @@
+#ifndef IMAGE_FILTERS_FRAME_SEQUENCE_H
+#define IMAGE_FILTERS_FRAME_SEQUENCE_H
+
+#include "filter_pipeline.h"
+#include "image_filters.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \brief Последовательности кадров: чтение и запись анимированного PNG (APNG) и каталогов кадров
+ */
+
+/**
+ * @brief Длительность показа кадра: delayNum / delayDen секунды, как в чанке fcTL.
+ */
+struct FrameTiming {
+    std::uint16_t delayNum = 1;  ///< Числитель задержки.
+    std::uint16_t delayDen = 10; ///< Знаменатель задержки; 0 означает 100.
+};
+
+/**
+ * @class ApngReader
+ * @brief Последовательно декодирует кадры анимированного PNG.
+ *
+ * Чанки acTL, fcTL и fdAT разбираются вручную: каждый кадр собирается в памяти в
+ * отдельный PNG (IHDR с размером кадра, общие чанки вроде PLTE и tRNS, данные
+ * IDAT/fdAT) и распаковывается libpng. Кадры накладываются на холст RGBA8 по
+ * правилам dispose_op и blend_op, поэтому next() всегда возвращает полный кадр.
+ * Обычный PNG без acTL читается как последовательность из одного кадра.
+ */
+class ApngReader {
+public:
+    /**
+     * @brief Читает файл и разбирает его чанки.
+     *
+     * @param filename Путь к PNG или APNG.
+     * @return true, если файл прочитан и его структура корректна.
+     */
+    bool open(const std::string &filename);
+
+    /**
+     * @brief Разбирает PNG или APNG из памяти.
+     *
+     * @param data Содержимое файла; хранится в объекте до следующего open.
+     * @return true, если структура файла корректна.
+     */
+    bool openFromMemory(std::vector<std::uint8_t> data);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /**
+     * @brief Возвращает число кадров анимации.
+     *
+     * @return Число кадров; 1 для обычного PNG.
+     */
+    std::size_t frameCount() const { return animated ? frames.size() : 1; }
+
+    /**
+     * @brief Возвращает число повторов анимации из acTL.
+     *
+     * @return Число повторов; 0 — бесконечно.
+     */
+    std::uint32_t loopCount() const { return plays; }
+
+    /**
+     * @brief Декодирует следующий кадр и накладывает его на холст.
+     *
+     * @param frame Полный кадр RGBA8 размером getWidth() x getHeight(); буфер
+     *              переиспользуется, если размер и формат совпадают.
+     * @param timing Длительность показа кадра.
+     * @return true, если кадр декодирован; false в конце последовательности или при ошибке.
+     */
+    bool next(Image &frame, FrameTiming &timing);
+
+private:
+    struct Chunk {
+        std::size_t offset; // начало данных чанка в bytes
+        std::size_t length;
+    };
+
+    struct Frame {
+        int width = 0;
+        int height = 0;
+        int x = 0;
+        int y = 0;
+        FrameTiming timing;
+        std::uint8_t dispose = 0;
+        std::uint8_t blend = 0;
+        std::vector<Chunk> data; // сжатые данные без номера последовательности fdAT
+    };
+
+    bool decodeFrame(const Frame &info);
+
+    std::vector<std::uint8_t> bytes;
+    std::size_t ihdr = 0;          // смещение данных IHDR
+    std::vector<Chunk> shared;     // чанки до IDAT (PLTE, tRNS, gAMA...) целиком, с длиной, типом и CRC
+    std::vector<Frame> frames;
+    bool animated = false;
+    std::uint32_t plays = 0;
+    int width = 0;
+    int height = 0;
+
+    std::size_t nextFrame = 0;
+    Image canvas;
+    Image region;                       // распакованный текущий кадр
+    Image saved;                        // область холста для dispose_op PREVIOUS
+    std::vector<std::uint8_t> scratch;  // собранный PNG текущего кадра
+};
+
+/**
+ * @class ApngWriter
+ * @brief Записывает кадры одного размера в анимированный PNG.
+ *
+ * Каждый кадр сжимается libpng как обычный PNG (SaveOptions, без подбора формата,
+ * чтобы тип цвета совпадал у всех кадров), после чего его IDAT переносится в файл:
+ * у первого кадра — как IDAT, у остальных — как fdAT. Число кадров в acTL
+ * дописывается в close(), поэтому кадры можно передавать по мере готовности.
+ */
+class ApngWriter {
+public:
+    /**
+     * @brief Создаёт объект записи.
+     *
+     * @param options Параметры сжатия кадров; reduceFormat игнорируется.
+     * @param loops Число повторов анимации; 0 — бесконечно.
+     */
+    explicit ApngWriter(const SaveOptions &options = SaveOptions{}, std::uint32_t loops = 0);
+
+    /**
+     * @brief Закрывает файл, если close() ещё не вызывался.
+     */
+    ~ApngWriter();
+
+    ApngWriter(const ApngWriter &) = delete;
+    ApngWriter &operator=(const ApngWriter &) = delete;
+
+    /**
+     * @brief Создаёт файл результата.
+     *
+     * @param filename Путь к файлу.
+     * @return true, если файл открыт для записи.
+     */
+    bool open(const std::string &filename);
+
+    /**
+     * @brief Сжимает и дописывает кадр.
+     *
+     * @param frame Кадр; размер и формат должны совпадать с первым кадром.
+     * @param timing Длительность показа кадра.
+     * @return true, если кадр записан.
+     */
+    bool add(const Image &frame, const FrameTiming &timing);
+
+    /**
+     * @brief Дописывает IEND и число кадров в acTL и закрывает файл.
+     *
+     * @return true, если записан хотя бы один кадр и запись прошла успешно.
+     */
+    bool close();
+
+    /**
+     * @brief Возвращает число записанных кадров.
+     *
+     * @return Число кадров.
+     */
+    std::size_t frameCount() const { return frames; }
+
+private:
+    SaveOptions options;
+    std::uint32_t loops;
+    std::ofstream file;
+    std::vector<std::uint8_t> encoded;
+    std::vector<std::uint8_t> chunk;
+    std::uint8_t header[13] = {}; // IHDR первого кадра
+    std::size_t frames = 0;
+    std::uint32_t sequence = 0;
+    bool failed = false;
+};
+
+/**
+ * @brief Параметры обработки последовательности кадров.
+ */
+struct SequenceOptions {
+    std::string input;       ///< APNG, обычный PNG или каталог кадров *.png, упорядоченных по номерам в именах.
+    std::string output;      ///< Путь *.png — запись APNG; иначе каталог для frame_00000.png, frame_00001.png, ...
+    FilterPipeline pipeline; ///< Цепочка фильтров.
+    SaveOptions save;        ///< Параметры сжатия кадров.
+    FrameTiming timing;      ///< Длительность кадров из каталога; у APNG берётся из файла.
+    std::uint32_t loops = 0; ///< Число повторов для кадров из каталога; у APNG берётся из файла.
+    bool varySeed = false;   ///< Прибавлять номер кадра к зерну шума и глитча, чтобы эффект менялся.
+    std::size_t queueDepth = 2; ///< Ёмкость очередей между стадиями.
+};
+
+/**
+ * @brief Итоги обработки последовательности.
+ */
+struct SequenceResult {
+    bool ok = false;           ///< Все кадры прочитаны и записаны.
+    std::size_t frames = 0;    ///< Число записанных кадров.
+    double seconds = 0.0;      ///< Общее время обработки в секундах.
+    double megapixels = 0.0;   ///< Суммарная площадь кадров в мегапикселях.
+
+    /**
+     * @brief Возвращает пропускную способность в кадрах в секунду.
+     *
+     * @return Кадров в секунду; 0, если время равно нулю.
+     */
+    double framesPerSecond() const { return seconds > 0 ? frames / seconds : 0.0; }
+
+    /**
+     * @brief Возвращает пропускную способность в мегапикселях в секунду.
+     *
+     * @return Мегапикселей в секунду; 0, если время равно нулю.
+     */
+    double megapixelsPerSecond() const { return seconds > 0 ? megapixels / seconds : 0.0; }
+};
+
+/**
+ * @brief Возвращает имя файла кадра в каталоге результатов runSequence.
+ *
+ * @param index Номер кадра с нуля.
+ * @return frame_00000.png, frame_00001.png, ...; номера длиннее пяти цифр не обрезаются.
+ */
+std::string sequenceFrameName(std::size_t index);
+
+/**
+ * @brief Обрабатывает последовательность кадров конвейером из трёх стадий.
+ *
+ * Поток чтения декодирует кадр i + 1, пока цепочка фильтров (распараллеленная в
+ * общем пуле) обрабатывает кадр i, а поток записи сжимает кадр i - 1. Кадры
+ * проходят стадии по порядку. Всё, что зависит только от размера кадра, создаётся
+ * один раз: таблицы лучей и смещений волны берутся из кеша геометрии, буферы
+ * кадров возвращаются в BufferPool и достаются следующим кадрам того же размера.
+ * Кадры из каталога читаются в формате RGBA8; в APNG все они должны быть одного размера.
+ *
+ * @param options Параметры обработки.
+ * @return Итоги обработки.
+ */
+SequenceResult runSequence(const SequenceOptions &options);
+
+#endif // IMAGE_FILTERS_FRAME_SEQUENCE_H
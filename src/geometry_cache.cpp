@@ -0,0 +1,135 @@
+#include "geometry_cache.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <mutex>
+
+namespace {
+
+// Запись содержит либо таблицу лучей, либо поле волны (тогда amplitude — часть ключа).
+struct CacheEntry {
+    int width;
+    int height;
+    float amplitude;
+    std::shared_ptr<const SolarRaysField> field;
+    std::shared_ptr<const DisplacementField> wave;
+
+    std::size_t bytes() const { return field ? field->bytes() : wave->bytes(); }
+};
+
+std::mutex cacheMutex;
+std::list<CacheEntry> cacheEntries; // most recently used first
+std::size_t cacheBytes = 0;
+std::size_t cacheLimit = 256 * 1024 * 1024;
+
+void evictLocked() {
+    while (cacheBytes > cacheLimit && !cacheEntries.empty()) {
+        cacheBytes -= cacheEntries.back().bytes();
+        cacheEntries.pop_back();
+    }
+}
+
+} // namespace
+
+void computeSolarRaysRow(int width, int height, int y, int x0, int count, std::uint8_t *out) {
+    int centerX = width / 2;
+    int centerY = height / 2;
+    float maxDist = static_cast<float>(std::sqrt(static_cast<double>(centerX * centerX + centerY * centerY)));
+    float dy = static_cast<float>(y - centerY);
+
+    for (int i = 0; i < count; ++i) {
+        float dx = static_cast<float>(x0 + i - centerX);
+        float dist = std::sqrt(dx * dx + dy * dy);
+        float inv = dist > 0.0f ? 1.0f / dist : 0.0f;
+        float re = dx * inv, im = dy * inv;
+        float re2 = re * re - im * im, im2 = 2.0f * re * im;
+        float re4 = re2 * re2 - im2 * im2, im4 = 2.0f * re2 * im2;
+        float re8 = re4 * re4 - im4 * im4, im8 = 2.0f * re4 * im4;
+        float sin10 = re8 * im2 + im8 * re2;
+        float falloff = maxDist > 0.0f ? 1.0f - dist / maxDist : 0.0f;
+        float intensity = sin10 * falloff * 100.0f;
+        intensity = std::min(std::max(intensity, 0.0f), 255.0f);
+        out[i] = static_cast<std::uint8_t>(intensity);
+    }
+}
+
+SolarRaysField::SolarRaysField(int width, int height)
+    : width(std::max(width, 0)), height(std::max(height, 0)),
+      values(static_cast<std::size_t>(this->width) * this->height) {
+    parallelRows(this->height, static_cast<std::size_t>(this->width), [this](int y) {
+        computeSolarRaysRow(this->width, this->height, y, 0, this->width, &values[static_cast<std::size_t>(y) * this->width]);
+    });
+}
+
+std::shared_ptr<const SolarRaysField> cachedSolarRaysField(int width, int height) {
+    std::size_t bytes = static_cast<std::size_t>(std::max(width, 0)) * std::max(height, 0);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (bytes > cacheLimit)
+            return nullptr;
+        for (auto it = cacheEntries.begin(); it != cacheEntries.end(); ++it) {
+            if (it->field && it->width == width && it->height == height) {
+                cacheEntries.splice(cacheEntries.begin(), cacheEntries, it);
+                return it->field;
+            }
+        }
+    }
+
+    auto field = std::make_shared<const SolarRaysField>(width, height);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (const CacheEntry &entry : cacheEntries)
+        if (entry.field && entry.width == width && entry.height == height)
+            return entry.field;
+    cacheEntries.push_front({width, height, 0.0f, field, nullptr});
+    cacheBytes += field->bytes();
+    evictLocked();
+    return field;
+}
+
+std::shared_ptr<const DisplacementField> cachedWaveField(float amplitude, int width, int height) {
+    std::size_t bytes = (static_cast<std::size_t>(std::max(width, 0)) + std::max(height, 0)) * 2 * sizeof(std::int32_t);
+    auto matches = [&](const CacheEntry &entry) {
+        return entry.wave && entry.width == width && entry.height == height && entry.amplitude == amplitude;
+    };
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (bytes > cacheLimit)
+            return nullptr;
+        for (auto it = cacheEntries.begin(); it != cacheEntries.end(); ++it) {
+            if (matches(*it)) {
+                cacheEntries.splice(cacheEntries.begin(), cacheEntries, it);
+                return it->wave;
+            }
+        }
+    }
+
+    auto wave = std::make_shared<const DisplacementField>(waveField(amplitude, width, height));
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (const CacheEntry &entry : cacheEntries)
+        if (matches(entry))
+            return entry.wave;
+    cacheEntries.push_front({width, height, amplitude, nullptr, wave});
+    cacheBytes += wave->bytes();
+    evictLocked();
+    return wave;
+}
+
+void setGeometryCacheLimit(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheLimit = bytes;
+    evictLocked();
+}
+
+std::size_t geometryCacheBytes() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return cacheBytes;
+}
+
+void clearGeometryCache() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheEntries.clear();
+    cacheBytes = 0;
+}
@@ -0,0 +1,117 @@
+#ifndef IMAGE_FILTERS_GEOMETRY_CACHE_H
+#define IMAGE_FILTERS_GEOMETRY_CACHE_H
+
+#include "remap.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * \file
+ * \brief Кеш геометрических таблиц фильтров, зависящих только от размеров изображения и параметров
+ */
+
+/**
+ * @brief Вычисляет яркость солнечных лучей для отрезка строки.
+ *
+ * Записывает в out[i] целую часть max(0, sin(10 * angle) * (1 - dist / maxDist)) * 100
+ * для пикселя (x0 + i, y). sin(10 * angle) считается без тригонометрии, как мнимая
+ * часть (dx / dist + i * dy / dist)^10, поэтому цикл векторизуется компилятором.
+ * Отличие от вычисления через atan2 и sin — не более 1.
+ *
+ * @param width Ширина изображения.
+ * @param height Высота изображения.
+ * @param y Номер строки.
+ * @param x0 Координата x первого пикселя.
+ * @param count Количество пикселей.
+ * @param out Буфер минимум на count байтов.
+ */
+void computeSolarRaysRow(int width, int height, int y, int x0, int count, std::uint8_t *out);
+
+/**
+ * @class SolarRaysField
+ * @brief Таблица яркости солнечных лучей для изображения заданного размера.
+ *
+ * Хранит по одному байту (0..100) на пиксель; применение фильтра сводится к
+ * сложению с насыщением значения таблицы с каналами R, G и B.
+ */
+class SolarRaysField {
+public:
+    /**
+     * @brief Строит таблицу, распределяя строки по общему пулу потоков.
+     *
+     * @param width Ширина изображения.
+     * @param height Высота изображения.
+     */
+    SolarRaysField(int width, int height);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /**
+     * @brief Возвращает яркости строки y.
+     *
+     * @param y Номер строки, 0 <= y < getHeight().
+     * @return Указатель на getWidth() байтов.
+     */
+    const std::uint8_t *row(int y) const { return values.data() + static_cast<std::size_t>(y) * width; }
+
+    /**
+     * @brief Возвращает объём таблицы в байтах.
+     *
+     * @return Размер таблицы.
+     */
+    std::size_t bytes() const { return values.size(); }
+
+private:
+    int width;
+    int height;
+    std::vector<std::uint8_t> values;
+};
+
+/**
+ * @brief Возвращает таблицу солнечных лучей из общего кеша, строя её при первом обращении.
+ *
+ * Кеш общий для всех потоков и вызовов; таблицы вытесняются в порядке давности
+ * использования, когда их суммарный объём превышает лимит (см. setGeometryCacheLimit).
+ *
+ * @param width Ширина изображения.
+ * @param height Высота изображения.
+ * @return Таблица; nullptr, если она больше лимита кеша.
+ */
+std::shared_ptr<const SolarRaysField> cachedSolarRaysField(int width, int height);
+
+/**
+ * @brief Возвращает поле волнового искажения (см. waveField) из общего кеша, строя его при первом обращении.
+ *
+ * Кадры последовательности одного размера с одной амплитудой получают одно и то же
+ * поле. Вытеснение общее с таблицами солнечных лучей.
+ *
+ * @param amplitude Амплитуда искажения.
+ * @param width Ширина изображения.
+ * @param height Высота изображения.
+ * @return Поле; nullptr, если оно больше лимита кеша.
+ */
+std::shared_ptr<const DisplacementField> cachedWaveField(float amplitude, int width, int height);
+
+/**
+ * @brief Задаёт лимит объёма кеша геометрических таблиц.
+ *
+ * @param bytes Лимит в байтах (по умолчанию 256 МБ); 0 отключает кеширование.
+ */
+void setGeometryCacheLimit(std::size_t bytes);
+
+/**
+ * @brief Возвращает текущий объём кеша геометрических таблиц.
+ *
+ * @return Суммарный размер таблиц в байтах.
+ */
+std::size_t geometryCacheBytes();
+
+/**
+ * @brief Очищает кеш геометрических таблиц.
+ */
+void clearGeometryCache();
+
+#endif // IMAGE_FILTERS_GEOMETRY_CACHE_H
@@ -1,202 +1,525 @@
 #include "image_filters.h"
-#include <random>
+#include "filter_kernels.h"
+#include "png_encoder.h"
+#include "png_io.h"
+#include "png_reduce.h"
+#include "remap.h"
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <optional>
 #include <stdexcept>
 
-bool Image::load(const std::string &filename) {
-    FILE *file = fopen(filename.c_str(), "rb");
-    if (!file)
-        return false;
+#if defined(__unix__) || defined(__APPLE__)
+#define IMAGE_FILTERS_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SaveOptions SaveOptions::fast() {
+    SaveOptions options;
+    options.compressionLevel = 1;
+    options.strategy = ZlibStrategy::Rle;
+    options.rowFilters = PNG_FILTER_UP;
+    options.parallel = true;
+    return options;
+}
+
+Region Region::clippedTo(int imageWidth, int imageHeight) const {
+    long long x0 = std::max(x, 0), y0 = std::max(y, 0);
+    long long x1 = std::min<long long>(static_cast<long long>(x) + width, imageWidth);
+    long long y1 = std::min<long long>(static_cast<long long>(y) + height, imageHeight);
+    if (x1 <= x0 || y1 <= y0)
+        return {};
+    return {static_cast<int>(x0), static_cast<int>(y0), static_cast<int>(x1 - x0), static_cast<int>(y1 - y0)};
+}
+
+Image::Image(int width, int height, PixelFormat format) { allocate(width, height, format); }
+
+void Image::allocate(int newWidth, int newHeight, PixelFormat newFormat) {
+    width = std::max(newWidth, 0);
+    height = std::max(newHeight, 0);
+    format = newFormat;
+    std::size_t rowBytes = static_cast<std::size_t>(width) * getBytesPerPixel();
+    stride = (rowBytes + kRowAlignment - 1) / kRowAlignment * kRowAlignment;
+    pixels.assign(stride * height, 0);
+    IMAGE_FILTERS_STAT_ADD("image.allocate", allocations, 1);
+    IMAGE_FILTERS_STAT_ADD("image.allocate", bytesOut, pixels.size());
+}
+
+namespace {
+
+// Файлы не меньше этого размера читаются через mmap: ядро отдаёт страницы напрямую,
+// без копирования в буфер stdio.
+constexpr std::size_t kMmapThreshold = 64 * 1024;
+
+struct MemoryReader {
+    const std::uint8_t *data;
+    std::size_t size;
+    std::size_t offset;
+};
+
+void readFromMemory(png_structp png, png_bytep out, png_size_t length) {
+    auto *reader = static_cast<MemoryReader *>(png_get_io_ptr(png));
+    if (length > reader->size - reader->offset)
+        png_error(png, "unexpected end of PNG data");
+    std::memcpy(out, reader->data + reader->offset, length);
+    reader->offset += length;
+}
+
+void appendToVector(png_structp png, png_bytep data, png_size_t length) {
+    auto *out = static_cast<std::vector<std::uint8_t> *>(png_get_io_ptr(png));
+    out->insert(out->end(), data, data + length);
+}
+
+void flushNothing(png_structp) {}
 
-    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+/// Декодирует PNG в img; setupIo(png) подключает источник данных. Без options.format формат файла сохраняется.
+template <typename SetupIo> bool decodePng(Image &img, const LoadOptions &options, SetupIo setupIo) {
+    // Всё с нетривиальным деструктором объявляется до setjmp: longjmp из libpng при
+    // ошибке в данных не вызывает деструкторы, и буферы пула остались бы выданными.
+    IMAGE_FILTERS_STAT_TIMER("load.decode");
+    PooledVector<png_byte> line;
+    PooledVector<png_bytep> rows;
+    png_structp png = createPngReadStruct();
     png_infop info = png ? png_create_info_struct(png) : nullptr;
     if (!png || !info || setjmp(png_jmpbuf(png))) {
         if (png) png_destroy_read_struct(&png, &info, nullptr);
-        fclose(file);
+        img = Image();
         return false;
     }
 
-    png_init_io(png, file);
+    setupIo(png);
     png_read_info(png, info);
 
-    width = png_get_image_width(png, info);
-    height = png_get_image_height(png, info);
-    png_byte color_type = png_get_color_type(png, info);
-    png_byte bit_depth = png_get_bit_depth(png, info);
-
-    if (bit_depth == 16) png_set_strip_16(png);
-    if (color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
-    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) png_set_expand_gray_1_2_4_to_8(png);
-    if (png_get_valid(png, info, PNG_INFO_tRNS)) png_set_tRNS_to_alpha(png);
-    if (color_type != PNG_COLOR_TYPE_RGBA) png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
-
+    int fileWidth = png_get_image_width(png, info);
+    int fileHeight = png_get_image_height(png, info);
+    Region area = options.crop ? options.crop->clippedTo(fileWidth, fileHeight) : Region{0, 0, fileWidth, fileHeight};
+    if (area.empty()) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        img = Image();
+        return false;
+    }
+    // Область читается построчно в исходном формате, а в целевой переводятся только
+    // её столбцы. Adam7 не позволяет остановиться раньше и читается целиком.
+    bool rowwise = options.crop && png_get_interlace_type(png, info) == PNG_INTERLACE_NONE;
+    PixelFormat format = PixelFormat::RGBA8;
+    if (options.format == PixelFormat::RGBA8 && !rowwise)
+        setRgba8ReadTransforms(png, info);
+    else
+        format = setNativeReadTransforms(png, info);
     png_read_update_info(png, info);
 
-    pixels.resize(height, std::vector<std::vector<unsigned char>>(width, std::vector<unsigned char>(4)));
-
-    std::vector<std::vector<png_byte>> row_data(height, std::vector<png_byte>(width * 4));
-    std::vector<png_bytep> rows(height);
-    for (int y = 0; y < height; ++y) rows[y] = row_data[y].data();
-
-    png_read_image(png, rows.data());
-
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            pixels[y][x][0] = row_data[y][x * 4];
-            pixels[y][x][1] = row_data[y][x * 4 + 1];
-            pixels[y][x][2] = row_data[y][x * 4 + 2];
-            pixels[y][x][3] = row_data[y][x * 4 + 3];
+    int newWidth = rowwise ? area.width : fileWidth;
+    int newHeight = rowwise ? area.height : fileHeight;
+    if (img.getWidth() != newWidth || img.getHeight() != newHeight || img.getFormat() != format)
+        img = Image(newWidth, newHeight, format);
+
+    if (rowwise) {
+        std::size_t bpp = img.getBytesPerPixel();
+        line.resize(png_get_rowbytes(png, info));
+        for (int y = 0; y < area.y + area.height; ++y) {
+            png_read_row(png, line.data(), nullptr);
+            if (y >= area.y)
+                std::memcpy(img.row(y - area.y), line.data() + area.x * bpp, area.width * bpp);
         }
+        // Строки ниже области не распаковываются: png_read_end не вызывается.
+    } else {
+        rows.resize(img.getHeight());
+        for (int y = 0; y < img.getHeight(); ++y) rows[y] = img.row(y);
+        png_read_image(png, rows.data());
     }
-
     png_destroy_read_struct(&png, &info, nullptr);
-    fclose(file);
+
+    if (!rowwise && options.crop)
+        img = img.cropped(area);
+    IMAGE_FILTERS_STAT_ADD("load", bytesOut, static_cast<std::size_t>(img.getWidth()) * img.getHeight() * img.getBytesPerPixel());
+    IMAGE_FILTERS_STAT_ADD("load", pixels, static_cast<std::size_t>(img.getWidth()) * img.getHeight());
+
+    if (options.format && img.getFormat() != *options.format)
+        img = img.convertTo(*options.format);
     return true;
 }
 
-bool Image::save(const std::string &filename) const {
-    FILE *file = fopen(filename.c_str(), "wb");
-    if (!file)
-        return false;
-
-    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+/// Записывает img через libpng; непустая палитра означает, что img содержит номера её цветов.
+template <typename SetupIo>
+bool writePngLibpng(const Image &img, const std::vector<Pixel> &palette, const SaveOptions &options, SetupIo setupIo) {
+    int width = img.getWidth();
+    int height = img.getHeight();
+    // Как в decodePng: объекты с деструкторами не должны создаваться после setjmp.
+    IMAGE_FILTERS_STAT_TIMER("save.encode");
+    std::vector<png_color> colors;
+    std::vector<png_byte> alphas;
+    PooledVector<png_bytep> rows;
+    png_structp png = createPngWriteStruct();
     png_infop info = png ? png_create_info_struct(png) : nullptr;
     if (!png || !info || setjmp(png_jmpbuf(png))) {
         if (png)png_destroy_write_struct(&png, &info);
-        fclose(file);
         return false;
     }
 
-    png_init_io(png, file);
-    png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE,
+    setupIo(png);
+    png_set_compression_level(png, std::clamp(options.compressionLevel, 0, 9));
+    if (options.strategy != ZlibStrategy::Auto)
+        png_set_compression_strategy(png, toZlibStrategy(options.strategy, options.rowFilters));
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, options.rowFilters & PNG_ALL_FILTERS ? options.rowFilters : PNG_FILTER_NONE);
+    int colorType, bitDepth;
+    pngColorType(img.getFormat(), colorType, bitDepth);
+    if (!palette.empty())
+        colorType = PNG_COLOR_TYPE_PALETTE;
+    png_set_IHDR(png, info, width, height, bitDepth, colorType, PNG_INTERLACE_NONE,
                  PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-    png_write_info(png, info);
-
-    std::vector<std::vector<png_byte>> row_data(height, std::vector<png_byte>(width * 4));
-    std::vector<png_bytep> rows(height);
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            row_data[y][x * 4] = pixels[y][x][0];
-            row_data[y][x * 4 + 1] = pixels[y][x][1];
-            row_data[y][x * 4 + 2] = pixels[y][x][2];
-            row_data[y][x * 4 + 3] = pixels[y][x][3];
+    if (!palette.empty()) {
+        colors.resize(palette.size());
+        alphas.resize(palette.size());
+        for (std::size_t i = 0; i < palette.size(); ++i) {
+            colors[i] = png_color{palette[i][0], palette[i][1], palette[i][2]};
+            alphas[i] = palette[i][3];
         }
-        rows[y] = row_data[y].data();
+        png_set_PLTE(png, info, colors.data(), static_cast<int>(colors.size()));
+        if (int transparent = paletteAlphaCount(palette))
+            png_set_tRNS(png, info, alphas.data(), transparent, nullptr);
     }
+    png_write_info(png, info);
+    if (bitDepth == 16 && hostIsLittleEndian())
+        png_set_swap(png);
 
+    rows.resize(height);
+    for (int y = 0; y < height; ++y) rows[y] = const_cast<png_bytep>(img.row(y));
     png_write_image(png, rows.data());
     png_write_end(png, nullptr);
 
     png_destroy_write_struct(&png, &info);
-    fclose(file);
     return true;
 }
 
-std::vector<unsigned char> Image::getPixel(int x, int y) const {
-    return (x >= 0 && x < width && y >= 0 && y < height) ? pixels[y][x] : std::vector<unsigned char>{0, 0, 0, 255};
+/// Кодирует img в PNG; setupIo(png) подключает приёмник для libpng, write — для параллельного кодировщика.
+template <typename SetupIo>
+bool encodePng(const Image &img, const SaveOptions &options, SetupIo setupIo,
+               const std::function<bool(const std::uint8_t *, std::size_t)> &write) {
+    IMAGE_FILTERS_STAT_ADD("save", bytesIn, static_cast<std::size_t>(img.getWidth()) * img.getHeight() * img.getBytesPerPixel());
+    IMAGE_FILTERS_STAT_ADD("save", pixels, static_cast<std::size_t>(img.getWidth()) * img.getHeight());
+
+    Image reduced;
+    std::vector<Pixel> palette;
+    bool useReduced = false;
+    if (options.reduceFormat) {
+        IMAGE_FILTERS_STAT_TIMER("save.reduce");
+        useReduced = reduceForPng(img, reduced, palette);
+    }
+    const Image &source = useReduced ? reduced : img;
+
+    if (options.parallel && img.getWidth() > 0 && img.getHeight() > 0) {
+        IMAGE_FILTERS_STAT_TIMER("save.encode");
+        return writePngParallel(source, options, write, palette);
+    }
+    return writePngLibpng(source, palette, options, setupIo);
 }
 
-void Image::setPixel(int x, int y, const std::vector<unsigned char> &color) {
-    if (x >= 0 && x < width && y >= 0 && y < height)
-        pixels[y][x] = color;
+#ifdef IMAGE_FILTERS_HAVE_MMAP
+/// Отображает файл в память и декодирует его; false в loaded означает ошибку декодирования.
+bool loadMapped(Image &img, const LoadOptions &options, int fd, std::size_t size, bool &loaded) {
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED)
+        return false;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    MemoryReader reader{static_cast<const std::uint8_t *>(mapped), size, 0};
+    loaded = decodePng(img, options, [&reader](png_structp png) { png_set_read_fn(png, &reader, readFromMemory); });
+    IMAGE_FILTERS_STAT_ADD("load", bytesIn, reader.offset);
+    munmap(mapped, size);
+    return true;
 }
+#endif
 
-void applySolarRays(Image &img) {
-    int width = img.getWidth();
-    int height = img.getHeight();
-    int centerX = width / 2;
-    int centerY = height / 2;
-    float maxDist = std::sqrt(centerX * centerX + centerY * centerY);
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            float dx = x - centerX;
-            float dy = y - centerY;
-            float dist = std::sqrt(dx * dx + dy * dy);
-            float angle = std::atan2(dy, dx);
-            float intensity = std::sin(angle * 10) * (1.0f - dist / maxDist);
-            intensity = std::max(0.0f, intensity) * 100;
-
-            auto pixel = img.getPixel(x, y);
-            pixel[0] = std::min(255, static_cast<int>(pixel[0] + intensity));
-            pixel[1] = std::min(255, static_cast<int>(pixel[1] + intensity));
-            pixel[2] = std::min(255, static_cast<int>(pixel[2] + intensity));
-            img.setPixel(x, y, pixel);
-        }
+} // namespace
+
+bool Image::load(const std::string &filename) { return load(filename, LoadOptions{}); }
+
+bool Image::load(const std::string &filename, PixelFormat format) { return load(filename, LoadOptions{format, {}}); }
+
+bool Image::load(const std::string &filename, const LoadOptions &options) {
+    IMAGE_FILTERS_STAT_TIMER("load");
+    bool loaded = false;
+#ifdef IMAGE_FILTERS_HAVE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    bool mapped = fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) >= kMmapThreshold &&
+                  loadMapped(*this, options, fd, static_cast<std::size_t>(info.st_size), loaded);
+    close(fd);
+    if (mapped)
+        return loaded;
+#endif
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file)
+        return false;
+    loaded = decodePng(*this, options, [file](png_structp png) { png_init_io(png, file); });
+    IMAGE_FILTERS_STAT_ADD("load", bytesIn, ftell(file));
+    fclose(file);
+    return loaded;
+}
+
+bool Image::loadFromMemory(Span<const std::uint8_t> data) { return loadFromMemory(data, LoadOptions{}); }
+
+bool Image::loadFromMemory(Span<const std::uint8_t> data, PixelFormat format) {
+    return loadFromMemory(data, LoadOptions{format, {}});
+}
+
+bool Image::loadFromMemory(Span<const std::uint8_t> data, const LoadOptions &options) {
+    IMAGE_FILTERS_STAT_TIMER("load");
+    MemoryReader reader{data.data(), data.size(), 0};
+    bool loaded = decodePng(*this, options, [&reader](png_structp png) { png_set_read_fn(png, &reader, readFromMemory); });
+    IMAGE_FILTERS_STAT_ADD("load", bytesIn, reader.offset);
+    return loaded;
+}
+
+bool Image::save(const std::string &filename) const { return save(filename, SaveOptions{}); }
+
+bool Image::save(const std::string &filename, const SaveOptions &options) const {
+    IMAGE_FILTERS_STAT_TIMER("save");
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file)
+        return false;
+
+    bool written = encodePng(*this, options, [file](png_structp png) { png_init_io(png, file); },
+                             [file](const std::uint8_t *data, std::size_t size) {
+                                 return std::fwrite(data, 1, size, file) == size;
+                             });
+    IMAGE_FILTERS_STAT_ADD("save", bytesOut, ftell(file));
+    IMAGE_FILTERS_STAT_TIMER("save.close");
+    return fclose(file) == 0 && written;
+}
+
+bool Image::saveToBuffer(std::vector<std::uint8_t> &out, const SaveOptions &options) const {
+    IMAGE_FILTERS_STAT_TIMER("save");
+    out.clear();
+    bool written = encodePng(*this, options,
+                             [&out](png_structp png) { png_set_write_fn(png, &out, appendToVector, flushNothing); },
+                             [&out](const std::uint8_t *data, std::size_t size) {
+                                 out.insert(out.end(), data, data + size);
+                                 return true;
+                             });
+    IMAGE_FILTERS_STAT_ADD("save", bytesOut, out.size());
+    if (!written)
+        out.clear();
+    return written;
+}
+
+namespace {
+
+// Значения каналов R, G, B, A в 16-битной шкале (0..65535).
+using WideColor = std::array<std::uint32_t, 4>;
+
+std::uint32_t luminance(const WideColor &c) {
+    return static_cast<std::uint32_t>((9798ull * c[0] + 19235ull * c[1] + 3735ull * c[2] + 16384) >> 15);
+}
+
+template <typename Traits> WideColor readColor(const typename Traits::Sample *p) {
+    constexpr std::uint32_t kWiden = Traits::kWide ? 1 : 257;
+    WideColor c;
+    for (int i = 0; i < 3; ++i)
+        c[i] = p[Traits::kColorChannels == 1 ? 0 : i] * kWiden;
+    c[3] = Traits::kAlpha ? p[Traits::kChannels - 1] * kWiden : 65535;
+    return c;
+}
+
+template <typename Traits> void writeColor(typename Traits::Sample *p, const WideColor &c) {
+    using Sample = typename Traits::Sample;
+    auto narrow = [](std::uint32_t v) { return static_cast<Sample>(Traits::kWide ? v : v >> 8); };
+    if constexpr (Traits::kColorChannels == 1) {
+        p[0] = narrow(luminance(c));
+    } else {
+        for (int i = 0; i < 3; ++i)
+            p[i] = narrow(c[i]);
     }
+    if constexpr (Traits::kAlpha)
+        p[Traits::kChannels - 1] = narrow(c[3]);
 }
 
-void applyWaveDistortion(Image &img, float amplitude) {
-    int width = img.getWidth();
-    int height = img.getHeight();
-    Image temp = img;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            float offsetX = amplitude * std::sin(2 * M_PI * y / 128.0f);
-            float offsetY = amplitude * std::cos(2 * M_PI * x / 128.0f);
-            int newX = x + static_cast<int>(offsetX);
-            int newY = y + static_cast<int>(offsetY);
-            auto pixel = temp.getPixel(newX, newY);
-            img.setPixel(x, y, pixel);
-        }
+} // namespace
+
+std::vector<unsigned char> Image::getPixel(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height)
+        return {0, 0, 0, 255};
+    if (format == PixelFormat::RGBA8) {
+        const unsigned char *p = row(y) + x * kChannels;
+        return {p[0], p[1], p[2], p[3]};
     }
+    WideColor c = dispatchPixelFormat(format, [&](auto traits) {
+        using Traits = decltype(traits);
+        return readColor<Traits>(reinterpret_cast<const typename Traits::Sample *>(row(y)) + x * Traits::kChannels);
+    });
+    return {static_cast<unsigned char>(c[0] >> 8), static_cast<unsigned char>(c[1] >> 8),
+            static_cast<unsigned char>(c[2] >> 8), static_cast<unsigned char>(c[3] >> 8)};
 }
 
-void applyColorNoise(Image &img, float intensity) {
-    int width = img.getWidth();
-    int height = img.getHeight();
+void Image::setPixel(int x, int y, const std::vector<unsigned char> &color) {
+    if (x < 0 || x >= width || y < 0 || y >= height || color.size() < kChannels)
+        return;
+    if (format == PixelFormat::RGBA8) {
+        std::memcpy(row(y) + x * kChannels, color.data(), kChannels);
+        return;
+    }
+    WideColor c{color[0] * 257u, color[1] * 257u, color[2] * 257u, color[3] * 257u};
+    dispatchPixelFormat(format, [&](auto traits) {
+        using Traits = decltype(traits);
+        writeColor<Traits>(reinterpret_cast<typename Traits::Sample *>(row(y)) + x * Traits::kChannels, c);
+    });
+}
 
-    static std::mt19937 gen(std::random_device{}());
-    std::uniform_int_distribution<int> dist(-250, 250);
+Image Image::cropped(const Region &region) const {
+    Region area = region.clippedTo(width, height);
+    Image result(area.width, area.height, format);
+    std::size_t offset = static_cast<std::size_t>(area.x) * getBytesPerPixel();
+    std::size_t rowBytes = static_cast<std::size_t>(area.width) * getBytesPerPixel();
+    for (int y = 0; y < area.height; ++y)
+        std::memcpy(result.row(y), row(area.y + y) + offset, rowBytes);
+    return result;
+}
 
-    float noiseFactor = intensity * 3.5f;
+Image Image::convertTo(PixelFormat target) const {
+    if (target == format)
+        return *this;
+    Image result(width, height, target);
+    dispatchPixelFormat(format, [&](auto from) {
+        dispatchPixelFormat(target, [&](auto to) {
+            using From = decltype(from);
+            using To = decltype(to);
+            parallelRows(height, stride, [&](int y) {
+                const auto *src = reinterpret_cast<const typename From::Sample *>(row(y));
+                auto *dst = reinterpret_cast<typename To::Sample *>(result.row(y));
+                for (int x = 0; x < width; ++x)
+                    writeColor<To>(dst + x * To::kChannels, readColor<From>(src + x * From::kChannels));
+            });
+        });
+    });
+    return result;
+}
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            auto pixel = img.getPixel(x, y);
-            int noiseR = static_cast<int>(dist(gen) * noiseFactor);
-            int noiseG = static_cast<int>(dist(gen) * noiseFactor);
-            int noiseB = static_cast<int>(dist(gen) * noiseFactor);
+namespace {
+
+/// Область изображения, которую фильтр обрабатывает как отдельное изображение.
+class RegionView {
+public:
+    RegionView(Image &img, const Region &region)
+        : img(img), area(region.clippedTo(img.getWidth(), img.getHeight())),
+          offset(static_cast<std::size_t>(area.x) * img.getBytesPerPixel()) {}
+
+    int width() const { return area.width; }
+    int height() const { return area.height; }
+    PixelFormat format() const { return img.getFormat(); }
+    std::size_t rowBytes() const { return static_cast<std::size_t>(area.width) * img.getBytesPerPixel(); }
+    std::size_t pixelCount() const { return static_cast<std::size_t>(area.width) * area.height; }
+    std::uint8_t *row(int y) const { return img.row(area.y + y) + offset; }
+
+private:
+    Image &img;
+    Region area;
+    std::size_t offset;
+};
+
+/// Параллельно применяет строчное ядро к области изображения любого формата.
+template <typename Kernel> void applyRowKernel(const RegionView &view, const Kernel &kernel) {
+    parallelRows(view.height(), view.rowBytes(),
+                 [&](int y) { kernel.apply(view.format(), view.row(y), view.width(), y); });
+}
 
-            pixel[0] = std::clamp(pixel[0] + noiseR, 0, 255);
-            pixel[1] = std::clamp(pixel[1] + noiseG, 0, 255);
-            pixel[2] = std::clamp(pixel[2] + noiseB, 0, 255);
-            img.setPixel(x, y, pixel);
-        }
-    }
+} // namespace
+
+void applySolarRays(Image &img) { applySolarRays(img, img.bounds()); }
+
+void applySolarRays(Image &img, const Region &region) {
+    RegionView view(img, region);
+    IMAGE_FILTERS_STAT_TIMER("filter.solar");
+    IMAGE_FILTERS_STAT_ADD("filter.solar", pixels, view.pixelCount());
+    applyRowKernel(view, SolarRaysKernel{view.width(), view.height()});
 }
 
-void applyGlitch(Image &img) {
-    int width = img.getWidth();
-    int height = img.getHeight();
+void applyWaveDistortion(Image &img, float amplitude) { applyWaveDistortion(img, amplitude, img.bounds()); }
+
+void applyWaveDistortion(Image &img, float amplitude, const Region &region) {
+    RegionView view(img, region);
+    IMAGE_FILTERS_STAT_TIMER("filter.wave");
+    IMAGE_FILTERS_STAT_ADD("filter.wave", pixels, view.pixelCount());
+    int width = view.width();
+    int height = view.height();
+    if (width == 0 || height == 0)
+        return;
+
+    std::shared_ptr<const DisplacementField> field = cachedWaveField(amplitude, width, height);
+    if (!field)
+        field = std::make_shared<const DisplacementField>(waveField(amplitude, width, height));
+    remap(img, *field, RemapOptions{}, region);
+}
 
-    static std::mt19937 gen(std::random_device{}());
-    std::uniform_int_distribution<int> dist(0, 20);
-
-    for (int y = 0; y < height; y += 10) {
-        int shift = dist(gen);
-        for (int x = 0; x < width; x++) {
-            int newX = (x + shift) % width;
-            auto pixel = img.getPixel(x, y);
-            if (y % 20 == 0)
-                pixel[0] = std::min(255, pixel[0] + 50);
-            else if (y % 15 == 0)
-                pixel[1] = std::min(255, pixel[1] + 50);
-            img.setPixel(newX, y, pixel);
-        }
+void applyColorNoise(Image &img, float intensity, std::uint64_t seed) {
+    applyColorNoise(img, intensity, seed, img.bounds());
+}
+
+void applyColorNoise(Image &img, float intensity, std::uint64_t seed, const Region &region) {
+    RegionView view(img, region);
+    IMAGE_FILTERS_STAT_TIMER("filter.noise");
+    IMAGE_FILTERS_STAT_ADD("filter.noise", pixels, view.pixelCount());
+    applyRowKernel(view, ColorNoiseKernel{intensity, seed});
+}
+
+void applyGlitch(Image &img, std::uint64_t seed) { applyGlitch(img, seed, GlitchOptions{}); }
+
+void applyGlitch(Image &img, std::uint64_t seed, const GlitchOptions &options) {
+    applyGlitch(img, seed, options, img.bounds());
+}
+
+void applyGlitch(Image &img, std::uint64_t seed, const GlitchOptions &options, const Region &region) {
+    RegionView view(img, region);
+    IMAGE_FILTERS_STAT_TIMER("filter.glitch");
+    IMAGE_FILTERS_STAT_ADD("filter.glitch", pixels, view.pixelCount());
+    GlitchKernel kernel{seed, options};
+    if (options.blockHeight > 0 || options.rowStep <= 0) {
+        applyRowKernel(view, kernel);
+        return;
     }
+    int step = options.rowStep;
+    parallelRows((view.height() + step - 1) / step, view.rowBytes(), [&](int band) {
+        kernel.apply(view.format(), view.row(band * step), view.width(), band * step);
+    });
 }
 
-void applyGrayscale(Image &img) {
-    int width = img.getWidth();
-    int height = img.getHeight();
+void applyGrayscale(Image &img) { applyGrayscale(img, img.bounds()); }
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            auto pixel = img.getPixel(x, y);
-            unsigned char gray = static_cast<unsigned char>(0.299 * pixel[0] + 0.587 * pixel[1] + 0.114 * pixel[2]);
-            pixel[0] = pixel[1] = pixel[2] = gray;
-            img.setPixel(x, y, pixel);
-        }
+void applyGrayscale(Image &img, const Region &region) {
+    RegionView view(img, region);
+    IMAGE_FILTERS_STAT_TIMER("filter.grayscale");
+    IMAGE_FILTERS_STAT_ADD("filter.grayscale", pixels, view.pixelCount());
+    if (img.getFormat() == PixelFormat::G8 || img.getFormat() == PixelFormat::G16)
+        return;
+    applyRowKernel(view, GrayscaleKernel{});
+}
+
+void applyFilter(Image &img, FilterType type, const FilterParams &params) {
+    applyFilter(img, type, params, img.bounds());
+}
+
+void applyFilter(Image &img, FilterType type, const FilterParams &params, const Region &region) {
+    switch (type) {
+    case FilterType::SolarRays:
+        applySolarRays(img, region);
+        break;
+    case FilterType::WaveDistortion:
+        applyWaveDistortion(img, params.amplitude, region);
+        break;
+    case FilterType::ColorNoise:
+        applyColorNoise(img, params.intensity, params.seed, region);
+        break;
+    case FilterType::Glitch:
+        applyGlitch(img, params.seed, params.glitch, region);
+        break;
+    case FilterType::Grayscale:
+        applyGrayscale(img, region);
+        break;
     }
 }
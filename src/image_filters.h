@@ -1,8 +1,19 @@
 #ifndef IMAGE_FILTERS_H
 #define IMAGE_FILTERS_H
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include "buffer_pool.h"
+#include "pixel_format.h"
+#include "thread_pool.h"
 #include <png.h>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 /**
@@ -10,36 +21,262 @@
  * \brief Заголовочный файл для класса Image и функций обработки изображений
  */
 
+/**
+ * @brief Значение пикселя RGBA: четыре байта (красный, зелёный, синий, альфа).
+ *
+ * Имеет тот же размер и раскладку, что и пиксель в буфере Image, поэтому строки
+ * изображения можно обходить как массивы Pixel без копирования.
+ */
+using Pixel = std::array<std::uint8_t, 4>;
+
+static_assert(sizeof(Pixel) == 4, "Pixel must match the RGBA buffer layout");
+
+/**
+ * @brief Невладеющий диапазон элементов (аналог std::span для C++17).
+ *
+ * @tparam T Тип элементов.
+ */
+template <typename T> class Span {
+public:
+    Span() = default;
+
+    /**
+     * @brief Создаёт диапазон из указателя и количества элементов.
+     *
+     * @param data Указатель на первый элемент.
+     * @param size Количество элементов.
+     */
+    Span(T *data, std::size_t size) : ptr(data), count(size) {}
+
+    T *data() const { return ptr; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T *begin() const { return ptr; }
+    T *end() const { return ptr + count; }
+    T &operator[](std::size_t i) const { return ptr[i]; }
+
+private:
+    T *ptr = nullptr;
+    std::size_t count = 0;
+};
+
+/**
+ * @brief Прямоугольная область изображения.
+ */
+struct Region {
+    int x = 0;      ///< Левый столбец.
+    int y = 0;      ///< Верхняя строка.
+    int width = 0;  ///< Ширина в пикселях.
+    int height = 0; ///< Высота в пикселях.
+
+    /**
+     * @brief Проверяет, пуста ли область.
+     *
+     * @return true, если ширина или высота не больше нуля.
+     */
+    bool empty() const { return width <= 0 || height <= 0; }
+
+    /**
+     * @brief Возвращает пересечение области с изображением заданного размера.
+     *
+     * @param imageWidth Ширина изображения.
+     * @param imageHeight Высота изображения.
+     * @return Область внутри изображения; пустая, если пересечения нет.
+     */
+    Region clippedTo(int imageWidth, int imageHeight) const;
+};
+
+/**
+ * @brief Параметры загрузки PNG.
+ */
+struct LoadOptions {
+    std::optional<PixelFormat> format; ///< Формат результата; без него сохраняется формат файла.
+    /**
+     * Загружаемая область (обрезается по границам файла). Строки ниже неё не
+     * распаковываются, столбцы вне неё не копируются и не преобразуются в format.
+     * Файлы с чересстрочной разверткой (Adam7) распаковываются целиком.
+     */
+    std::optional<Region> crop;
+};
+
+/**
+ * @brief Стратегия сжатия zlib при записи PNG.
+ */
+enum class ZlibStrategy {
+    Auto,        ///< Как в libpng: Filtered при фильтрации строк, иначе Default.
+    Default,     ///< Z_DEFAULT_STRATEGY.
+    Filtered,    ///< Z_FILTERED.
+    HuffmanOnly, ///< Z_HUFFMAN_ONLY.
+    Rle,         ///< Z_RLE.
+    Fixed        ///< Z_FIXED.
+};
+
+/**
+ * @brief Параметры записи PNG.
+ *
+ * Значения по умолчанию совпадают с настройками libpng, поэтому Image::save(filename)
+ * записывает тот же файл, что и раньше.
+ */
+struct SaveOptions {
+    int compressionLevel = 6;                  ///< Уровень сжатия zlib, 0..9.
+    ZlibStrategy strategy = ZlibStrategy::Auto; ///< Стратегия zlib.
+    int rowFilters = PNG_ALL_FILTERS;          ///< Допустимые фильтры строк (маски PNG_FILTER_*).
+    /**
+     * Сжимать независимые группы строк параллельно в общем пуле потоков и сшивать
+     * их в один поток IDAT (как pigz). Файл читается любым декодером PNG; результат
+     * не зависит от числа потоков.
+     */
+    bool parallel = false;
+    /**
+     * Перед записью выбрать наименьший тип цвета PNG без потерь: серый, серый с альфой,
+     * RGB или палитру, если цветов не больше 256 (см. reduceForPng в png_reduce.h).
+     * Формат самого изображения не меняется.
+     */
+    bool reduceFormat = false;
+
+    /**
+     * @brief Возвращает набор для быстрой записи.
+     *
+     * Уровень 1, стратегия RLE, единственный фильтр Up и параллельное сжатие: файл
+     * получается больше, но записывается в несколько раз быстрее.
+     *
+     * @return Параметры быстрой записи.
+     */
+    static SaveOptions fast();
+};
+
 /**
  * @class Image
  * @brief Класс для работы с изображениями в формате PNG.
  *
  * Класс Image предоставляет методы для загрузки, сохранения и манипуляции пикселями изображения,
- * используя библиотеку libpng. Изображение хранится в формате RGBA.
+ * используя библиотеку libpng. Изображение хранится в одном непрерывном выровненном
+ * буфере в формате getFormat() (по умолчанию RGBA8); строки расположены с шагом
+ * getStride() байт. Доступ через Pixel (rowPixels, pixelAt, forEachPixel и т. п.)
+ * допустим только для формата RGBA8; getPixel и setPixel работают с любым форматом.
  */
 class Image {
 public:
     /**
-     * @brief Загружает изображение из файла PNG.
+     * @brief Количество байтов на пиксель в формате RGBA8.
+     */
+    static constexpr int kChannels = 4;
+
+    /**
+     * @brief Выравнивание начала буфера и каждой строки в байтах.
+     */
+    static constexpr std::size_t kRowAlignment = 64;
+    static_assert(kRowAlignment <= BufferPool::kAlignment, "pooled pixel buffers must keep rows aligned");
+
+    /**
+     * @brief Создаёт пустое изображение нулевого размера.
+     */
+    Image() = default;
+
+    /**
+     * @brief Создаёт изображение заданного размера, заполненное нулями.
+     *
+     * @param width Ширина в пикселях.
+     * @param height Высота в пикселях.
+     * @param format Формат пикселей.
+     */
+    Image(int width, int height, PixelFormat format = PixelFormat::RGBA8);
+
+    /**
+     * @brief Загружает изображение из файла PNG, сохраняя формат источника.
      *
-     * Загружает изображение, проверяет его формат и сохраняет данные в поле pixels.
-     * Поддерживает преобразование палитры, серого изображения и прозрачности в RGBA.
+     * Серые, серые с альфой, RGB и RGBA файлы загружаются в G8/G16, GA8, RGB8 и
+     * RGBA8/RGBA16 без потери точности. Палитра разворачивается в RGB8 (RGBA8 при
+     * прозрачности), глубина меньше 8 бит — до 8 бит. Форматы, которых нет среди
+     * PixelFormat (серый с альфой и RGB по 16 бит), загружаются как RGBA16.
      *
      * @param filename Путь к файлу PNG.
      * @return true, если загрузка прошла успешно; false, если файл не существует или имеет неверный формат.
      */
     bool load(const std::string &filename);
 
+    /**
+     * @brief Загружает изображение из файла PNG, преобразуя его в заданный формат.
+     *
+     * Загрузка в RGBA8 даёт тот же результат, что и прежняя загрузка: 16-битные
+     * каналы сокращаются до старшего байта, недостающая альфа равна 255.
+     *
+     * @param filename Путь к файлу PNG.
+     * @param format Формат результата.
+     * @return true, если загрузка прошла успешно.
+     */
+    bool load(const std::string &filename, PixelFormat format);
+
+    /**
+     * @brief Загружает изображение или его область из файла PNG.
+     *
+     * С LoadOptions::crop время и память пропорциональны области и строкам над ней,
+     * а не всему файлу: распаковка останавливается на нижней строке области.
+     *
+     * @param filename Путь к файлу PNG.
+     * @param options Формат и область.
+     * @return true, если загрузка прошла успешно; false также при пустом пересечении области с файлом.
+     */
+    bool load(const std::string &filename, const LoadOptions &options);
+
+    /**
+     * @brief Загружает изображение из PNG-данных в памяти.
+     *
+     * Данные читаются libpng напрямую из буфера, без временного файла. Image::load
+     * использует тот же путь для больших файлов, отображая их в память (mmap).
+     *
+     * @param data Содержимое файла PNG.
+     * @return true, если загрузка прошла успешно; false, если данные неполны или имеют неверный формат.
+     */
+    bool loadFromMemory(Span<const std::uint8_t> data);
+
+    /**
+     * @brief Загружает изображение из PNG-данных в памяти, преобразуя его в заданный формат.
+     *
+     * @param data Содержимое файла PNG.
+     * @param format Формат результата.
+     * @return true, если загрузка прошла успешно.
+     */
+    bool loadFromMemory(Span<const std::uint8_t> data, PixelFormat format);
+
+    /**
+     * @brief Загружает изображение или его область из PNG-данных в памяти.
+     *
+     * @param data Содержимое файла PNG.
+     * @param options Формат и область.
+     * @return true, если загрузка прошла успешно.
+     */
+    bool loadFromMemory(Span<const std::uint8_t> data, const LoadOptions &options);
+
     /**
      * @brief Сохраняет изображение в файл PNG.
      *
-     * Сохраняет текущее состояние изображения в указанный файл в формате RGBA.
+     * Сохраняет изображение в его собственном формате: серое, серое с альфой, RGB или
+     * RGBA с глубиной 8 или 16 бит.
      *
      * @param filename Путь к файлу для сохранения.
      * @return true, если сохранение прошло успешно; false, если файл не удалось создать или записать.
      */
     bool save(const std::string &filename) const;
 
+    /**
+     * @brief Сохраняет изображение в файл PNG с заданными параметрами сжатия.
+     *
+     * @param filename Путь к файлу для сохранения.
+     * @param options Параметры записи.
+     * @return true, если сохранение прошло успешно; false, если файл не удалось создать или записать.
+     */
+    bool save(const std::string &filename, const SaveOptions &options) const;
+
+    /**
+     * @brief Кодирует изображение в PNG в памяти.
+     *
+     * @param out Буфер, содержимое которого заменяется файлом PNG; очищается при ошибке.
+     * @param options Параметры записи.
+     * @return true, если кодирование прошло успешно.
+     */
+    bool saveToBuffer(std::vector<std::uint8_t> &out, const SaveOptions &options = SaveOptions{}) const;
+
     /**
      * @brief Возвращает ширину изображения в пикселях.
      *
@@ -54,11 +291,53 @@ public:
      */
     int getHeight() const { return height; }
 
+    /**
+     * @brief Возвращает формат пикселей.
+     *
+     * @return Формат буфера.
+     */
+    PixelFormat getFormat() const { return format; }
+
+    /**
+     * @brief Возвращает число байтов на пиксель в текущем формате.
+     *
+     * @return От 1 до 8.
+     */
+    int getBytesPerPixel() const { return bytesPerPixel(format); }
+
+    /**
+     * @brief Возвращает область, занимаемую всем изображением.
+     *
+     * @return {0, 0, getWidth(), getHeight()}.
+     */
+    Region bounds() const { return {0, 0, width, height}; }
+
+    /**
+     * @brief Возвращает копию области изображения.
+     *
+     * @param region Область; обрезается по границам изображения.
+     * @return Изображение размером с обрезанную область в том же формате.
+     */
+    Image cropped(const Region &region) const;
+
+    /**
+     * @brief Возвращает копию изображения в другом формате.
+     *
+     * Отбрасываемая альфа игнорируется, добавляемая равна максимуму. Цвет переводится
+     * в серый по весам 0.299, 0.587, 0.114; 16-битные значения сокращаются до старшего
+     * байта, 8-битные расширяются умножением на 257.
+     *
+     * @param target Формат результата.
+     * @return Преобразованное изображение.
+     */
+    Image convertTo(PixelFormat target) const;
+
     /**
      * @brief Получает цвет пикселя в указанных координатах.
      *
-     * Возвращает RGBA-значение пикселя в позиции (x, y). Если координаты вне границ,
-     * возвращается чёрный пиксель с полной непрозрачностью (0, 0, 0, 255).
+     * Возвращает RGBA-значение пикселя в позиции (x, y), переведённое в 8 бит на канал.
+     * Если координаты вне границ, возвращается чёрный пиксель с полной непрозрачностью
+     * (0, 0, 0, 255).
      *
      * @param x Координата x (по горизонтали).
      * @param y Координата y (по вертикали).
@@ -69,8 +348,8 @@ public:
     /**
      * @brief Устанавливает цвет пикселя в указанных координатах.
      *
-     * Устанавливает RGBA-значение пикселя в позиции (x, y). Если координаты вне границ,
-     * ничего не происходит.
+     * Устанавливает RGBA-значение пикселя в позиции (x, y), переводя его в формат
+     * изображения. Если координаты вне границ, ничего не происходит.
      *
      * @param x Координата x (по горизонтали).
      * @param y Координата y (по вертикали).
@@ -78,7 +357,98 @@ public:
      */
     void setPixel(int x, int y, const std::vector<unsigned char> &color);
 
+    /**
+     * @brief Возвращает шаг между соседними строками в байтах.
+     *
+     * Шаг не меньше width * getBytesPerPixel() и кратен kRowAlignment.
+     *
+     * @return Шаг строки в байтах; 0, если изображение не загружено.
+     */
+    std::size_t getStride() const { return stride; }
+
+    /**
+     * @brief Возвращает указатель на начало буфера пикселей.
+     *
+     * @return Указатель на первую строку; nullptr, если изображение не загружено.
+     */
+    unsigned char *data() { return pixels.data(); }
+
+    /**
+     * @brief Возвращает указатель на начало буфера пикселей (только чтение).
+     *
+     * @return Указатель на первую строку; nullptr, если изображение не загружено.
+     */
+    const unsigned char *data() const { return pixels.data(); }
+
+    /**
+     * @brief Возвращает указатель на начало строки y без проверки границ.
+     *
+     * @param y Номер строки, 0 <= y < getHeight().
+     * @return Указатель на данные строки.
+     */
+    unsigned char *row(int y) { return pixels.data() + static_cast<std::size_t>(y) * stride; }
+
+    /**
+     * @brief Возвращает указатель на начало строки y без проверки границ (только чтение).
+     *
+     * @param y Номер строки, 0 <= y < getHeight().
+     * @return Указатель на данные строки.
+     */
+    const unsigned char *row(int y) const { return pixels.data() + static_cast<std::size_t>(y) * stride; }
+
+    /**
+     * @brief Возвращает строку y как диапазон пикселей без проверки границ.
+     *
+     * Только для формата RGBA8.
+     *
+     * @param y Номер строки, 0 <= y < getHeight().
+     * @return Диапазон из getWidth() пикселей.
+     */
+    Span<Pixel> rowPixels(int y) { return {reinterpret_cast<Pixel *>(row(y)), static_cast<std::size_t>(width)}; }
+
+    /**
+     * @brief Возвращает строку y как диапазон пикселей без проверки границ (только чтение).
+     *
+     * Только для формата RGBA8.
+     *
+     * @param y Номер строки, 0 <= y < getHeight().
+     * @return Диапазон из getWidth() пикселей.
+     */
+    Span<const Pixel> rowPixels(int y) const {
+        return {reinterpret_cast<const Pixel *>(row(y)), static_cast<std::size_t>(width)};
+    }
+
+    /**
+     * @brief Возвращает ссылку на пиксель (x, y) без проверки границ и без копирования.
+     *
+     * Только для формата RGBA8.
+     *
+     * @param x Координата x, 0 <= x < getWidth().
+     * @param y Координата y, 0 <= y < getHeight().
+     * @return Ссылка на пиксель в буфере изображения.
+     */
+    Pixel &pixelAt(int x, int y) { return reinterpret_cast<Pixel *>(row(y))[x]; }
+
+    /**
+     * @brief Возвращает ссылку на пиксель (x, y) без проверки границ (только чтение).
+     *
+     * @param x Координата x, 0 <= x < getWidth().
+     * @param y Координата y, 0 <= y < getHeight().
+     * @return Константная ссылка на пиксель в буфере изображения.
+     */
+    const Pixel &pixelAt(int x, int y) const { return reinterpret_cast<const Pixel *>(row(y))[x]; }
+
 private:
+
+    /**
+     * @brief Выделяет буфер под изображение заданного размера и формата.
+     *
+     * @param newWidth Ширина в пикселях.
+     * @param newHeight Высота в пикселях.
+     * @param newFormat Формат пикселей.
+     */
+    void allocate(int newWidth, int newHeight, PixelFormat newFormat);
+
     /**
      * @brief Ширина изображения в пикселях.
      *
@@ -94,19 +464,103 @@ private:
     int height = 0;
 
     /**
-     * @brief Массив пикселей изображения в формате RGBA.
+     * @brief Шаг между соседними строками в байтах.
+     */
+    std::size_t stride = 0;
+
+    /**
+     * @brief Формат пикселей буфера.
+     */
+    PixelFormat format = PixelFormat::RGBA8;
+
+    /**
+     * @brief Непрерывный буфер пикселей изображения.
      *
-     * Хранит данные изображения в виде трёхмерного вектора: [y][x][RGBA].
-     * Каждый пиксель представлен четырьмя значениями (красный, зелёный, синий, альфа).
+     * Строка y начинается со смещения y * stride; пиксель (x, y) занимает
+     * getBytesPerPixel() байтов начиная с y * stride + x * getBytesPerPixel().
+     * Память берётся из BufferPool и возвращается в него при уничтожении.
      */
-    std::vector<std::vector<std::vector<unsigned char>>> pixels; // [y][x][RGBA]
+    PooledVector<unsigned char> pixels;
 };
 
+/**
+ * @brief Применяет функцию к каждой строке изображения.
+ *
+ * Функция получает строку как Span<Pixel> и её номер. Тело цикла раскрывается
+ * в месте вызова, что позволяет компилятору встроить и векторизовать обработку.
+ *
+ * @param img Изображение.
+ * @param f Функция вида f(Span<Pixel> row, int y).
+ */
+template <typename F> void transformRows(Image &img, F &&f) {
+    int height = img.getHeight();
+    for (int y = 0; y < height; ++y)
+        f(img.rowPixels(y), y);
+}
+
+/**
+ * @brief Параллельно применяет функцию к каждой строке изображения.
+ *
+ * Аналог transformRows, распределяющий строки по полосам общего пула потоков
+ * (см. setThreadCount). Функция вызывается для разных строк одновременно и не должна
+ * изменять общие данные без синхронизации.
+ *
+ * @param img Изображение.
+ * @param f Функция вида f(Span<Pixel> row, int y).
+ */
+template <typename F> void parallelTransformRows(Image &img, F &&f) {
+    parallelRows(img.getHeight(), img.getStride(), [&img, &f](int y) { f(img.rowPixels(y), y); });
+}
+
+/**
+ * @brief Применяет функцию к каждому пикселю изображения.
+ *
+ * Функция может принимать только пиксель, f(Pixel &), или пиксель с координатами,
+ * f(Pixel &, int x, int y). Пиксели передаются по ссылке, без копирования и без
+ * проверки границ.
+ *
+ * @param img Изображение.
+ * @param f Функция, изменяющая пиксель на месте.
+ */
+template <typename F> void forEachPixel(Image &img, F &&f) {
+    transformRows(img, [&f](Span<Pixel> row, int y) {
+        Pixel *p = row.data();
+        int width = static_cast<int>(row.size());
+        for (int x = 0; x < width; ++x) {
+            if constexpr (std::is_invocable_v<F &, Pixel &, int, int>)
+                f(p[x], x, y);
+            else
+                f(p[x]);
+        }
+    });
+}
+
+/**
+ * @brief Параллельно применяет функцию к каждому пикселю изображения.
+ *
+ * Аналог forEachPixel, распределяющий строки по общему пулу потоков.
+ *
+ * @param img Изображение.
+ * @param f Функция вида f(Pixel &) или f(Pixel &, int x, int y).
+ */
+template <typename F> void parallelForEachPixel(Image &img, F &&f) {
+    parallelTransformRows(img, [&f](Span<Pixel> row, int y) {
+        Pixel *p = row.data();
+        int width = static_cast<int>(row.size());
+        for (int x = 0; x < width; ++x) {
+            if constexpr (std::is_invocable_v<F &, Pixel &, int, int>)
+                f(p[x], x, y);
+            else
+                f(p[x]);
+        }
+    });
+}
+
 /**
  * @brief Применяет эффект солнечных лучей к изображению.
  *
  * Добавляет радиальный эффект, увеличивая яркость пикселей в зависимости от их
- * расстояния от центра изображения и угла.
+ * расстояния от центра изображения и угла. Строки обрабатываются в общем пуле потоков.
  *
  * @param img Изображение, к которому применяется эффект.
  */
@@ -115,8 +569,12 @@ void applySolarRays(Image &img);
 /**
  * @brief Применяет эффект волнового искажения к изображению.
  *
- * Смещает пиксели изображения на основе синусоидальной и косинусоидальной функций,
- * создавая эффект волн.
+ * Пиксель (x, y) берётся из точки (x + dx(y), y + dy(x)) с целыми смещениями
+ * dx = amplitude * sin(2πy / 128) и dy = amplitude * cos(2πx / 128) (см. waveField в
+ * remap.h); точки вне изображения дают непрозрачный чёрный. Разделимое поле смещений
+ * строится один раз на размер и берётся из кеша геометрии, а remap переписывает
+ * изображение на месте полосами в общем пуле потоков, копируя на границах полос не
+ * больше |amplitude| строк соседей.
  *
  * @param img Изображение, к которому применяется эффект.
  * @param amplitude Амплитуда волнового искажения (по умолчанию 10.0).
@@ -127,31 +585,163 @@ void applyWaveDistortion(Image &img, float amplitude = 10.0f);
  * @brief Добавляет случайный цветовой шум к изображению.
  *
  * Применяет случайные изменения к RGB-каналам каждого пикселя, основываясь на
- * заданной интенсивности шума.
+ * заданной интенсивности шума. Шум канала c пикселя (x, y) берётся из генератора
+ * Philox по ключу (seed, x, y, c), поэтому результат зависит только от зерна и
+ * не зависит от числа потоков и порядка обработки.
  *
  * @param img Изображение, к которому применяется шум.
  * @param intensity Интенсивность шума (по умолчанию 0.1).
+ * @param seed Зерно генератора (по умолчанию 0).
+ */
+void applyColorNoise(Image &img, float intensity = 0.1f, std::uint64_t seed = 0);
+
+/**
+ * @brief Параметры эффекта глитча.
+ *
+ * Все эффекты построчные: результат строки зависит только от неё самой, её номера
+ * и зерна, поэтому полосы строк обрабатываются параллельно и воспроизводимо.
  */
-void applyColorNoise(Image &img, float intensity = 0.1f);
+struct GlitchOptions {
+    int rowStep = 10;        ///< Сдвигается каждая rowStep-я строка; 0 отключает сдвиг строк.
+    int maxShift = 20;       ///< Наибольший циклический сдвиг строки вправо, в пикселях.
+    std::uint8_t boost = 50; ///< Усиление красного (строки, кратные 20) и зелёного (кратные 15) каналов.
+    int blockHeight = 0;     ///< Высота полос блочного глитча в строках; 0 отключает блочный глитч.
+    float blockChance = 0.25f; ///< Доля полос, затронутых блочным глитчем.
+    int blockMaxShift = 40;  ///< Наибольший циклический сдвиг полосы в любую сторону, в пикселях.
+    int channelOffset = 0;   ///< Наибольшее расхождение красного и синего каналов в затронутых полосах.
+};
 
 /**
  * @brief Применяет эффект глитча к изображению.
  *
- * Сдвигает строки пикселей и выборочно изменяет цветовые каналы, создавая эффект
- * цифрового сбоя.
+ * Циклически сдвигает строки пикселей и выборочно усиливает цветовые каналы с
+ * насыщением, создавая эффект цифрового сбоя. Сдвиг строки y берётся из генератора
+ * Philox по ключу (seed, y), поэтому результат воспроизводим при одинаковом зерне.
  *
  * @param img Изображение, к которому применяется эффект.
+ * @param seed Зерно генератора (по умолчанию 0).
  */
-void applyGlitch(Image &img);
+void applyGlitch(Image &img, std::uint64_t seed = 0);
+
+/**
+ * @brief Применяет эффект глитча с дополнительными параметрами.
+ *
+ * Кроме сдвига отдельных строк может циклически сдвигать целые полосы строк
+ * (блочный глитч) и разводить в них красный и синий каналы в разные стороны.
+ *
+ * @param img Изображение, к которому применяется эффект.
+ * @param seed Зерно генератора.
+ * @param options Параметры эффекта.
+ */
+void applyGlitch(Image &img, std::uint64_t seed, const GlitchOptions &options);
 
 /**
  * @brief Преобразует изображение в оттенки серого.
  *
  * Преобразует каждый пиксель в оттенок серого, используя стандартные веса
- * для RGB-каналов (0.299R + 0.587G + 0.114B).
+ * для RGB-каналов (0.299R + 0.587G + 0.114B) в арифметике с фиксированной точкой
+ * (погрешность не более 1). Векторная реализация (SSE2/AVX2) выбирается во время
+ * выполнения по возможностям процессора, см. simd.h.
  *
  * @param img Изображение, к которому применяется преобразование.
  */
 void applyGrayscale(Image &img);
 
+/**
+ * @brief Вид фильтра.
+ */
+enum class FilterType {
+    SolarRays,      ///< applySolarRays.
+    WaveDistortion, ///< applyWaveDistortion.
+    ColorNoise,     ///< applyColorNoise.
+    Glitch,         ///< applyGlitch.
+    Grayscale       ///< applyGrayscale.
+};
+
+/**
+ * @brief Параметры фильтра; каждый фильтр использует только относящиеся к нему поля.
+ */
+struct FilterParams {
+    float amplitude = 10.0f; ///< Амплитуда для FilterType::WaveDistortion.
+    float intensity = 0.1f;  ///< Интенсивность для FilterType::ColorNoise.
+    std::uint64_t seed = 0;  ///< Зерно для FilterType::ColorNoise и FilterType::Glitch.
+    GlitchOptions glitch;    ///< Параметры для FilterType::Glitch.
+};
+
+/**
+ * @brief Применяет фильтр заданного вида с параметрами.
+ *
+ * @param img Изображение, к которому применяется фильтр.
+ * @param type Вид фильтра.
+ * @param params Параметры фильтра.
+ */
+void applyFilter(Image &img, FilterType type, const FilterParams &params = {});
+
+/*
+ * Перегрузки с параметром region обрабатывают только область изображения, обрезанную
+ * по его границам, как отдельное изображение: центр лучей, номера строк глитча, ключи
+ * шума и края волны отсчитываются от области. Результат совпадает с обработкой
+ * img.cropped(region) (и, значит, с загрузкой области через LoadOptions::crop),
+ * пиксели вне области не читаются и не меняются, а время пропорционально её площади.
+ */
+
+/**
+ * @brief Применяет эффект солнечных лучей к области изображения.
+ *
+ * @param img Изображение.
+ * @param region Обрабатываемая область.
+ */
+void applySolarRays(Image &img, const Region &region);
+
+/**
+ * @brief Применяет волновое искажение к области изображения.
+ *
+ * Строки и столбцы вне области не используются как источник смещённых пикселей.
+ *
+ * @param img Изображение.
+ * @param amplitude Амплитуда искажения.
+ * @param region Обрабатываемая область.
+ */
+void applyWaveDistortion(Image &img, float amplitude, const Region &region);
+
+/**
+ * @brief Добавляет цветовой шум к области изображения.
+ *
+ * @param img Изображение.
+ * @param intensity Интенсивность шума.
+ * @param seed Зерно генератора.
+ * @param region Обрабатываемая область.
+ */
+void applyColorNoise(Image &img, float intensity, std::uint64_t seed, const Region &region);
+
+/**
+ * @brief Применяет эффект глитча к области изображения.
+ *
+ * Строки сдвигаются циклически в пределах ширины области.
+ *
+ * @param img Изображение.
+ * @param seed Зерно генератора.
+ * @param options Параметры эффекта.
+ * @param region Обрабатываемая область.
+ */
+void applyGlitch(Image &img, std::uint64_t seed, const GlitchOptions &options, const Region &region);
+
+/**
+ * @brief Переводит область изображения в оттенки серого.
+ *
+ * @param img Изображение.
+ * @param region Обрабатываемая область.
+ */
+void applyGrayscale(Image &img, const Region &region);
+
+/**
+ * @brief Применяет фильтр заданного вида к области изображения.
+ *
+ * @param img Изображение.
+ * @param type Вид фильтра.
+ * @param params Параметры фильтра.
+ * @param region Обрабатываемая область.
+ */
+void applyFilter(Image &img, FilterType type, const FilterParams &params, const Region &region);
+
 #endif // IMAGE_FILTERS_H
@@ -0,0 +1,48 @@
+#include "philox.h"
+
+void philoxFillRow(std::uint64_t seed, std::uint32_t stream, int x0, int y, std::size_t count, std::uint32_t *out) {
+    constexpr std::size_t kLanes = 16;
+    constexpr std::uint32_t kMul0 = 0xD2511F53u;
+    constexpr std::uint32_t kMul1 = 0xCD9E8D57u;
+    constexpr std::uint32_t kWeyl0 = 0x9E3779B9u;
+    constexpr std::uint32_t kWeyl1 = 0xBB67AE85u;
+    const PhiloxKey baseKey = philoxKey(seed);
+
+    std::size_t i = 0;
+    for (; i + kLanes <= count; i += kLanes) {
+        std::uint32_t c0[kLanes], c1[kLanes], c2[kLanes], c3[kLanes];
+        for (std::size_t l = 0; l < kLanes; ++l) {
+            c0[l] = static_cast<std::uint32_t>(x0) + static_cast<std::uint32_t>(i + l);
+            c1[l] = static_cast<std::uint32_t>(y);
+            c2[l] = stream;
+            c3[l] = 0;
+        }
+        std::uint32_t k0 = baseKey[0], k1 = baseKey[1];
+        for (int round = 0; round < 10; ++round) {
+            for (std::size_t l = 0; l < kLanes; ++l) {
+                std::uint64_t p0 = static_cast<std::uint64_t>(kMul0) * c0[l];
+                std::uint64_t p1 = static_cast<std::uint64_t>(kMul1) * c2[l];
+                std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1[l] ^ k0;
+                std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3[l] ^ k1;
+                c1[l] = static_cast<std::uint32_t>(p1);
+                c3[l] = static_cast<std::uint32_t>(p0);
+                c0[l] = n0;
+                c2[l] = n2;
+            }
+            k0 += kWeyl0;
+            k1 += kWeyl1;
+        }
+        for (std::size_t l = 0; l < kLanes; ++l) {
+            std::uint32_t *dst = out + 4 * (i + l);
+            dst[0] = c0[l];
+            dst[1] = c1[l];
+            dst[2] = c2[l];
+            dst[3] = c3[l];
+        }
+    }
+    for (; i < count; ++i) {
+        PhiloxCounter words = philoxAt(seed, stream, x0 + static_cast<int>(i), y);
+        for (int c = 0; c < 4; ++c)
+            out[4 * i + c] = words[c];
+    }
+}
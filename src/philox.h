@@ -0,0 +1,106 @@
+#ifndef IMAGE_FILTERS_PHILOX_H
+#define IMAGE_FILTERS_PHILOX_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \file
+ * \brief Счётчиковый генератор случайных чисел Philox4x32-10
+ */
+
+/**
+ * @brief Счётчик Philox: четыре 32-битных слова.
+ */
+using PhiloxCounter = std::array<std::uint32_t, 4>;
+
+/**
+ * @brief Ключ Philox: два 32-битных слова.
+ */
+using PhiloxKey = std::array<std::uint32_t, 2>;
+
+/**
+ * @brief Вычисляет блок Philox4x32-10 для заданных счётчика и ключа.
+ *
+ * Генератор не имеет состояния: одинаковые счётчик и ключ всегда дают одинаковые
+ * четыре слова, поэтому значения для любой точки изображения можно получить
+ * независимо, в любом порядке и из любого потока.
+ *
+ * @param counter Счётчик.
+ * @param key Ключ.
+ * @return Четыре псевдослучайных 32-битных слова.
+ */
+inline PhiloxCounter philox4x32(PhiloxCounter counter, PhiloxKey key) {
+    constexpr std::uint32_t kMul0 = 0xD2511F53u;
+    constexpr std::uint32_t kMul1 = 0xCD9E8D57u;
+    constexpr std::uint32_t kWeyl0 = 0x9E3779B9u;
+    constexpr std::uint32_t kWeyl1 = 0xBB67AE85u;
+    for (int round = 0; round < 10; ++round) {
+        std::uint64_t p0 = static_cast<std::uint64_t>(kMul0) * counter[0];
+        std::uint64_t p1 = static_cast<std::uint64_t>(kMul1) * counter[2];
+        counter = {static_cast<std::uint32_t>(p1 >> 32) ^ counter[1] ^ key[0], static_cast<std::uint32_t>(p1),
+                   static_cast<std::uint32_t>(p0 >> 32) ^ counter[3] ^ key[1], static_cast<std::uint32_t>(p0)};
+        key[0] += kWeyl0;
+        key[1] += kWeyl1;
+    }
+    return counter;
+}
+
+/**
+ * @brief Строит ключ Philox из 64-битного зерна.
+ *
+ * @param seed Зерно.
+ * @return Ключ из младшей и старшей половин зерна.
+ */
+inline PhiloxKey philoxKey(std::uint64_t seed) {
+    return {static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+}
+
+/**
+ * @brief Возвращает случайные слова для точки (x, y) потока stream.
+ *
+ * Слово с индексом c предназначено для канала c пикселя.
+ *
+ * @param seed Зерно.
+ * @param stream Номер потока, разделяющий независимые применения (например, разные фильтры).
+ * @param x Координата x.
+ * @param y Координата y.
+ * @return Четыре слова, по одному на канал.
+ */
+inline PhiloxCounter philoxAt(std::uint64_t seed, std::uint32_t stream, int x, int y) {
+    return philox4x32({static_cast<std::uint32_t>(x), static_cast<std::uint32_t>(y), stream, 0}, philoxKey(seed));
+}
+
+/**
+ * @brief Отображает случайное слово в целое из отрезка [low, high].
+ *
+ * Используется умножение со сдвигом, без деления и ветвлений.
+ *
+ * @param word Случайное 32-битное слово.
+ * @param low Нижняя граница.
+ * @param high Верхняя граница, high >= low.
+ * @return Целое из [low, high].
+ */
+inline int philoxUniformInt(std::uint32_t word, int low, int high) {
+    std::uint64_t span = static_cast<std::uint64_t>(static_cast<std::int64_t>(high) - low + 1);
+    return low + static_cast<int>((word * span) >> 32);
+}
+
+/**
+ * @brief Заполняет случайными словами отрезок строки [x0, x0 + count).
+ *
+ * Эквивалентно out[4 * i + c] = philoxAt(seed, stream, x0 + i, y)[c], но считает
+ * блоками по нескольку счётчиков в раскладке «структура массивов», которую
+ * компилятор векторизует: одна инструкция обрабатывает несколько пикселей.
+ *
+ * @param seed Зерно.
+ * @param stream Номер потока.
+ * @param x0 Координата x первого пикселя.
+ * @param y Координата y строки.
+ * @param count Количество пикселей.
+ * @param out Буфер минимум на 4 * count слов.
+ */
+void philoxFillRow(std::uint64_t seed, std::uint32_t stream, int x0, int y, std::size_t count, std::uint32_t *out);
+
+#endif // IMAGE_FILTERS_PHILOX_H
@@ -0,0 +1,28 @@
+#include "pixel_format.h"
+#include <utility>
+
+namespace {
+
+const std::pair<const char *, PixelFormat> kNames[] = {
+    {"g8", PixelFormat::G8},     {"ga8", PixelFormat::GA8}, {"rgb8", PixelFormat::RGB8},
+    {"rgba8", PixelFormat::RGBA8}, {"g16", PixelFormat::G16}, {"rgba16", PixelFormat::RGBA16},
+};
+
+} // namespace
+
+const char *pixelFormatName(PixelFormat format) {
+    for (const auto &[name, value] : kNames)
+        if (value == format)
+            return name;
+    return "rgba8";
+}
+
+bool parsePixelFormat(const std::string &name, PixelFormat &format) {
+    for (const auto &[candidate, value] : kNames) {
+        if (name == candidate) {
+            format = value;
+            return true;
+        }
+    }
+    return false;
+}
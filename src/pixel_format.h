@@ -0,0 +1,100 @@
+#ifndef IMAGE_FILTERS_PIXEL_FORMAT_H
+#define IMAGE_FILTERS_PIXEL_FORMAT_H
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+/**
+ * \file
+ * \brief Форматы хранения пикселей и их свойства на этапе компиляции
+ */
+
+/**
+ * @brief Формат пикселя в буфере Image.
+ *
+ * 16-битные каналы хранятся как std::uint16_t в порядке байтов процессора.
+ */
+enum class PixelFormat {
+    G8,    ///< Оттенки серого, 8 бит.
+    GA8,   ///< Оттенки серого с альфа-каналом, 8 бит.
+    RGB8,  ///< RGB, 8 бит на канал.
+    RGBA8, ///< RGBA, 8 бит на канал (формат по умолчанию).
+    G16,   ///< Оттенки серого, 16 бит.
+    RGBA16 ///< RGBA, 16 бит на канал.
+};
+
+/**
+ * @brief Свойства формата пикселя на этапе компиляции.
+ *
+ * @tparam F Формат.
+ */
+template <PixelFormat F> struct PixelTraits {
+    static constexpr PixelFormat kFormat = F;
+    static constexpr bool kWide = F == PixelFormat::G16 || F == PixelFormat::RGBA16;
+    static constexpr int kChannels = F == PixelFormat::G8 || F == PixelFormat::G16 ? 1
+                                     : F == PixelFormat::GA8                      ? 2
+                                     : F == PixelFormat::RGB8                     ? 3
+                                                                                  : 4;
+    static constexpr bool kAlpha = kChannels == 2 || kChannels == 4;
+    static constexpr int kColorChannels = kAlpha ? kChannels - 1 : kChannels; ///< Каналы без альфы.
+    static constexpr int kMax = kWide ? 65535 : 255;
+    static constexpr int kScale = kWide ? 257 : 1; ///< Множитель перевода 8-битного значения.
+    using Sample = std::conditional_t<kWide, std::uint16_t, std::uint8_t>;
+};
+
+/**
+ * @brief Вызывает f(PixelTraits<format>{}) с форматом, известным на этапе компиляции.
+ *
+ * @param format Формат.
+ * @param f Обобщённая функция, например лямбда с параметром auto.
+ * @return Результат f.
+ */
+template <typename F> decltype(auto) dispatchPixelFormat(PixelFormat format, F &&f) {
+    switch (format) {
+    case PixelFormat::G8:
+        return f(PixelTraits<PixelFormat::G8>{});
+    case PixelFormat::GA8:
+        return f(PixelTraits<PixelFormat::GA8>{});
+    case PixelFormat::RGB8:
+        return f(PixelTraits<PixelFormat::RGB8>{});
+    case PixelFormat::G16:
+        return f(PixelTraits<PixelFormat::G16>{});
+    case PixelFormat::RGBA16:
+        return f(PixelTraits<PixelFormat::RGBA16>{});
+    default:
+        return f(PixelTraits<PixelFormat::RGBA8>{});
+    }
+}
+
+/**
+ * @brief Возвращает число байтов на пиксель.
+ *
+ * @param format Формат.
+ * @return От 1 (G8) до 8 (RGBA16).
+ */
+inline int bytesPerPixel(PixelFormat format) {
+    return dispatchPixelFormat(format, [](auto traits) {
+        using Traits = decltype(traits);
+        return Traits::kChannels * static_cast<int>(sizeof(typename Traits::Sample));
+    });
+}
+
+/**
+ * @brief Возвращает имя формата: "g8", "ga8", "rgb8", "rgba8", "g16" или "rgba16".
+ *
+ * @param format Формат.
+ * @return Имя формата.
+ */
+const char *pixelFormatName(PixelFormat format);
+
+/**
+ * @brief Разбирает имя формата, возвращаемое pixelFormatName.
+ *
+ * @param name Имя формата.
+ * @param format Результат разбора.
+ * @return true, если имя распознано.
+ */
+bool parsePixelFormat(const std::string &name, PixelFormat &format);
+
+#endif // IMAGE_FILTERS_PIXEL_FORMAT_H
@@ -0,0 +1,129 @@
+#include "planar_image.h"
+#include "filter_kernels.h"
+#include "simd.h"
+#include "stats.h"
+#include <algorithm>
+#include <vector>
+
+PlanarImage::PlanarImage(int width, int height) { allocate(width, height); }
+
+void PlanarImage::allocate(int newWidth, int newHeight) {
+    newWidth = std::max(newWidth, 0);
+    newHeight = std::max(newHeight, 0);
+    if (newWidth == width && newHeight == height && !pixels.empty())
+        return;
+    width = newWidth;
+    height = newHeight;
+    stride = (static_cast<std::size_t>(width) + Image::kRowAlignment - 1) / Image::kRowAlignment * Image::kRowAlignment;
+    pixels.assign(stride * height * kPlanes, 0);
+    IMAGE_FILTERS_STAT_ADD("image.allocate", allocations, 1);
+    IMAGE_FILTERS_STAT_ADD("image.allocate", bytesOut, pixels.size());
+}
+
+void PlanarImage::assign(const Image &img) {
+    if (img.getFormat() != PixelFormat::RGBA8) {
+        assign(img.convertTo(PixelFormat::RGBA8));
+        return;
+    }
+    IMAGE_FILTERS_STAT_TIMER("planar.deinterleave");
+    IMAGE_FILTERS_STAT_ADD("planar.deinterleave", pixels, static_cast<std::size_t>(img.getWidth()) * img.getHeight());
+    allocate(img.getWidth(), img.getHeight());
+    parallelRows(height, static_cast<std::size_t>(width) * kPlanes, [&](int y) {
+        PlanarRow row = rowPlanes(y);
+        deinterleaveRow(img.rowPixels(y).data(), row.width, row.planes.data());
+    });
+}
+
+void PlanarImage::copyTo(Image &img) const {
+    IMAGE_FILTERS_STAT_TIMER("planar.interleave");
+    IMAGE_FILTERS_STAT_ADD("planar.interleave", pixels, static_cast<std::size_t>(width) * height);
+    if (img.getWidth() != width || img.getHeight() != height || img.getFormat() != PixelFormat::RGBA8)
+        img = Image(width, height);
+    parallelRows(height, static_cast<std::size_t>(width) * kPlanes, [&](int y) {
+        const std::uint8_t *const planes[kPlanes] = {row(0, y), row(1, y), row(2, y), row(3, y)};
+        interleaveRow(planes, static_cast<std::size_t>(width), img.rowPixels(y).data());
+    });
+}
+
+Image PlanarImage::toImage() const {
+    Image img;
+    copyTo(img);
+    return img;
+}
+
+bool PlanarImage::load(const std::string &filename, const LoadOptions &options) {
+    LoadOptions rgba = options;
+    rgba.format = PixelFormat::RGBA8;
+    Image staging;
+    if (!staging.load(filename, rgba))
+        return false;
+    assign(staging);
+    return true;
+}
+
+bool PlanarImage::save(const std::string &filename, const SaveOptions &options) const {
+    return toImage().save(filename, options);
+}
+
+namespace {
+
+void applyRowLocal(PlanarImage &img, const std::vector<RowKernel> &fused) {
+    parallelBands(img.getHeight(), static_cast<std::size_t>(img.getWidth()) * PlanarImage::kPlanes, [&](int y0, int y1) {
+        applyRowKernels(fused, y0, y1, [&img](const auto &kernel, int y) { kernel(img.rowPlanes(y), y); });
+    });
+}
+
+// Плоскости переписываются на месте, как Image в applyWaveDistortion (см. remap).
+void applyWave(PlanarImage &img, float amplitude) {
+    WaveKernel kernel(amplitude, img.getWidth(), img.getHeight());
+    remap(img, kernel.getField());
+}
+
+} // namespace
+
+void applySolarRays(PlanarImage &img) { applyFilter(img, FilterType::SolarRays); }
+
+void applyWaveDistortion(PlanarImage &img, float amplitude) {
+    FilterParams params;
+    params.amplitude = amplitude;
+    applyFilter(img, FilterType::WaveDistortion, params);
+}
+
+void applyColorNoise(PlanarImage &img, float intensity, std::uint64_t seed) {
+    FilterParams params;
+    params.intensity = intensity;
+    params.seed = seed;
+    applyFilter(img, FilterType::ColorNoise, params);
+}
+
+void applyGlitch(PlanarImage &img, std::uint64_t seed, const GlitchOptions &options) {
+    FilterParams params;
+    params.seed = seed;
+    params.glitch = options;
+    applyFilter(img, FilterType::Glitch, params);
+}
+
+void applyGrayscale(PlanarImage &img) { applyFilter(img, FilterType::Grayscale); }
+
+void applyFilter(PlanarImage &img, FilterType type, const FilterParams &params) {
+    applyPipeline(img, FilterPipeline().add(type, params));
+}
+
+void applyPipeline(PlanarImage &img, const FilterPipeline &pipeline) {
+    IMAGE_FILTERS_STAT_TIMER("planar.filter");
+    IMAGE_FILTERS_STAT_ADD("planar.filter", pixels,
+                           static_cast<std::size_t>(img.getWidth()) * img.getHeight() * pipeline.stages().size());
+    const std::vector<FilterStage> &stages = pipeline.stages();
+    std::size_t i = 0;
+    while (i < stages.size()) {
+        if (!isRowLocal(stages[i].type)) {
+            applyWave(img, stages[i].params.amplitude);
+            ++i;
+            continue;
+        }
+        std::vector<RowKernel> fused;
+        for (; i < stages.size() && isRowLocal(stages[i].type); ++i)
+            fused.push_back(makeRowKernel(stages[i].type, stages[i].params, img.getWidth(), img.getHeight()));
+        applyRowLocal(img, fused);
+    }
+}
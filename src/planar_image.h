@@ -0,0 +1,228 @@
+#ifndef IMAGE_FILTERS_PLANAR_IMAGE_H
+#define IMAGE_FILTERS_PLANAR_IMAGE_H
+
+#include "filter_pipeline.h"
+#include "image_filters.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * \file
+ * \brief Изображение с плоскостной раскладкой каналов (отдельные плоскости R, G, B и A)
+ */
+
+/**
+ * @brief Раскладка каналов в памяти.
+ */
+enum class ChannelLayout {
+    Interleaved, ///< Каналы пикселя подряд (RGBARGBA...), как в Image.
+    Planar       ///< Каждый канал в своей плоскости (RR..., GG..., BB..., AA...), как в PlanarImage.
+};
+
+/**
+ * @brief Строка изображения с плоскостной раскладкой: по указателю на каждую плоскость.
+ */
+struct PlanarRow {
+    std::array<std::uint8_t *, 4> planes{}; ///< Строки плоскостей R, G, B и A; nullptr для строк вне изображения.
+    std::size_t width = 0;                  ///< Число пикселей в строке.
+};
+
+/**
+ * @class PlanarImage
+ * @brief Изображение RGBA8, каждый канал которого хранится в отдельной плоскости.
+ *
+ * Все четыре плоскости лежат в одном буфере из BufferPool; строка каждой плоскости
+ * выровнена по Image::kRowAlignment. Поканальные операции (усиление канала в глитче,
+ * прибавление яркости лучей, шум) работают с соседними байтами одного канала и
+ * используют всю ширину векторного регистра, а не три байта из четырёх.
+ *
+ * Файлы PNG хранят пиксели подряд, поэтому на границе загрузки и записи строки
+ * раскладываются по плоскостям и собираются обратно векторными deinterleaveRow и
+ * interleaveRow (см. simd.h). Фильтры дают тот же результат, что и для Image.
+ */
+class PlanarImage {
+public:
+    /**
+     * @brief Количество плоскостей.
+     */
+    static constexpr int kPlanes = 4;
+
+    /**
+     * @brief Создаёт пустое изображение нулевого размера.
+     */
+    PlanarImage() = default;
+
+    /**
+     * @brief Создаёт изображение заданного размера, заполненное нулями.
+     *
+     * @param width Ширина в пикселях.
+     * @param height Высота в пикселях.
+     */
+    PlanarImage(int width, int height);
+
+    /**
+     * @brief Раскладывает изображение по плоскостям.
+     *
+     * @param img Изображение; форматы, отличные от RGBA8, сначала преобразуются в RGBA8.
+     */
+    explicit PlanarImage(const Image &img) { assign(img); }
+
+    /**
+     * @brief Заменяет содержимое плоскостями изображения img.
+     *
+     * Буфер переиспользуется, если размер не изменился.
+     *
+     * @param img Изображение; форматы, отличные от RGBA8, сначала преобразуются в RGBA8.
+     */
+    void assign(const Image &img);
+
+    /**
+     * @brief Собирает пиксели в изображение RGBA8.
+     *
+     * @param img Результат; буфер переиспользуется, если размер и формат совпадают.
+     */
+    void copyTo(Image &img) const;
+
+    /**
+     * @brief Возвращает изображение RGBA8 с теми же пикселями.
+     *
+     * @return Изображение с чередующимися каналами.
+     */
+    Image toImage() const;
+
+    /**
+     * @brief Загружает PNG в формате RGBA8 и раскладывает его по плоскостям.
+     *
+     * @param filename Путь к файлу PNG.
+     * @param options Область загрузки; формат всегда RGBA8.
+     * @return true, если загрузка прошла успешно.
+     */
+    bool load(const std::string &filename, const LoadOptions &options = LoadOptions{});
+
+    /**
+     * @brief Собирает пиксели и сохраняет их в PNG.
+     *
+     * @param filename Путь к файлу результата.
+     * @param options Параметры записи.
+     * @return true, если запись прошла успешно.
+     */
+    bool save(const std::string &filename, const SaveOptions &options = SaveOptions{}) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /**
+     * @brief Возвращает шаг между соседними строками плоскости в байтах.
+     *
+     * @return Не меньше getWidth(), кратен Image::kRowAlignment.
+     */
+    std::size_t getStride() const { return stride; }
+
+    /**
+     * @brief Возвращает указатель на начало строки y плоскости channel без проверки границ.
+     *
+     * @param channel Номер плоскости: 0 — R, 1 — G, 2 — B, 3 — A.
+     * @param y Номер строки.
+     * @return Указатель на значения канала в строке.
+     */
+    std::uint8_t *row(int channel, int y) {
+        return pixels.data() + (static_cast<std::size_t>(channel) * height + y) * stride;
+    }
+
+    /**
+     * @brief Возвращает указатель на начало строки плоскости без проверки границ (только чтение).
+     *
+     * @param channel Номер плоскости.
+     * @param y Номер строки.
+     * @return Указатель на значения канала в строке.
+     */
+    const std::uint8_t *row(int channel, int y) const {
+        return pixels.data() + (static_cast<std::size_t>(channel) * height + y) * stride;
+    }
+
+    /**
+     * @brief Возвращает строку y всех плоскостей без проверки границ.
+     *
+     * @param y Номер строки, 0 <= y < getHeight().
+     * @return Указатели на строки четырёх плоскостей.
+     */
+    PlanarRow rowPlanes(int y) {
+        return {{row(0, y), row(1, y), row(2, y), row(3, y)}, static_cast<std::size_t>(width)};
+    }
+
+private:
+    void allocate(int newWidth, int newHeight);
+
+    int width = 0;
+    int height = 0;
+    std::size_t stride = 0;
+
+    /**
+     * @brief Буфер всех плоскостей: плоскость c занимает getHeight() строк начиная с
+     * c * getHeight() * getStride().
+     */
+    PooledVector<std::uint8_t> pixels;
+};
+
+/**
+ * @brief Применяет эффект солнечных лучей к изображению с плоскостями каналов.
+ *
+ * @param img Изображение.
+ */
+void applySolarRays(PlanarImage &img);
+
+/**
+ * @brief Применяет волновое искажение к изображению с плоскостями каналов.
+ *
+ * @param img Изображение.
+ * @param amplitude Амплитуда искажения.
+ */
+void applyWaveDistortion(PlanarImage &img, float amplitude = 10.0f);
+
+/**
+ * @brief Добавляет цветовой шум к изображению с плоскостями каналов.
+ *
+ * @param img Изображение.
+ * @param intensity Интенсивность шума.
+ * @param seed Зерно генератора.
+ */
+void applyColorNoise(PlanarImage &img, float intensity = 0.1f, std::uint64_t seed = 0);
+
+/**
+ * @brief Применяет эффект глитча к изображению с плоскостями каналов.
+ *
+ * @param img Изображение.
+ * @param seed Зерно генератора.
+ * @param options Параметры эффекта.
+ */
+void applyGlitch(PlanarImage &img, std::uint64_t seed = 0, const GlitchOptions &options = GlitchOptions{});
+
+/**
+ * @brief Переводит изображение с плоскостями каналов в оттенки серого.
+ *
+ * @param img Изображение.
+ */
+void applyGrayscale(PlanarImage &img);
+
+/**
+ * @brief Применяет фильтр заданного вида к изображению с плоскостями каналов.
+ *
+ * @param img Изображение.
+ * @param type Вид фильтра.
+ * @param params Параметры фильтра.
+ */
+void applyFilter(PlanarImage &img, FilterType type, const FilterParams &params = {});
+
+/**
+ * @brief Применяет цепочку фильтров к изображению с плоскостями каналов.
+ *
+ * Соседние построчные фильтры объединяются в один проход, как в FilterPipeline::apply.
+ *
+ * @param img Изображение.
+ * @param pipeline Цепочка фильтров.
+ */
+void applyPipeline(PlanarImage &img, const FilterPipeline &pipeline);
+
+#endif // IMAGE_FILTERS_PLANAR_IMAGE_H
@@ -0,0 +1,244 @@
+#include "png_encoder.h"
+#include "buffer_pool.h"
+#include "png_io.h"
+#include "png_reduce.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+namespace {
+
+// Объём несжатых данных одной группы строк: достаточно крупно, чтобы словарь
+// из предыдущей группы почти не ухудшал сжатие, и достаточно мелко для балансировки.
+constexpr std::size_t kChunkBytes = 256 * 1024;
+constexpr std::size_t kWindowBytes = 32 * 1024;
+
+voidpf zlibPoolAlloc(voidpf, uInt items, uInt size) {
+    return poolMalloc(static_cast<std::size_t>(items) * size);
+}
+
+void zlibPoolFree(voidpf, voidpf block) { poolFree(block); }
+
+int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+void applyRowFilter(int type, std::size_t bpp, const std::uint8_t *row, const std::uint8_t *up, std::size_t rowBytes,
+                    std::uint8_t *out) {
+    for (std::size_t i = 0; i < rowBytes; ++i) {
+        int a = i >= bpp ? row[i - bpp] : 0;
+        int b = up ? up[i] : 0;
+        int c = up && i >= bpp ? up[i - bpp] : 0;
+        int predicted = 0;
+        switch (type) {
+        case 1:
+            predicted = a;
+            break;
+        case 2:
+            predicted = b;
+            break;
+        case 3:
+            predicted = (a + b) / 2;
+            break;
+        case 4:
+            predicted = paeth(a, b, c);
+            break;
+        }
+        out[i] = static_cast<std::uint8_t>(row[i] - predicted);
+    }
+}
+
+std::uint64_t filterCost(const std::uint8_t *data, std::size_t count) {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < count; ++i)
+        sum += std::abs(static_cast<int>(static_cast<std::int8_t>(data[i])));
+    return sum;
+}
+
+using Writer = std::function<bool(const std::uint8_t *, std::size_t)>;
+
+void writeChunk(const Writer &write, const char *type, const std::uint8_t *data, std::size_t size, bool &ok) {
+    std::uint8_t header[8] = {static_cast<std::uint8_t>(size >> 24), static_cast<std::uint8_t>(size >> 16),
+                              static_cast<std::uint8_t>(size >> 8), static_cast<std::uint8_t>(size)};
+    std::memcpy(header + 4, type, 4);
+    uLong crc = crc32(0, header + 4, 4);
+    if (size > 0)
+        crc = crc32(crc, data, static_cast<uInt>(size));
+    std::uint8_t trailer[4] = {static_cast<std::uint8_t>(crc >> 24), static_cast<std::uint8_t>(crc >> 16),
+                               static_cast<std::uint8_t>(crc >> 8), static_cast<std::uint8_t>(crc)};
+    ok = ok && write(header, 8) && (size == 0 || write(data, size)) && write(trailer, 4);
+}
+
+} // namespace
+
+int toZlibStrategy(ZlibStrategy strategy, int rowFilters) {
+    switch (strategy) {
+    case ZlibStrategy::Auto:
+        return (rowFilters & PNG_ALL_FILTERS & ~PNG_FILTER_NONE) != 0 ? Z_FILTERED : Z_DEFAULT_STRATEGY;
+    case ZlibStrategy::Default:
+        return Z_DEFAULT_STRATEGY;
+    case ZlibStrategy::Filtered:
+        return Z_FILTERED;
+    case ZlibStrategy::HuffmanOnly:
+        return Z_HUFFMAN_ONLY;
+    case ZlibStrategy::Rle:
+        return Z_RLE;
+    case ZlibStrategy::Fixed:
+        return Z_FIXED;
+    }
+    return Z_DEFAULT_STRATEGY;
+}
+
+void filterPngRow(int rowFilters, int bytesPerPixel, const std::uint8_t *row, const std::uint8_t *previous,
+                  std::size_t rowBytes, std::uint8_t *out) {
+    std::size_t bpp = static_cast<std::size_t>(bytesPerPixel);
+    static const int masks[] = {PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH};
+    int allowed[5];
+    int count = 0;
+    for (int type = 0; type < 5; ++type)
+        if (rowFilters & masks[type])
+            allowed[count++] = type;
+    if (count == 0)
+        allowed[count++] = 0;
+
+    out[0] = static_cast<std::uint8_t>(allowed[0]);
+    applyRowFilter(allowed[0], bpp, row, previous, rowBytes, out + 1);
+    if (count == 1)
+        return;
+
+    thread_local std::vector<std::uint8_t> candidate;
+    candidate.resize(rowBytes);
+    std::uint64_t best = filterCost(out + 1, rowBytes);
+    for (int i = 1; i < count; ++i) {
+        applyRowFilter(allowed[i], bpp, row, previous, rowBytes, candidate.data());
+        std::uint64_t cost = filterCost(candidate.data(), rowBytes);
+        if (cost < best) {
+            best = cost;
+            out[0] = static_cast<std::uint8_t>(allowed[i]);
+            std::memcpy(out + 1, candidate.data(), rowBytes);
+        }
+    }
+}
+
+bool writePngParallel(const Image &img, const SaveOptions &options, const Writer &write,
+                      const std::vector<Pixel> &palette) {
+    int width = img.getWidth();
+    int height = img.getHeight();
+    if (width <= 0 || height <= 0)
+        return false;
+    int colorType, bitDepth;
+    pngColorType(img.getFormat(), colorType, bitDepth);
+    if (!palette.empty())
+        colorType = PNG_COLOR_TYPE_PALETTE;
+    int bpp = img.getBytesPerPixel();
+    std::size_t rowBytes = static_cast<std::size_t>(width) * bpp;
+    std::size_t lineBytes = rowBytes + 1;
+    PooledVector<std::uint8_t> filtered(lineBytes * height);
+    bool swap = bitDepth == 16 && hostIsLittleEndian();
+    parallelRows(height, img.getStride(), [&](int y) {
+        if (!swap) {
+            filterPngRow(options.rowFilters, bpp, img.row(y), y > 0 ? img.row(y - 1) : nullptr, rowBytes,
+                         filtered.data() + lineBytes * y);
+            return;
+        }
+        // PNG хранит 16-битные каналы от старшего байта.
+        thread_local std::vector<std::uint8_t> current, previous;
+        auto bigEndian = [rowBytes](const std::uint8_t *source, std::vector<std::uint8_t> &out) {
+            out.resize(rowBytes);
+            for (std::size_t i = 0; i < rowBytes; i += 2) {
+                out[i] = source[i + 1];
+                out[i + 1] = source[i];
+            }
+        };
+        bigEndian(img.row(y), current);
+        if (y > 0)
+            bigEndian(img.row(y - 1), previous);
+        filterPngRow(options.rowFilters, bpp, current.data(), y > 0 ? previous.data() : nullptr, rowBytes,
+                     filtered.data() + lineBytes * y);
+    });
+
+    int rowsPerChunk = static_cast<int>(std::max<std::size_t>(kChunkBytes / lineBytes, 1));
+    int chunkCount = (height + rowsPerChunk - 1) / rowsPerChunk;
+    int level = std::clamp(options.compressionLevel, 0, 9);
+    int strategy = toZlibStrategy(options.strategy, options.rowFilters);
+    std::vector<PooledVector<std::uint8_t>> compressed(chunkCount);
+    std::vector<uLong> checksums(chunkCount);
+    std::vector<int> failed(chunkCount, 0);
+    ThreadPool::shared().parallelFor(0, chunkCount, 1, [&](int first, int last) {
+        for (int i = first; i < last; ++i) {
+            std::size_t begin = lineBytes * static_cast<std::size_t>(i) * rowsPerChunk;
+            std::size_t end = std::min(begin + lineBytes * rowsPerChunk, filtered.size());
+            const std::uint8_t *input = filtered.data() + begin;
+            checksums[i] = adler32(adler32(0, nullptr, 0), input, static_cast<uInt>(end - begin));
+
+            z_stream stream{};
+            stream.zalloc = zlibPoolAlloc;
+            stream.zfree = zlibPoolFree;
+            if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, strategy) != Z_OK) {
+                failed[i] = 1;
+                continue;
+            }
+            if (begin > 0) {
+                std::size_t window = std::min(begin, kWindowBytes);
+                deflateSetDictionary(&stream, input - window, static_cast<uInt>(window));
+            }
+            PooledVector<std::uint8_t> &out = compressed[i];
+            out.resize(deflateBound(&stream, static_cast<uLong>(end - begin)) + 16);
+            stream.next_in = const_cast<Bytef *>(input);
+            stream.avail_in = static_cast<uInt>(end - begin);
+            stream.next_out = out.data();
+            stream.avail_out = static_cast<uInt>(out.size());
+            int status = deflate(&stream, i + 1 == chunkCount ? Z_FINISH : Z_SYNC_FLUSH);
+            bool ok = i + 1 == chunkCount ? status == Z_STREAM_END : status == Z_OK && stream.avail_in == 0;
+            out.resize(stream.total_out);
+            deflateEnd(&stream);
+            failed[i] = !ok;
+        }
+    });
+    if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+        return false;
+
+    uLong checksum = checksums[0];
+    for (int i = 1; i < chunkCount; ++i) {
+        std::size_t length = std::min(lineBytes * rowsPerChunk, filtered.size() - lineBytes * i * rowsPerChunk);
+        checksum = adler32_combine(checksum, checksums[i], static_cast<z_off_t>(length));
+    }
+    // Заголовок zlib: окно 32 КБ и признак уровня, как в deflateInit.
+    int levelFlag = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    std::uint8_t zlibHeader[2] = {0x78, static_cast<std::uint8_t>(levelFlag << 6)};
+    zlibHeader[1] = static_cast<std::uint8_t>(zlibHeader[1] + 31 - (zlibHeader[0] * 256 + zlibHeader[1]) % 31);
+    compressed.front().insert(compressed.front().begin(), zlibHeader, zlibHeader + 2);
+    for (int shift = 24; shift >= 0; shift -= 8)
+        compressed.back().push_back(static_cast<std::uint8_t>(checksum >> shift));
+
+    static const std::uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::uint8_t header[13] = {static_cast<std::uint8_t>(width >> 24),  static_cast<std::uint8_t>(width >> 16),
+                               static_cast<std::uint8_t>(width >> 8),   static_cast<std::uint8_t>(width),
+                               static_cast<std::uint8_t>(height >> 24), static_cast<std::uint8_t>(height >> 16),
+                               static_cast<std::uint8_t>(height >> 8),  static_cast<std::uint8_t>(height),
+                               static_cast<std::uint8_t>(bitDepth), static_cast<std::uint8_t>(colorType), 0, 0, 0};
+    bool ok = write(signature, sizeof(signature));
+    writeChunk(write, "IHDR", header, sizeof(header), ok);
+    if (!palette.empty()) {
+        std::vector<std::uint8_t> colors, alphas;
+        for (const Pixel &p : palette)
+            colors.insert(colors.end(), p.begin(), p.begin() + 3);
+        for (int i = 0; i < paletteAlphaCount(palette); ++i)
+            alphas.push_back(palette[i][3]);
+        writeChunk(write, "PLTE", colors.data(), colors.size(), ok);
+        if (!alphas.empty())
+            writeChunk(write, "tRNS", alphas.data(), alphas.size(), ok);
+    }
+    for (const PooledVector<std::uint8_t> &chunk : compressed)
+        if (!chunk.empty())
+            writeChunk(write, "IDAT", chunk.data(), chunk.size(), ok);
+    writeChunk(write, "IEND", nullptr, 0, ok);
+    return ok;
+}
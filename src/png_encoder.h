@@ -0,0 +1,56 @@
+#ifndef IMAGE_FILTERS_PNG_ENCODER_H
+#define IMAGE_FILTERS_PNG_ENCODER_H
+
+#include "image_filters.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * \file
+ * \brief Параллельная запись PNG: фильтрация и сжатие групп строк в общем пуле потоков
+ */
+
+/**
+ * @brief Возвращает константу zlib для стратегии сжатия.
+ *
+ * @param strategy Стратегия.
+ * @param rowFilters Маски фильтров строк; для ZlibStrategy::Auto выбор зависит от них так же, как в libpng.
+ * @return Значение Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE или Z_FIXED.
+ */
+int toZlibStrategy(ZlibStrategy strategy, int rowFilters);
+
+/**
+ * @brief Применяет к строке PNG-фильтр из допустимого набора.
+ *
+ * При нескольких допустимых фильтрах выбирается тот, у которого минимальна сумма
+ * модулей отфильтрованных байтов как знаковых (эвристика libpng).
+ *
+ * @param rowFilters Маски PNG_FILTER_*; 0 трактуется как PNG_FILTER_NONE.
+ * @param bytesPerPixel Расстояние до байта соседнего пикселя слева.
+ * @param row Строка в порядке байтов PNG.
+ * @param previous Предыдущая строка; nullptr для первой строки.
+ * @param rowBytes Длина строки в байтах.
+ * @param out Буфер на rowBytes + 1 байт: номер фильтра и отфильтрованная строка.
+ */
+void filterPngRow(int rowFilters, int bytesPerPixel, const std::uint8_t *row, const std::uint8_t *previous,
+                  std::size_t rowBytes, std::uint8_t *out);
+
+/**
+ * @brief Записывает изображение как PNG в его формате, сжимая группы строк параллельно.
+ *
+ * Каждая группа сжимается отдельным потоком deflate со словарём из конца предыдущей
+ * группы и завершается Z_SYNC_FLUSH; контрольная сумма собирается adler32_combine.
+ * Границы групп фиксированы, поэтому файл не зависит от числа потоков.
+ *
+ * @param img Изображение; при непустой палитре — номера цветов в формате G8.
+ * @param options Уровень, стратегия и фильтры строк.
+ * @param write Приёмник байтов файла; возвращает false при ошибке записи.
+ * @param palette Палитра (чанки PLTE и tRNS); пустая — запись в формате img.
+ * @return true, если данные записаны.
+ */
+bool writePngParallel(const Image &img, const SaveOptions &options,
+                      const std::function<bool(const std::uint8_t *, std::size_t)> &write,
+                      const std::vector<Pixel> &palette = {});
+
+#endif // IMAGE_FILTERS_PNG_ENCODER_H
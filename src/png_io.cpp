@@ -0,0 +1,76 @@
+#include "png_io.h"
+#include "buffer_pool.h"
+
+namespace {
+
+png_voidp pngPoolMalloc(png_structp, png_alloc_size_t bytes) { return poolMalloc(bytes); }
+
+void pngPoolFree(png_structp, png_voidp block) { poolFree(block); }
+
+} // namespace
+
+png_structp createPngReadStruct() {
+    return png_create_read_struct_2(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr, nullptr, pngPoolMalloc,
+                                    pngPoolFree);
+}
+
+png_structp createPngWriteStruct() {
+    return png_create_write_struct_2(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr, nullptr, pngPoolMalloc,
+                                     pngPoolFree);
+}
+
+void setRgba8ReadTransforms(png_structp png, png_infop info) {
+    png_byte color_type = png_get_color_type(png, info);
+    png_byte bit_depth = png_get_bit_depth(png, info);
+
+    if (bit_depth == 16) png_set_strip_16(png);
+    if (color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) png_set_expand_gray_1_2_4_to_8(png);
+    if (png_get_valid(png, info, PNG_INFO_tRNS)) png_set_tRNS_to_alpha(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) png_set_gray_to_rgb(png);
+    if (color_type != PNG_COLOR_TYPE_RGBA) png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+}
+
+PixelFormat setNativeReadTransforms(png_structp png, png_infop info) {
+    png_byte color_type = png_get_color_type(png, info);
+    png_byte bit_depth = png_get_bit_depth(png, info);
+    bool transparent = png_get_valid(png, info, PNG_INFO_tRNS) != 0;
+    bool wide = bit_depth == 16;
+
+    if (color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) png_set_expand_gray_1_2_4_to_8(png);
+    if (transparent) png_set_tRNS_to_alpha(png);
+    if (wide && hostIsLittleEndian()) png_set_swap(png);
+
+    bool alpha = transparent || (color_type & PNG_COLOR_MASK_ALPHA) != 0;
+    bool gray = (color_type & PNG_COLOR_MASK_COLOR) == 0;
+    if (!wide) {
+        if (gray)
+            return alpha ? PixelFormat::GA8 : PixelFormat::G8;
+        return alpha ? PixelFormat::RGBA8 : PixelFormat::RGB8;
+    }
+    if (gray && !alpha)
+        return PixelFormat::G16;
+    if (gray) png_set_gray_to_rgb(png);
+    if (!alpha) png_set_filler(png, 0xFFFF, PNG_FILLER_AFTER);
+    return PixelFormat::RGBA16;
+}
+
+void pngColorType(PixelFormat format, int &colorType, int &bitDepth) {
+    switch (format) {
+    case PixelFormat::G8:
+    case PixelFormat::G16:
+        colorType = PNG_COLOR_TYPE_GRAY;
+        break;
+    case PixelFormat::GA8:
+        colorType = PNG_COLOR_TYPE_GRAY_ALPHA;
+        break;
+    case PixelFormat::RGB8:
+        colorType = PNG_COLOR_TYPE_RGB;
+        break;
+    default:
+        colorType = PNG_COLOR_TYPE_RGBA;
+        break;
+    }
+    bitDepth = format == PixelFormat::G16 || format == PixelFormat::RGBA16 ? 16 : 8;
+}
@@ -0,0 +1,72 @@
+#ifndef IMAGE_FILTERS_PNG_IO_H
+#define IMAGE_FILTERS_PNG_IO_H
+
+#include "pixel_format.h"
+#include <png.h>
+
+/**
+ * \file
+ * \brief Общие настройки libpng для загрузки и потоковой обработки
+ */
+
+/**
+ * @brief Создаёт структуру чтения libpng, которая берёт память (и память zlib) из BufferPool.
+ *
+ * @return Структура чтения; nullptr при ошибке.
+ */
+png_structp createPngReadStruct();
+
+/**
+ * @brief Создаёт структуру записи libpng, которая берёт память (и память zlib) из BufferPool.
+ *
+ * @return Структура записи; nullptr при ошибке.
+ */
+png_structp createPngWriteStruct();
+
+/**
+ * @brief Настраивает преобразования чтения так, чтобы каждая строка была RGBA по 8 бит.
+ *
+ * Вызывается после png_read_info и перед png_read_update_info. Палитра, оттенки
+ * серого и прозрачность разворачиваются в RGBA, 16-битные каналы сокращаются до 8 бит.
+ *
+ * @param png Структура чтения libpng.
+ * @param info Структура информации libpng.
+ */
+void setRgba8ReadTransforms(png_structp png, png_infop info);
+
+/**
+ * @brief Настраивает преобразования чтения так, чтобы сохранить формат файла.
+ *
+ * Вызывается после png_read_info и перед png_read_update_info. Палитра и глубина
+ * меньше 8 бит разворачиваются, прозрачность tRNS превращается в альфа-канал,
+ * 16-битные каналы переводятся в порядок байтов процессора. См. Image::load.
+ *
+ * @param png Структура чтения libpng.
+ * @param info Структура информации libpng.
+ * @return Формат, в котором будут прочитаны строки.
+ */
+PixelFormat setNativeReadTransforms(png_structp png, png_infop info);
+
+/**
+ * @brief Возвращает тип цвета и глубину PNG для формата пикселя.
+ *
+ * @param format Формат.
+ * @param colorType PNG_COLOR_TYPE_GRAY, PNG_COLOR_TYPE_GRAY_ALPHA, PNG_COLOR_TYPE_RGB или PNG_COLOR_TYPE_RGBA.
+ * @param bitDepth 8 или 16.
+ */
+void pngColorType(PixelFormat format, int &colorType, int &bitDepth);
+
+/**
+ * @brief Проверяет, что процессор хранит числа от младшего байта к старшему.
+ *
+ * PNG хранит 16-битные каналы от старшего байта, поэтому на таких процессорах их
+ * байты переставляются при чтении и записи.
+ *
+ * @return true для little-endian.
+ */
+inline bool hostIsLittleEndian() {
+    const std::uint16_t probe = 1;
+    return *reinterpret_cast<const std::uint8_t *>(&probe) == 1;
+}
+
+#endif // IMAGE_FILTERS_PNG_IO_H
@@ -0,0 +1,183 @@
+#include "png_reduce.h"
+#include "simd.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace {
+
+constexpr std::size_t kMaxPaletteColors = 256;
+
+std::uint32_t packColor(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a) {
+    return r | static_cast<std::uint32_t>(g) << 8 | static_cast<std::uint32_t>(b) << 16 | static_cast<std::uint32_t>(a) << 24;
+}
+
+Pixel unpackColor(std::uint32_t color) {
+    return {static_cast<std::uint8_t>(color), static_cast<std::uint8_t>(color >> 8), static_cast<std::uint8_t>(color >> 16),
+            static_cast<std::uint8_t>(color >> 24)};
+}
+
+// Множество до 256 цветов с номерами в порядке добавления; открытая адресация в
+// таблице вчетверо больше палитры.
+class ColorTable {
+public:
+    ColorTable() { index.fill(-1); }
+
+    /// Добавляет цвет; false, если он 257-й.
+    bool insert(std::uint32_t color) {
+        std::size_t slot = slotOf(color);
+        for (; index[slot] >= 0; slot = (slot + 1) % kSlots)
+            if (keys[slot] == color)
+                return true;
+        if (colors.size() == kMaxPaletteColors)
+            return false;
+        keys[slot] = color;
+        index[slot] = static_cast<std::int16_t>(colors.size());
+        colors.push_back(color);
+        return true;
+    }
+
+    /// Номер цвета, который уже есть в таблице.
+    std::uint8_t find(std::uint32_t color) const {
+        std::size_t slot = slotOf(color);
+        while (keys[slot] != color || index[slot] < 0)
+            slot = (slot + 1) % kSlots;
+        return static_cast<std::uint8_t>(index[slot]);
+    }
+
+    const std::vector<std::uint32_t> &values() const { return colors; }
+
+private:
+    static constexpr std::size_t kSlots = 4 * kMaxPaletteColors;
+
+    static std::size_t slotOf(std::uint32_t color) { return (color * 2654435761u) >> 22; }
+
+    std::array<std::uint32_t, kSlots> keys{};
+    std::array<std::int16_t, kSlots> index{};
+    std::vector<std::uint32_t> colors;
+};
+
+template <typename Traits> std::uint32_t colorAt(const std::uint8_t *row, int x) {
+    const std::uint8_t *p = row + x * Traits::kChannels;
+    return packColor(p[0], p[1], p[2], Traits::kAlpha ? p[3] : 255);
+}
+
+template <typename Traits> void scanRow(const std::uint8_t *row, int width, ColorUsage &usage) {
+    using Sample = typename Traits::Sample;
+    if constexpr (Traits::kFormat == PixelFormat::RGBA8) {
+        scanColorUsage(reinterpret_cast<const Pixel *>(row), static_cast<std::size_t>(width), usage);
+    } else {
+        const auto *samples = reinterpret_cast<const Sample *>(row);
+        bool gray = usage.gray, opaque = usage.opaque;
+        for (int x = 0; x < width; ++x) {
+            const Sample *p = samples + x * Traits::kChannels;
+            if constexpr (Traits::kColorChannels == 3)
+                gray = gray && p[0] == p[1] && p[1] == p[2];
+            if constexpr (Traits::kAlpha)
+                opaque = opaque && p[Traits::kChannels - 1] == Traits::kMax;
+        }
+        usage.gray = gray;
+        usage.opaque = opaque;
+    }
+}
+
+ColorUsage scanImage(const Image &img) {
+    std::atomic<bool> gray{true}, opaque{true};
+    parallelRows(img.getHeight(), img.getStride(), [&](int y) {
+        ColorUsage usage{gray.load(std::memory_order_relaxed), opaque.load(std::memory_order_relaxed)};
+        if (!usage.gray && !usage.opaque)
+            return;
+        dispatchPixelFormat(img.getFormat(),
+                            [&](auto traits) { scanRow<decltype(traits)>(img.row(y), img.getWidth(), usage); });
+        if (!usage.gray)
+            gray.store(false, std::memory_order_relaxed);
+        if (!usage.opaque)
+            opaque.store(false, std::memory_order_relaxed);
+    });
+    return {gray.load(), opaque.load()};
+}
+
+/// Строит палитру и изображение номеров; false, если цветов больше 256.
+template <typename Traits> bool buildPalette(const Image &img, Image &reduced, std::vector<Pixel> &palette) {
+    int width = img.getWidth();
+    ColorTable seen;
+    for (int y = 0; y < img.getHeight(); ++y) {
+        const std::uint8_t *row = img.row(y);
+        std::uint32_t previous = ~colorAt<Traits>(row, 0);
+        for (int x = 0; x < width; ++x) {
+            std::uint32_t color = colorAt<Traits>(row, x);
+            if (color != previous && !seen.insert(color))
+                return false;
+            previous = color;
+        }
+    }
+
+    std::vector<std::uint32_t> colors = seen.values();
+    std::stable_partition(colors.begin(), colors.end(), [](std::uint32_t c) { return c >> 24 != 255; });
+    ColorTable ordered;
+    for (std::uint32_t color : colors)
+        ordered.insert(color);
+
+    Image indices(width, img.getHeight(), PixelFormat::G8);
+    parallelRows(img.getHeight(), img.getStride(), [&](int y) {
+        const std::uint8_t *row = img.row(y);
+        std::uint8_t *out = indices.row(y);
+        std::uint32_t previous = colorAt<Traits>(row, 0);
+        std::uint8_t index = ordered.find(previous);
+        for (int x = 0; x < width; ++x) {
+            std::uint32_t color = colorAt<Traits>(row, x);
+            if (color != previous) {
+                index = ordered.find(color);
+                previous = color;
+            }
+            out[x] = index;
+        }
+    });
+
+    palette.resize(colors.size());
+    std::transform(colors.begin(), colors.end(), palette.begin(), unpackColor);
+    reduced = std::move(indices);
+    return true;
+}
+
+} // namespace
+
+bool reduceForPng(const Image &img, Image &reduced, std::vector<Pixel> &palette) {
+    palette.clear();
+    PixelFormat format = img.getFormat();
+    if (format == PixelFormat::G8 || format == PixelFormat::G16 || img.getWidth() == 0 || img.getHeight() == 0)
+        return false;
+
+    ColorUsage usage = scanImage(img);
+    if (format == PixelFormat::RGBA16) {
+        if (!usage.gray || !usage.opaque)
+            return false;
+        reduced = img.convertTo(PixelFormat::G16);
+        return true;
+    }
+    if (usage.gray) {
+        PixelFormat target = usage.opaque ? PixelFormat::G8 : PixelFormat::GA8;
+        if (target == format)
+            return false;
+        reduced = img.convertTo(target);
+        return true;
+    }
+    bool paletted = format == PixelFormat::RGB8
+                        ? buildPalette<PixelTraits<PixelFormat::RGB8>>(img, reduced, palette)
+                        : buildPalette<PixelTraits<PixelFormat::RGBA8>>(img, reduced, palette);
+    if (paletted)
+        return true;
+    if (usage.opaque && format == PixelFormat::RGBA8) {
+        reduced = img.convertTo(PixelFormat::RGB8);
+        return true;
+    }
+    return false;
+}
+
+int paletteAlphaCount(const std::vector<Pixel> &palette) {
+    int count = static_cast<int>(palette.size());
+    while (count > 0 && palette[count - 1][3] == 255)
+        --count;
+    return count;
+}
@@ -0,0 +1,36 @@
+#ifndef IMAGE_FILTERS_PNG_REDUCE_H
+#define IMAGE_FILTERS_PNG_REDUCE_H
+
+#include "image_filters.h"
+#include <vector>
+
+/**
+ * \file
+ * \brief Выбор наименьшего типа цвета PNG без потерь (SaveOptions::reduceFormat)
+ */
+
+/**
+ * @brief Подбирает для записи наименьшее представление изображения без потерь.
+ *
+ * Один векторный проход проверяет, равны ли R, G и B у всех пикселей и
+ * непрозрачны ли все пиксели. Серое изображение переводится в G8 или GA8 (G16 для
+ * RGBA16), непрозрачное цветное — в RGB8. Цветное 8-битное изображение, в котором
+ * не больше 256 разных цветов, записывается с палитрой: reduced получает формат G8
+ * с номерами цветов, palette — сами цвета, непрозрачные в конце (так короче tRNS).
+ *
+ * @param img Изображение.
+ * @param reduced Уменьшенное изображение; не меняется, если уменьшить нельзя.
+ * @param palette Палитра; пуста, если палитра не используется.
+ * @return false, если формат img уже наименьший.
+ */
+bool reduceForPng(const Image &img, Image &reduced, std::vector<Pixel> &palette);
+
+/**
+ * @brief Возвращает число элементов палитры, для которых нужен чанк tRNS.
+ *
+ * @param palette Палитра.
+ * @return Номер последнего полупрозрачного цвета плюс один; 0, если все непрозрачны.
+ */
+int paletteAlphaCount(const std::vector<Pixel> &palette);
+
+#endif // IMAGE_FILTERS_PNG_REDUCE_H
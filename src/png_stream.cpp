@@ -0,0 +1,159 @@
+#include "png_stream.h"
+#include "filter_kernels.h"
+#include "png_encoder.h"
+#include "png_io.h"
+#include "stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+
+namespace {
+
+bool loadFilterSave(const std::string &input, const std::string &output, const FilterPipeline &pipeline,
+                    const SaveOptions &options) {
+    Image img;
+    if (!img.load(input))
+        return false;
+    pipeline.apply(img);
+    // Результат не должен зависеть от того, пошла ли цепочка потоком или через память.
+    SaveOptions streamed = options;
+    streamed.reduceFormat = false;
+    streamed.parallel = false;
+    return img.save(output, streamed);
+}
+
+bool isSingleWave(const FilterPipeline &pipeline) {
+    return pipeline.stages().size() == 1 && pipeline.stages()[0].type == FilterType::WaveDistortion;
+}
+
+bool allRowLocal(const FilterPipeline &pipeline) {
+    for (const FilterStage &stage : pipeline.stages())
+        if (!isRowLocal(stage.type))
+            return false;
+    return true;
+}
+
+template <typename Kernel>
+void streamRows(png_structp in, png_structp out, int width, int height, PixelFormat format, const Kernel &kernel,
+                Image &line) {
+    line = Image(width, 1, format);
+    for (int y = 0; y < height; ++y) {
+        png_read_row(in, line.row(0), nullptr);
+        kernel(line.row(0), y);
+        png_write_row(out, line.row(0));
+    }
+}
+
+void streamWave(png_structp in, png_structp out, int width, int height, PixelFormat format, const WaveKernel &kernel,
+                Image &line, Image &ring, std::vector<const std::uint8_t *> &rows) {
+    int reach = kernel.reach();
+    int window = 2 * reach + 1;
+    ring = Image(width, window, format);
+    line = Image(width, 1, format);
+    rows.assign(window, nullptr);
+    int loaded = 0;
+    for (int y = 0; y < height; ++y) {
+        for (; loaded < height && loaded <= y + reach; ++loaded)
+            png_read_row(in, ring.row(loaded % window), nullptr);
+        for (int k = 0; k < window; ++k) {
+            int sy = y - reach + k;
+            rows[k] = sy >= 0 && sy < height ? ring.row(sy % window) : nullptr;
+        }
+        kernel.apply(format, line.row(0), y, rows.data());
+        png_write_row(out, line.row(0));
+    }
+}
+
+} // namespace
+
+bool streamFilter(const std::string &input, const std::string &output, FilterType type, const FilterParams &params,
+                  const SaveOptions &options) {
+    return streamFilter(input, output, FilterPipeline().add(type, params), options);
+}
+
+bool streamFilter(const std::string &input, const std::string &output, const FilterPipeline &pipeline,
+                  const SaveOptions &options) {
+    // Вид прохода не хранится в локальной переменной: она была бы жива через setjmp ниже.
+    if (pipeline.empty() || (!isSingleWave(pipeline) && !allRowLocal(pipeline)))
+        return loadFilterSave(input, output, pipeline, options);
+
+    IMAGE_FILTERS_STAT_TIMER("stream");
+    FILE *inFile = fopen(input.c_str(), "rb");
+    if (!inFile)
+        return false;
+    FILE *volatile outFile = nullptr;
+    Image line, ring;
+    std::vector<RowKernel> fused;
+    std::vector<const std::uint8_t *> windowRows;
+    std::optional<WaveKernel> wave; // до setjmp: longjmp не вызывает деструкторы
+
+    png_structp in = createPngReadStruct();
+    png_infop inInfo = in ? png_create_info_struct(in) : nullptr;
+    png_structp out = createPngWriteStruct();
+    png_infop outInfo = out ? png_create_info_struct(out) : nullptr;
+    if (!in || !inInfo || !out || !outInfo || setjmp(png_jmpbuf(in)) || setjmp(png_jmpbuf(out))) {
+        if (in) png_destroy_read_struct(&in, &inInfo, nullptr);
+        if (out) png_destroy_write_struct(&out, &outInfo);
+        fclose(inFile);
+        if (outFile) {
+            fclose(outFile);
+            std::remove(output.c_str());
+        }
+        return false;
+    }
+
+    png_init_io(in, inFile);
+    png_read_info(in, inInfo);
+
+    if (png_get_interlace_type(in, inInfo) != PNG_INTERLACE_NONE) {
+        png_destroy_read_struct(&in, &inInfo, nullptr);
+        png_destroy_write_struct(&out, &outInfo);
+        fclose(inFile);
+        return loadFilterSave(input, output, pipeline, options);
+    }
+
+    int width = png_get_image_width(in, inInfo);
+    int height = png_get_image_height(in, inInfo);
+    PixelFormat format = setNativeReadTransforms(in, inInfo);
+    png_read_update_info(in, inInfo);
+
+    outFile = fopen(output.c_str(), "wb");
+    if (!outFile)
+        png_error(in, "cannot open output file");
+
+    png_init_io(out, outFile);
+    png_set_compression_level(out, std::clamp(options.compressionLevel, 0, 9));
+    if (options.strategy != ZlibStrategy::Auto)
+        png_set_compression_strategy(out, toZlibStrategy(options.strategy, options.rowFilters));
+    png_set_filter(out, PNG_FILTER_TYPE_BASE, options.rowFilters & PNG_ALL_FILTERS ? options.rowFilters : PNG_FILTER_NONE);
+    int colorType, bitDepth;
+    pngColorType(format, colorType, bitDepth);
+    png_set_IHDR(out, outInfo, width, height, bitDepth, colorType, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(out, outInfo);
+    if (bitDepth == 16 && hostIsLittleEndian())
+        png_set_swap(out);
+
+    if (isSingleWave(pipeline)) {
+        wave.emplace(pipeline.stages()[0].params.amplitude, width, height);
+        streamWave(in, out, width, height, format, *wave, line, ring, windowRows);
+    } else {
+        for (const FilterStage &stage : pipeline.stages())
+            fused.push_back(makeRowKernel(stage.type, stage.params, width, height, false));
+        streamRows(in, out, width, height, format, [&fused, format, width](std::uint8_t *row, int y) {
+            applyRowKernels(fused, y, y + 1, [=](const auto &kernel, int ky) { kernel.apply(format, row, width, ky); });
+        }, line);
+    }
+
+    png_read_end(in, nullptr);
+    png_write_end(out, nullptr);
+    IMAGE_FILTERS_STAT_ADD("stream", bytesIn, ftell(inFile));
+    IMAGE_FILTERS_STAT_ADD("stream", bytesOut, ftell(outFile));
+    IMAGE_FILTERS_STAT_ADD("stream", pixels, static_cast<std::size_t>(width) * height);
+
+    png_destroy_read_struct(&in, &inInfo, nullptr);
+    png_destroy_write_struct(&out, &outInfo);
+    fclose(inFile);
+    fclose(outFile);
+    return true;
+}
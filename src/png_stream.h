@@ -0,0 +1,54 @@
+#ifndef IMAGE_FILTERS_PNG_STREAM_H
+#define IMAGE_FILTERS_PNG_STREAM_H
+
+#include "filter_pipeline.h"
+#include "image_filters.h"
+#include <string>
+
+/**
+ * \file
+ * \brief Потоковая обработка PNG: чтение строки, фильтр, запись строки
+ */
+
+/**
+ * @brief Применяет фильтр к PNG-файлу, не загружая изображение целиком.
+ *
+ * Строки читаются через png_read_row, проходят через фильтр и сразу записываются
+ * через png_write_row, поэтому пиковый расход памяти пропорционален ширине, а не
+ * площади изображения. Поточечные фильтры держат в памяти одну строку; волновое
+ * искажение — кольцевой буфер из 2 * |amplitude| + 1 исходных строк. Результат
+ * совпадает с load(), applyFilter() и save(): формат пикселей файла (серый, RGB,
+ * 16 бит на канал и т. д.) сохраняется. Черезстрочные (Adam7) файлы
+ * обрабатываются через загрузку в память, так как их строки нельзя читать по порядку.
+ *
+ * Из параметров записи используются уровень сжатия, стратегия zlib и фильтры строк.
+ * SaveOptions::reduceFormat и SaveOptions::parallel игнорируются: для них нужно
+ * изображение целиком, а строки записываются по мере обработки.
+ *
+ * @param input Путь к исходному PNG-файлу.
+ * @param output Путь к файлу результата.
+ * @param type Вид фильтра.
+ * @param params Параметры фильтра.
+ * @param options Параметры записи результата.
+ * @return true, если обработка прошла успешно; false при ошибке чтения или записи.
+ */
+bool streamFilter(const std::string &input, const std::string &output, FilterType type,
+                  const FilterParams &params = {}, const SaveOptions &options = SaveOptions{});
+
+/**
+ * @brief Применяет цепочку фильтров к PNG-файлу в потоковом режиме.
+ *
+ * Потоково обрабатываются цепочки только из построчных фильтров (они объединяются
+ * в один проход по каждой строке) и цепочка из одного волнового искажения.
+ * Остальные цепочки выполняются через загрузку в память.
+ *
+ * @param input Путь к исходному PNG-файлу.
+ * @param output Путь к файлу результата.
+ * @param pipeline Цепочка фильтров.
+ * @param options Параметры записи результата (см. выше).
+ * @return true, если обработка прошла успешно; false при ошибке чтения или записи.
+ */
+bool streamFilter(const std::string &input, const std::string &output, const FilterPipeline &pipeline,
+                  const SaveOptions &options = SaveOptions{});
+
+#endif // IMAGE_FILTERS_PNG_STREAM_H
@@ -0,0 +1,495 @@
+#include "remap.h"
+#include "buffer_pool.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+constexpr int kFraction = DisplacementField::kFractionBits;
+constexpr std::int32_t kOne = DisplacementField::kOne;
+constexpr int kTileSize = 64;
+
+template <typename Traits> using SampleOf = typename Traits::Sample;
+template <typename Traits> using PixelOf = std::array<SampleOf<Traits>, Traits::kChannels>;
+
+/// Исходные строки: строка sy плоскости c лежит в rows[c][sy - first].
+struct Source {
+    std::array<const std::uint8_t *const *, PlanarImage::kPlanes> rows;
+    int first;
+    int width;
+    int height;
+};
+
+/// Строки результата по плоскостям, уже смещённые к первому пикселю отрезка.
+using Target = std::array<std::uint8_t *, PlanarImage::kPlanes>;
+
+/// Приводит индекс к [0, n) по правилу E; для Constant возвращает -1 вне изображения.
+template <EdgeMode E> inline int edgeIndex(int i, int n) {
+    if constexpr (E == EdgeMode::Clamp) {
+        return i < 0 ? 0 : i >= n ? n - 1 : i;
+    } else if constexpr (E == EdgeMode::Wrap) {
+        int r = i % n;
+        return r < 0 ? r + n : r;
+    } else {
+        return static_cast<unsigned>(i) < static_cast<unsigned>(n) ? i : -1;
+    }
+}
+
+/// Вызывает f(c) для c = 0 .. Planes - 1 без цикла: с постоянными индексами массивы
+/// плоскостей в sampleSpan остаются в регистрах.
+template <typename F, int... C> inline void forEachPlane(F &f, std::integer_sequence<int, C...>) { (f(C), ...); }
+
+template <int Planes, typename F> inline void forEachPlane(F &&f) {
+    forEachPlane(f, std::make_integer_sequence<int, Planes>{});
+}
+
+/// Заполняет count пикселей результата начиная со столбца x0 строки y в каждой из Planes
+/// плоскостей. Координаты и веса вычисляются один раз на пиксель; border содержит
+/// значение для каждой плоскости подряд.
+template <typename Traits, SampleMode S, EdgeMode E, int Planes>
+void sampleSpan(const Source &src, int y, int x0, int count, const DisplacementRow &offsets, const Target &target,
+                const std::uint8_t *borderBytes) {
+    using Value = PixelOf<Traits>;
+    // Результат пишется байтами, которые могут ссылаться на что угодно, поэтому всё,
+    // что читается в цикле, копируется в локальные переменные.
+    std::array<Value *, Planes> out;
+    std::array<Value, Planes> border;
+    std::array<const std::uint8_t *const *, Planes> rows;
+    forEachPlane<Planes>([&](int c) {
+        out[c] = reinterpret_cast<Value *>(target[c]);
+        border[c] = reinterpret_cast<const Value *>(borderBytes)[c];
+        rows[c] = src.rows[c];
+    });
+    const int first = src.first, width = src.width, height = src.height;
+    const std::int32_t *dx = offsets.dx, *dy = offsets.dy;
+    const std::int32_t baseX = (x0 << kFraction) + offsets.dxBias;
+    const std::int32_t baseY = (y << kFraction) + offsets.dyBias;
+
+    auto fetch = [&](int c, int sx, int sy) -> const Value * {
+        sx = edgeIndex<E>(sx, width);
+        sy = edgeIndex<E>(sy, height);
+        if constexpr (E == EdgeMode::Constant)
+            if (sx < 0 || sy < 0)
+                return &border[c];
+        return reinterpret_cast<const Value *>(rows[c][sy - first]) + sx;
+    };
+
+    for (int i = 0; i < count; ++i) {
+        std::int32_t fx = baseX + (i << kFraction) + dx[i];
+        std::int32_t fy = baseY + dy[i];
+        if constexpr (S == SampleMode::Nearest) {
+            int sx = (fx + kOne / 2) >> kFraction, sy = (fy + kOne / 2) >> kFraction;
+            if constexpr (E == EdgeMode::Constant) {
+                bool inside = static_cast<unsigned>(sx) < static_cast<unsigned>(width) &&
+                              static_cast<unsigned>(sy) < static_cast<unsigned>(height);
+                forEachPlane<Planes>([&](int c) {
+                    out[c][i] = inside ? reinterpret_cast<const Value *>(rows[c][sy - first])[sx] : border[c];
+                });
+            } else {
+                sx = edgeIndex<E>(sx, width);
+                sy = edgeIndex<E>(sy, height);
+                forEachPlane<Planes>(
+                    [&](int c) { out[c][i] = reinterpret_cast<const Value *>(rows[c][sy - first])[sx]; });
+            }
+        } else {
+            int ix = fx >> kFraction, iy = fy >> kFraction;
+            std::uint32_t wx = static_cast<std::uint32_t>(fx & (kOne - 1));
+            std::uint32_t wy = static_cast<std::uint32_t>(fy & (kOne - 1));
+            std::uint32_t w00 = (kOne - wx) * (kOne - wy), w10 = wx * (kOne - wy), w01 = (kOne - wx) * wy, w11 = wx * wy;
+            for (int c = 0; c < Planes; ++c) {
+                // Соседи с нулевым весом не читаются: они могут лежать за пределами окна строк.
+                const Value *p00 = fetch(c, ix, iy);
+                const Value *p10 = wx ? fetch(c, ix + 1, iy) : p00;
+                const Value *p01 = wy ? fetch(c, ix, iy + 1) : p00;
+                const Value *p11 = wx && wy ? fetch(c, ix + 1, iy + 1) : p00;
+                Value result;
+                for (int k = 0; k < Traits::kChannels; ++k) {
+                    std::uint32_t sum = (*p00)[k] * w00 + (*p10)[k] * w10 + (*p01)[k] * w01 + (*p11)[k] * w11;
+                    result[k] = static_cast<SampleOf<Traits>>((sum + (1u << (2 * kFraction - 1))) >> (2 * kFraction));
+                }
+                out[c][i] = result;
+            }
+        }
+    }
+}
+
+using SpanFn = void (*)(const Source &, int, int, int, const DisplacementRow &, const Target &, const std::uint8_t *);
+
+template <typename Traits, SampleMode S, int Planes> SpanFn selectEdge(EdgeMode edge) {
+    switch (edge) {
+    case EdgeMode::Clamp:
+        return sampleSpan<Traits, S, EdgeMode::Clamp, Planes>;
+    case EdgeMode::Wrap:
+        return sampleSpan<Traits, S, EdgeMode::Wrap, Planes>;
+    default:
+        return sampleSpan<Traits, S, EdgeMode::Constant, Planes>;
+    }
+}
+
+/// Сэмплер для planes плоскостей формата format; несколько плоскостей бывают только у G8.
+SpanFn selectSpan(PixelFormat format, int planes, const RemapOptions &options) {
+    if (planes == PlanarImage::kPlanes) {
+        using Traits = PixelTraits<PixelFormat::G8>;
+        constexpr int kPlanes = PlanarImage::kPlanes;
+        return options.sample == SampleMode::Bilinear ? selectEdge<Traits, SampleMode::Bilinear, kPlanes>(options.edge)
+                                                      : selectEdge<Traits, SampleMode::Nearest, kPlanes>(options.edge);
+    }
+    return dispatchPixelFormat(format, [&](auto traits) {
+        using Traits = decltype(traits);
+        return options.sample == SampleMode::Bilinear ? selectEdge<Traits, SampleMode::Bilinear, 1>(options.edge)
+                                                      : selectEdge<Traits, SampleMode::Nearest, 1>(options.edge);
+    });
+}
+
+/// Значение border в формате format.
+std::array<std::uint8_t, 8> borderBytes(PixelFormat format, Pixel border) {
+    std::array<std::uint8_t, 8> bytes{};
+    dispatchPixelFormat(format, [&](auto traits) {
+        using Traits = decltype(traits);
+        PixelOf<Traits> value{};
+        for (int c = 0; c < Traits::kColorChannels; ++c)
+            value[c] = static_cast<SampleOf<Traits>>(border[Traits::kColorChannels == 1 ? 0 : c] * Traits::kScale);
+        if constexpr (Traits::kAlpha)
+            value[Traits::kChannels - 1] = static_cast<SampleOf<Traits>>(border[3] * Traits::kScale);
+        std::memcpy(bytes.data(), &value, sizeof(value));
+    });
+    return bytes;
+}
+
+/// Строки, которые remap обрабатывает как отдельное изображение: область Image (одна
+/// плоскость) или плоскости PlanarImage, которые переписываются одним проходом.
+struct View {
+    std::uint8_t *first;
+    std::size_t stride;
+    int width;
+    int height;
+    PixelFormat format;
+    std::size_t rowBytes;
+    int planes;
+    std::size_t planeStride;
+
+    std::uint8_t *row(int plane, int y) const { return first + plane * planeStride + y * stride; }
+};
+
+/// Копирует строки [y0, y1) всех плоскостей: плоскость c занимает строки c * (y1 - y0) и далее.
+Image copyRows(const View &view, int y0, int y1) {
+    int count = std::max(y1 - y0, 0);
+    Image rows(view.width, count * view.planes, view.format);
+    for (int c = 0; c < view.planes; ++c)
+        for (int y = y0; y < y1; ++y)
+            std::memcpy(rows.row(c * count + y - y0), view.row(c, y), view.rowBytes);
+    return rows;
+}
+
+// Каждая полоса переписывается на месте сверху вниз. Исходные строки соседних
+// полос (не дальше reach) копируются заранее, а уже переписанные строки своей
+// полосы хранятся в кольце из reach + 1 строк.
+void remapBands(const View &view, const DisplacementField &field, SpanFn span, const std::uint8_t *border,
+                int bandCount) {
+    int width = view.width;
+    int height = view.height;
+    int reach = field.reach();
+    struct Band {
+        int y0, y1;
+        Image above, below;
+    };
+    PooledVector<Band> bands(bandCount);
+    for (int b = 0; b < bandCount; ++b) {
+        Band &band = bands[b];
+        band.y0 = static_cast<int>(static_cast<long long>(height) * b / bandCount);
+        band.y1 = static_cast<int>(static_cast<long long>(height) * (b + 1) / bandCount);
+        band.above = copyRows(view, std::max(band.y0 - reach, 0), band.y0);
+        band.below = copyRows(view, band.y1, std::min(band.y1 + reach, height));
+    }
+
+    ThreadPool::shared().parallelFor(0, bandCount, 1, [&](int first, int last) {
+        int windowSize = 2 * reach + 1;
+        PooledVector<const std::uint8_t *> window(static_cast<std::size_t>(windowSize) * view.planes);
+        Source src{{}, 0, width, height};
+        for (int c = 0; c < view.planes; ++c)
+            src.rows[c] = window.data() + c * windowSize;
+        Image ring(width, (reach + 1) * view.planes, view.format);
+        for (int b = first; b < last; ++b) {
+            const Band &band = bands[b];
+            int aboveStart = std::max(band.y0 - reach, 0);
+            int aboveCount = band.y0 - aboveStart;
+            int belowCount = std::min(band.y1 + reach, height) - band.y1;
+            for (int y = band.y0; y < band.y1; ++y) {
+                Target target{};
+                for (int c = 0; c < view.planes; ++c) {
+                    int ringBase = c * (reach + 1);
+                    const std::uint8_t **planeWindow = window.data() + c * windowSize;
+                    std::memcpy(ring.row(ringBase + y % (reach + 1)), view.row(c, y), view.rowBytes);
+                    for (int k = 0; k < windowSize; ++k) {
+                        int sy = y - reach + k;
+                        if (sy < 0 || sy >= height)
+                            planeWindow[k] = nullptr;
+                        else if (sy < band.y0)
+                            planeWindow[k] = band.above.row(c * aboveCount + sy - aboveStart);
+                        else if (sy <= y)
+                            planeWindow[k] = ring.row(ringBase + sy % (reach + 1));
+                        else if (sy < band.y1)
+                            planeWindow[k] = view.row(c, sy);
+                        else
+                            planeWindow[k] = band.below.row(c * belowCount + sy - band.y1);
+                    }
+                    target[c] = view.row(c, y);
+                }
+                src.first = y - reach;
+                span(src, y, 0, width, field.rowView(y, 0), target, border);
+            }
+        }
+    });
+}
+
+// Источник копируется целиком; плитки результата заполняются параллельно.
+void remapTiles(const View &view, const DisplacementField &field, SpanFn span, const std::uint8_t *border) {
+    int width = view.width;
+    int height = view.height;
+    Image source(width, height * view.planes, view.format);
+    parallelRows(height, view.rowBytes * view.planes, [&](int y) {
+        for (int c = 0; c < view.planes; ++c)
+            std::memcpy(source.row(c * height + y), view.row(c, y), view.rowBytes);
+    });
+    PooledVector<const std::uint8_t *> rows(static_cast<std::size_t>(height) * view.planes);
+    for (int y = 0; y < height * view.planes; ++y)
+        rows[y] = source.row(y);
+    Source src{{}, 0, width, height};
+    for (int c = 0; c < view.planes; ++c)
+        src.rows[c] = rows.data() + c * height;
+
+    int tilesX = (width + kTileSize - 1) / kTileSize;
+    int tilesY = (height + kTileSize - 1) / kTileSize;
+    std::size_t bytesPerPixel = view.rowBytes / width;
+    ThreadPool::shared().parallelFor(0, tilesX * tilesY, 1, [&](int first, int last) {
+        for (int t = first; t < last; ++t) {
+            int x0 = t % tilesX * kTileSize;
+            int y0 = t / tilesX * kTileSize;
+            int count = std::min(kTileSize, width - x0);
+            for (int y = y0; y < std::min(y0 + kTileSize, height); ++y) {
+                Target target{};
+                for (int c = 0; c < view.planes; ++c)
+                    target[c] = view.row(c, y) + x0 * bytesPerPixel;
+                span(src, y, x0, count, field.rowView(y, x0), target, border);
+            }
+        }
+    });
+}
+
+// Полосам нужно скопировать 2 * reach строк на полосу; если это больше всего
+// изображения или строки берутся с другого конца (Wrap), проще скопировать всё.
+void remapView(const View &view, const DisplacementField &field, const RemapOptions &options,
+               const std::uint8_t *border) {
+    SpanFn span = selectSpan(view.format, view.planes, options);
+    int bandCount = std::min(getThreadCount(), view.height);
+    if (options.edge != EdgeMode::Wrap && 2LL * field.reach() * bandCount < view.height)
+        remapBands(view, field, span, border, bandCount);
+    else
+        remapTiles(view, field, span, border);
+}
+
+/// Wrap в окне строк заменяется на Clamp: для него нужны все строки.
+RemapOptions windowedOptions(const RemapOptions &options) {
+    RemapOptions windowed = options;
+    if (windowed.edge == EdgeMode::Wrap)
+        windowed.edge = EdgeMode::Clamp;
+    return windowed;
+}
+
+} // namespace
+
+DisplacementField::DisplacementField(int width, int height)
+    : width(std::max(width, 0)), height(std::max(height, 0)),
+      dxs(static_cast<std::size_t>(this->width) * this->height), dys(dxs.size()) {}
+
+DisplacementField DisplacementField::separable(std::vector<std::int32_t> columnDx, std::vector<std::int32_t> columnDy,
+                                               std::vector<std::int32_t> rowDx, std::vector<std::int32_t> rowDy) {
+    DisplacementField field;
+    field.width = static_cast<int>(columnDx.size());
+    field.height = static_cast<int>(rowDx.size());
+    field.separableField = true;
+    columnDy.resize(columnDx.size());
+    rowDy.resize(rowDx.size());
+    auto maxAbs = [](const std::vector<std::int32_t> &values) {
+        std::int32_t result = 0;
+        for (std::int32_t v : values)
+            result = std::max(result, std::abs(v));
+        return result;
+    };
+    field.maxDy = maxAbs(columnDy) + maxAbs(rowDy);
+    field.dxs = std::move(columnDx);
+    field.dys = std::move(columnDy);
+    field.rowDxs = std::move(rowDx);
+    field.rowDys = std::move(rowDy);
+    return field;
+}
+
+DisplacementField DisplacementField::dense(int width, int height,
+                                           const std::function<void(int y, float *dx, float *dy)> &generator) {
+    DisplacementField field(width, height);
+    std::vector<std::int32_t> rowMax(field.height, 0);
+    parallelRows(field.height, static_cast<std::size_t>(field.width) * 8, [&](int y) {
+        thread_local std::vector<float> dx, dy;
+        dx.assign(field.width, 0.0f);
+        dy.assign(field.width, 0.0f);
+        generator(y, dx.data(), dy.data());
+        std::size_t base = static_cast<std::size_t>(y) * field.width;
+        for (int x = 0; x < field.width; ++x) {
+            field.dxs[base + x] = toFixed(dx[x]);
+            field.dys[base + x] = toFixed(dy[x]);
+            rowMax[y] = std::max(rowMax[y], std::abs(field.dys[base + x]));
+        }
+    });
+    for (std::int32_t value : rowMax)
+        field.maxDy = std::max(field.maxDy, value);
+    return field;
+}
+
+std::int32_t DisplacementField::toFixed(float value) { return static_cast<std::int32_t>(std::lround(value * kOne)); }
+
+void DisplacementField::set(int x, int y, float dx, float dy) {
+    std::size_t index = static_cast<std::size_t>(y) * width + x;
+    dxs[index] = toFixed(dx);
+    dys[index] = toFixed(dy);
+    maxDy = std::max(maxDy, std::abs(dys[index]));
+}
+
+void DisplacementField::row(int y, int x0, int count, std::int32_t *dx, std::int32_t *dy) const {
+    if (separableField) {
+        std::int32_t rowDx = rowDxs[y], rowDy = rowDys[y];
+        for (int i = 0; i < count; ++i) {
+            dx[i] = dxs[x0 + i] + rowDx;
+            dy[i] = dys[x0 + i] + rowDy;
+        }
+        return;
+    }
+    std::size_t base = static_cast<std::size_t>(y) * width + x0;
+    std::memcpy(dx, dxs.data() + base, count * sizeof(std::int32_t));
+    std::memcpy(dy, dys.data() + base, count * sizeof(std::int32_t));
+}
+
+int DisplacementField::reach() const { return (maxDy + kOne - 1) >> kFraction; }
+
+void remap(Image &img, const DisplacementField &field, const RemapOptions &options) {
+    remap(img, field, options, img.bounds());
+}
+
+void remap(Image &img, const DisplacementField &field, const RemapOptions &options, const Region &region) {
+    Region area = region.clippedTo(img.getWidth(), img.getHeight());
+    IMAGE_FILTERS_STAT_TIMER("filter.remap");
+    IMAGE_FILTERS_STAT_ADD("filter.remap", pixels, static_cast<std::size_t>(area.width) * area.height);
+    if (area.empty() || field.getWidth() != area.width || field.getHeight() != area.height)
+        return;
+
+    std::size_t bytesPerPixel = static_cast<std::size_t>(img.getBytesPerPixel());
+    View view{img.row(area.y) + area.x * bytesPerPixel, img.getStride(), area.width, area.height, img.getFormat(),
+              area.width * bytesPerPixel, 1, 0};
+    std::array<std::uint8_t, 8> border = borderBytes(img.getFormat(), options.border);
+    remapView(view, field, options, border.data());
+}
+
+void remap(PlanarImage &img, const DisplacementField &field, const RemapOptions &options) {
+    int width = img.getWidth(), height = img.getHeight();
+    IMAGE_FILTERS_STAT_TIMER("filter.remap");
+    IMAGE_FILTERS_STAT_ADD("filter.remap", pixels, static_cast<std::size_t>(width) * height);
+    if (width == 0 || height == 0 || field.getWidth() != width || field.getHeight() != height)
+        return;
+
+    // Каждая плоскость — изображение G8, которое берёт из border свой канал.
+    View view{img.row(0, 0), img.getStride(), width, height, PixelFormat::G8, static_cast<std::size_t>(width),
+              PlanarImage::kPlanes, static_cast<std::size_t>(height) * img.getStride()};
+    remapView(view, field, options, options.border.data());
+}
+
+void remapRow(PixelFormat format, const DisplacementField &field, const RemapOptions &options, std::uint8_t *row,
+              int y, const std::uint8_t *const *window) {
+    std::array<std::uint8_t, 8> border = borderBytes(format, options.border);
+    Source src{{window}, y - field.reach(), field.getWidth(), field.getHeight()};
+    selectSpan(format, 1, windowedOptions(options))(src, y, 0, field.getWidth(), field.rowView(y, 0), Target{row},
+                                                    border.data());
+}
+
+void remapRow(const DisplacementField &field, const RemapOptions &options, const PlanarRow &row, int y,
+              const PlanarRow *window) {
+    int windowSize = 2 * field.reach() + 1;
+    thread_local std::vector<const std::uint8_t *> planeWindows;
+    planeWindows.resize(static_cast<std::size_t>(windowSize) * PlanarImage::kPlanes);
+    Source src{{}, y - field.reach(), field.getWidth(), field.getHeight()};
+    for (int c = 0; c < PlanarImage::kPlanes; ++c) {
+        for (int k = 0; k < windowSize; ++k)
+            planeWindows[c * windowSize + k] = window[k].planes[c];
+        src.rows[c] = planeWindows.data() + c * windowSize;
+    }
+    selectSpan(PixelFormat::G8, PlanarImage::kPlanes, windowedOptions(options))(
+        src, y, 0, field.getWidth(), field.rowView(y, 0), row.planes, options.border.data());
+}
+
+DisplacementField waveField(float amplitude, int width, int height) {
+    width = std::max(width, 0);
+    height = std::max(height, 0);
+    std::vector<std::int32_t> columnDy(width), rowDx(height);
+    for (int y = 0; y < height; y++)
+        rowDx[y] = static_cast<int>(static_cast<float>(amplitude * std::sin(2 * M_PI * y / 128.0f))) * kOne;
+    for (int x = 0; x < width; x++)
+        columnDy[x] = static_cast<int>(static_cast<float>(amplitude * std::cos(2 * M_PI * x / 128.0f))) * kOne;
+    return DisplacementField::separable(std::vector<std::int32_t>(width), std::move(columnDy), std::move(rowDx),
+                                        std::vector<std::int32_t>(height));
+}
+
+DisplacementField swirlField(int width, int height, float angle, float radius) {
+    float cx = width / 2, cy = height / 2;
+    if (radius <= 0.0f)
+        radius = std::min(width, height) / 2.0f;
+    return DisplacementField::dense(width, height, [=](int y, float *dx, float *dy) {
+        float vy = y - cy;
+        for (int x = 0; x < width; ++x) {
+            float vx = x - cx;
+            float r = std::sqrt(vx * vx + vy * vy);
+            if (r >= radius)
+                continue;
+            float t = 1.0f - r / radius;
+            float theta = angle * t * t;
+            float c = std::cos(theta), s = std::sin(theta);
+            dx[x] = vx * c - vy * s - vx;
+            dy[x] = vx * s + vy * c - vy;
+        }
+    });
+}
+
+DisplacementField lensField(int width, int height, float strength) {
+    float cx = width / 2, cy = height / 2;
+    float halfDiagonal = std::sqrt(cx * cx + cy * cy);
+    float scale = halfDiagonal > 0.0f ? 1.0f / (halfDiagonal * halfDiagonal) : 0.0f;
+    return DisplacementField::dense(width, height, [=](int y, float *dx, float *dy) {
+        float vy = y - cy;
+        for (int x = 0; x < width; ++x) {
+            float vx = x - cx;
+            float k = strength * (vx * vx + vy * vy) * scale;
+            dx[x] = vx * k;
+            dy[x] = vy * k;
+        }
+    });
+}
+
+DisplacementField rippleField(int width, int height, float amplitude, float wavelength) {
+    float cx = width / 2, cy = height / 2;
+    float frequency = wavelength > 0.0f ? static_cast<float>(2 * M_PI) / wavelength : 0.0f;
+    return DisplacementField::dense(width, height, [=](int y, float *dx, float *dy) {
+        float vy = y - cy;
+        for (int x = 0; x < width; ++x) {
+            float vx = x - cx;
+            float r = std::sqrt(vx * vx + vy * vy);
+            if (r <= 0.0f)
+                continue;
+            float shift = amplitude * std::sin(r * frequency) / r;
+            dx[x] = vx * shift;
+            dy[x] = vy * shift;
+        }
+    });
+}
@@ -0,0 +1,322 @@
+#ifndef IMAGE_FILTERS_REMAP_H
+#define IMAGE_FILTERS_REMAP_H
+
+#include "image_filters.h"
+#include "planar_image.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * \file
+ * \brief Геометрические преобразования: поле смещений и выборка пикселей по нему
+ */
+
+/**
+ * @brief Способ выборки исходного пикселя по дробным координатам.
+ */
+enum class SampleMode {
+    Nearest, ///< Ближайший пиксель.
+    Bilinear ///< Билинейная интерполяция четырёх соседних пикселей.
+};
+
+/**
+ * @brief Обработка координат за пределами изображения.
+ */
+enum class EdgeMode {
+    Constant, ///< Пиксель заменяется значением RemapOptions::border.
+    Clamp,    ///< Координата прижимается к ближайшему краю.
+    Wrap      ///< Изображение повторяется периодически.
+};
+
+/**
+ * @brief Параметры выборки для remap.
+ */
+struct RemapOptions {
+    SampleMode sample = SampleMode::Nearest; ///< Способ выборки.
+    EdgeMode edge = EdgeMode::Constant;      ///< Обработка краёв.
+    /**
+     * @brief Значение для EdgeMode::Constant в RGBA8.
+     *
+     * В других форматах берутся соответствующие каналы (серый — из R) с переводом в
+     * 16 бит умножением на 257.
+     */
+    Pixel border{0, 0, 0, 255};
+};
+
+/**
+ * @brief Смещения отрезка строки без копирования: dx[i] + dxBias, dy[i] + dyBias.
+ */
+struct DisplacementRow {
+    const std::int32_t *dx; ///< Смещения по x (для разделимого поля — слагаемые столбцов).
+    const std::int32_t *dy; ///< Смещения по y (для разделимого поля — слагаемые столбцов).
+    std::int32_t dxBias;    ///< Слагаемое dx строки; 0 у плотного поля.
+    std::int32_t dyBias;    ///< Слагаемое dy строки; 0 у плотного поля.
+};
+
+/**
+ * @class DisplacementField
+ * @brief Поле смещений: пиксель (x, y) результата берётся из точки (x + dx, y + dy) источника.
+ *
+ * Смещения хранятся в фиксированной точке с kFractionBits дробными битами, поэтому
+ * внутренний цикл выборки обходится целочисленной арифметикой. Поле бывает двух видов:
+ * - разделимое: dx = rowDx[y] + columnDx[x], dy = rowDy[y] + columnDy[x]; занимает
+ *   O(width + height) и подходит для волн и сдвигов;
+ * - плотное: смещение задаётся для каждого пикселя (завихрение, линза, рябь).
+ *
+ * Поле знает наибольшее вертикальное смещение reach(): при небольшом reach remap
+ * переписывает изображение на месте полосами, читая только соседние строки.
+ */
+class DisplacementField {
+public:
+    /**
+     * @brief Число дробных битов смещения.
+     */
+    static constexpr int kFractionBits = 8;
+
+    /**
+     * @brief Единица в фиксированной точке.
+     */
+    static constexpr std::int32_t kOne = 1 << kFractionBits;
+
+    /**
+     * @brief Создаёт пустое поле нулевого размера.
+     */
+    DisplacementField() = default;
+
+    /**
+     * @brief Создаёт плотное поле с нулевыми смещениями.
+     *
+     * @param width Ширина.
+     * @param height Высота.
+     */
+    DisplacementField(int width, int height);
+
+    /**
+     * @brief Создаёт разделимое поле из смещений в фиксированной точке.
+     *
+     * @param columnDx Слагаемое dx для каждого столбца (width значений).
+     * @param columnDy Слагаемое dy для каждого столбца (width значений).
+     * @param rowDx Слагаемое dx для каждой строки (height значений).
+     * @param rowDy Слагаемое dy для каждой строки (height значений).
+     * @return Поле размером columnDx.size() x rowDx.size().
+     */
+    static DisplacementField separable(std::vector<std::int32_t> columnDx, std::vector<std::int32_t> columnDy,
+                                       std::vector<std::int32_t> rowDx, std::vector<std::int32_t> rowDy);
+
+    /**
+     * @brief Строит плотное поле, вычисляя строки параллельно в общем пуле.
+     *
+     * Основа генераторов геометрических эффектов: генератору достаточно описать
+     * смещения одной строки в пикселях.
+     *
+     * @param width Ширина.
+     * @param height Высота.
+     * @param generator f(y, dx, dy): заполняет width смещений строки y (изначально нули).
+     * @return Поле.
+     */
+    static DisplacementField dense(int width, int height,
+                                   const std::function<void(int y, float *dx, float *dy)> &generator);
+
+    /**
+     * @brief Переводит смещение в пикселях в фиксированную точку с округлением.
+     *
+     * @param value Смещение в пикселях.
+     * @return Смещение в единицах 1 / kOne пикселя.
+     */
+    static std::int32_t toFixed(float value);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    bool isSeparable() const { return separableField; }
+
+    /**
+     * @brief Задаёт смещение пикселя плотного поля.
+     *
+     * @param x Столбец.
+     * @param y Строка.
+     * @param dx Смещение по x в пикселях.
+     * @param dy Смещение по y в пикселях.
+     */
+    void set(int x, int y, float dx, float dy);
+
+    /**
+     * @brief Возвращает смещения отрезка строки в фиксированной точке.
+     *
+     * @param y Номер строки.
+     * @param x0 Первый столбец.
+     * @param count Число пикселей.
+     * @param dx Буфер на count смещений по x.
+     * @param dy Буфер на count смещений по y.
+     */
+    void row(int y, int x0, int count, std::int32_t *dx, std::int32_t *dy) const;
+
+    /**
+     * @brief Возвращает смещения строки начиная со столбца x0 без копирования.
+     *
+     * @param y Номер строки.
+     * @param x0 Первый столбец.
+     * @return Указатели на таблицы поля и слагаемые строки.
+     */
+    DisplacementRow rowView(int y, int x0) const {
+        if (separableField)
+            return {dxs.data() + x0, dys.data() + x0, rowDxs[y], rowDys[y]};
+        std::size_t base = static_cast<std::size_t>(y) * width + x0;
+        return {dxs.data() + base, dys.data() + base, 0, 0};
+    }
+
+    /**
+     * @brief Возвращает наибольшее вертикальное расстояние между пикселем и строками, из которых он читается.
+     *
+     * @return ceil(max |dy|) в пикселях.
+     */
+    int reach() const;
+
+    /**
+     * @brief Возвращает объём поля в байтах.
+     *
+     * @return Размер таблиц смещений.
+     */
+    std::size_t bytes() const { return (dxs.size() + dys.size() + rowDxs.size() + rowDys.size()) * sizeof(std::int32_t); }
+
+private:
+    int width = 0;
+    int height = 0;
+    bool separableField = false;
+    std::int32_t maxDy = 0;           // max |dy| в фиксированной точке
+    std::vector<std::int32_t> dxs;    // плотное: width * height; разделимое: columnDx
+    std::vector<std::int32_t> dys;    // плотное: width * height; разделимое: columnDy
+    std::vector<std::int32_t> rowDxs; // только разделимое
+    std::vector<std::int32_t> rowDys; // только разделимое
+};
+
+/**
+ * @brief Переносит пиксели изображения по полю смещений.
+ *
+ * Пиксель (x, y) результата равен выборке источника в точке (x + dx, y + dy).
+ * Если reach() поля мал по сравнению с высотой полосы, изображение переписывается на
+ * месте полосами, распределёнными по общему пулу потоков: каждая полоса заранее
+ * копирует лишь reach() строк соседей, а свои уже переписанные строки держит в кольце.
+ * Иначе (и всегда при EdgeMode::Wrap) источник копируется целиком, а результат
+ * заполняется плитками 64 x 64 параллельно, чтобы читаемые строки оставались в кеше.
+ *
+ * @param img Изображение любого формата.
+ * @param field Поле размером с изображение.
+ * @param options Выборка и обработка краёв.
+ */
+void remap(Image &img, const DisplacementField &field, const RemapOptions &options = RemapOptions{});
+
+/**
+ * @brief Переносит пиксели области изображения по полю смещений.
+ *
+ * Область обрабатывается как отдельное изображение: координаты поля отсчитываются от
+ * её угла, а точки вне области считаются точками вне изображения.
+ *
+ * @param img Изображение любого формата.
+ * @param field Поле размером с область (после обрезки по изображению).
+ * @param options Выборка и обработка краёв.
+ * @param region Область.
+ */
+void remap(Image &img, const DisplacementField &field, const RemapOptions &options, const Region &region);
+
+/**
+ * @brief Переносит пиксели изображения с плоскостями каналов по полю смещений.
+ *
+ * Плоскости переписываются одним проходом тем же сэмплером, что и Image: на месте
+ * полосами или по копии (см. remap для Image), координаты пикселя вычисляются один
+ * раз для всех плоскостей, а плоскость c получает border[c]. Результат совпадает с
+ * remap для того же изображения RGBA8.
+ *
+ * @param img Изображение.
+ * @param field Поле размером с изображение.
+ * @param options Выборка и обработка краёв.
+ */
+void remap(PlanarImage &img, const DisplacementField &field, const RemapOptions &options = RemapOptions{});
+
+/**
+ * @brief Формирует строку y результата из окна исходных строк.
+ *
+ * Используется потоковой обработкой и плитками, которые держат в памяти только
+ * окно строк. EdgeMode::Wrap здесь заменяется на Clamp: для него нужны все строки.
+ *
+ * @param format Формат пикселей.
+ * @param field Поле смещений всего изображения.
+ * @param options Выборка и обработка краёв.
+ * @param row Строка результата из field.getWidth() пикселей; не совпадает со строками окна.
+ * @param y Номер строки.
+ * @param window 2 * field.reach() + 1 указателей: window[k] — исходная строка
+ *               y - reach() + k или nullptr, если она вне изображения.
+ */
+void remapRow(PixelFormat format, const DisplacementField &field, const RemapOptions &options, std::uint8_t *row,
+              int y, const std::uint8_t *const *window);
+
+/**
+ * @brief Формирует строку y результата с плоскостями каналов из окна исходных строк.
+ *
+ * Плоскости заполняются тем же сэмплером, что и строки в remapRow; EdgeMode::Wrap
+ * так же заменяется на Clamp.
+ *
+ * @param field Поле смещений всего изображения.
+ * @param options Выборка и обработка краёв.
+ * @param row Строка результата из field.getWidth() пикселей; не совпадает со строками окна.
+ * @param y Номер строки.
+ * @param window 2 * field.reach() + 1 строк: window[k] — исходная строка y - reach() + k;
+ *               у строк вне изображения указатели равны nullptr.
+ */
+void remapRow(const DisplacementField &field, const RemapOptions &options, const PlanarRow &row, int y,
+              const PlanarRow *window);
+
+/**
+ * @brief Строит поле волнового искажения (см. applyWaveDistortion).
+ *
+ * Разделимое поле с целыми смещениями: dx = amplitude * sin(2πy / 128),
+ * dy = amplitude * cos(2πx / 128) с отбрасыванием дробной части.
+ *
+ * @param amplitude Амплитуда.
+ * @param width Ширина.
+ * @param height Высота.
+ * @return Поле.
+ */
+DisplacementField waveField(float amplitude, int width, int height);
+
+/**
+ * @brief Строит поле завихрения вокруг центра изображения.
+ *
+ * Точка на расстоянии r < radius от центра поворачивается на angle * (1 - r / radius)^2.
+ *
+ * @param width Ширина.
+ * @param height Высота.
+ * @param angle Угол поворота в центре в радианах.
+ * @param radius Радиус области; 0 — половина меньшей стороны.
+ * @return Плотное поле.
+ */
+DisplacementField swirlField(int width, int height, float angle, float radius = 0.0f);
+
+/**
+ * @brief Строит поле линзы (бочкообразное или подушкообразное искажение).
+ *
+ * Точка на нормированном расстоянии r от центра берётся из r * (1 + strength * r^2);
+ * r = 1 на половине диагонали.
+ *
+ * @param width Ширина.
+ * @param height Высота.
+ * @param strength Сила: > 0 — сжатие к центру (подушка), < 0 — бочка.
+ * @return Плотное поле.
+ */
+DisplacementField lensField(int width, int height, float strength);
+
+/**
+ * @brief Строит поле круговой ряби от центра изображения.
+ *
+ * Точка сдвигается вдоль радиуса на amplitude * sin(2πr / wavelength).
+ *
+ * @param width Ширина.
+ * @param height Высота.
+ * @param amplitude Амплитуда в пикселях.
+ * @param wavelength Длина волны в пикселях.
+ * @return Плотное поле.
+ */
+DisplacementField rippleField(int width, int height, float amplitude, float wavelength);
+
+#endif // IMAGE_FILTERS_REMAP_H
@@ -0,0 +1,274 @@
+#include "result_cache.h"
+#include "stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Меняется, когда фильтры начинают давать другие байты при тех же параметрах.
+constexpr std::uint32_t kKeyVersion = 1;
+
+constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ull;
+constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+std::uint64_t rotl(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+template <typename T> T readWord(const std::uint8_t *p) {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+std::uint64_t mixRound(std::uint64_t acc, std::uint64_t input) { return rotl(acc + input * kPrime2, 31) * kPrime1; }
+
+std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t value) {
+    return (acc ^ mixRound(0, value)) * kPrime1 + kPrime4;
+}
+
+/// 64-битный хеш по схеме XXH64: четыре независимые полосы по 8 байтов за шаг.
+std::uint64_t hashBytes(const std::uint8_t *data, std::size_t size, std::uint64_t seed) {
+    const std::uint8_t *p = data;
+    const std::uint8_t *end = data + size;
+    std::uint64_t h;
+    if (size >= 32) {
+        std::uint64_t v1 = seed + kPrime1 + kPrime2, v2 = seed + kPrime2, v3 = seed, v4 = seed - kPrime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = mixRound(v1, readWord<std::uint64_t>(p));
+            v2 = mixRound(v2, readWord<std::uint64_t>(p + 8));
+            v3 = mixRound(v3, readWord<std::uint64_t>(p + 16));
+            v4 = mixRound(v4, readWord<std::uint64_t>(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(mergeRound(mergeRound(mergeRound(h, v1), v2), v3), v4);
+    } else {
+        h = seed + kPrime5;
+    }
+    h += size;
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ mixRound(0, readWord<std::uint64_t>(p)), 27) * kPrime1 + kPrime4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ readWord<std::uint32_t>(p) * kPrime1, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        h = rotl(h ^ *p * kPrime5, 11) * kPrime1;
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+/// Двоичное описание параметров, от которых зависят байты результата.
+class KeyWriter {
+public:
+    template <typename T> KeyWriter &operator<<(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "key fields must be plain values");
+        const auto *p = reinterpret_cast<const std::uint8_t *>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(value));
+        return *this;
+    }
+
+    std::uint64_t hash() const { return hashBytes(bytes.data(), bytes.size(), kKeyVersion); }
+
+private:
+    std::vector<std::uint8_t> bytes;
+};
+
+void appendHex(std::string &out, std::uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    for (int shift = 60; shift >= 0; shift -= 4)
+        out.push_back(digits[(value >> shift) & 15]);
+}
+
+bool isKeyFile(const fs::path &path) {
+    std::string name = path.filename().string();
+    return name.size() == 36 && path.extension() == ".png" &&
+           std::all_of(name.begin(), name.begin() + 32, [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); });
+}
+
+/// Уникальное среди процессов и потоков имя временного файла.
+std::string temporarySuffix() {
+    static const std::uint64_t base = (static_cast<std::uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}();
+    static std::atomic<std::uint64_t> counter{0};
+    std::string suffix = ".";
+    appendHex(suffix, base + counter++);
+    return suffix + ".tmp";
+}
+
+} // namespace
+
+ResultCache::ResultCache(const ResultCacheOptions &options) : options(options) {
+    std::error_code error;
+    fs::create_directories(options.directory, error);
+    open = !options.directory.empty() && fs::is_directory(options.directory, error);
+    if (!open)
+        return;
+
+    struct Found {
+        fs::file_time_type time;
+        std::string key;
+        std::uint64_t bytes;
+    };
+    std::vector<Found> found;
+    for (const fs::directory_entry &entry : fs::directory_iterator(options.directory, error)) {
+        if (!entry.is_regular_file(error) || !isKeyFile(entry.path()))
+            continue;
+        found.push_back({entry.last_write_time(error), entry.path().stem().string(), entry.file_size(error)});
+    }
+    std::sort(found.begin(), found.end(), [](const Found &a, const Found &b) { return a.time < b.time; });
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Found &f : found)
+        insert(f.key, f.bytes);
+    evict();
+}
+
+std::string ResultCache::makeKey(Span<const std::uint8_t> input, const FilterPipeline &pipeline, const SaveOptions &save,
+                                 const LoadOptions &load, const std::optional<Region> &region) {
+    KeyWriter params;
+    params << static_cast<std::uint64_t>(input.size()) << static_cast<std::uint32_t>(pipeline.stages().size());
+    for (const FilterStage &stage : pipeline.stages()) {
+        params << stage.type;
+        switch (stage.type) {
+        case FilterType::WaveDistortion:
+            params << stage.params.amplitude;
+            break;
+        case FilterType::ColorNoise:
+            params << stage.params.intensity << stage.params.seed;
+            break;
+        case FilterType::Glitch: {
+            const GlitchOptions &g = stage.params.glitch;
+            params << stage.params.seed << g.rowStep << g.maxShift << g.boost << g.blockHeight << g.blockChance
+                   << g.blockMaxShift << g.channelOffset;
+            break;
+        }
+        case FilterType::SolarRays:
+        case FilterType::Grayscale:
+            break;
+        }
+    }
+    params << save.compressionLevel << save.strategy << save.rowFilters << save.parallel << save.reduceFormat;
+    params << load.format.has_value() << load.format.value_or(PixelFormat::RGBA8);
+    Region crop = load.crop.value_or(Region{});
+    params << load.crop.has_value() << crop.x << crop.y << crop.width << crop.height;
+    Region area = region.value_or(Region{});
+    params << region.has_value() << area.x << area.y << area.width << area.height;
+
+    std::string key;
+    appendHex(key, hashBytes(input.data(), input.size(), 0));
+    appendHex(key, params.hash());
+    return key;
+}
+
+std::string ResultCache::pathOf(const std::string &key) const {
+    return (fs::path(options.directory) / (key + ".png")).string();
+}
+
+bool ResultCache::lookup(const std::string &key, std::vector<std::uint8_t> &png) {
+    IMAGE_FILTERS_STAT_TIMER("cache.lookup");
+    // Файл мог записать другой процесс, поэтому индекс до чтения не проверяется.
+    bool hit = open && readFileBytes(pathOf(key), png);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!hit) {
+        ++counters.misses;
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            counters.bytes -= it->second.bytes;
+            recency.erase(it->second.position);
+            entries.erase(it);
+        }
+        return false;
+    }
+    ++counters.hits;
+    IMAGE_FILTERS_STAT_ADD("cache.lookup", bytesOut, png.size());
+    insert(key, png.size());
+    std::error_code error;
+    fs::last_write_time(pathOf(key), fs::file_time_type::clock::now(), error);
+    return true;
+}
+
+bool ResultCache::store(const std::string &key, Span<const std::uint8_t> png) {
+    if (!open || png.size() > options.maxBytes)
+        return false;
+    IMAGE_FILTERS_STAT_TIMER("cache.store");
+    std::string path = pathOf(key);
+    std::string temporary = path + temporarySuffix();
+    std::error_code error;
+    if (!writeFileBytes(temporary, png)) {
+        fs::remove(temporary, error);
+        return false;
+    }
+    fs::rename(temporary, path, error);
+    if (error) {
+        fs::remove(temporary, error);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ++counters.stores;
+    insert(key, png.size());
+    evict();
+    return true;
+}
+
+ResultCacheStats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ResultCacheStats values = counters;
+    values.entries = entries.size();
+    return values;
+}
+
+void ResultCache::insert(const std::string &key, std::uint64_t bytes) {
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        counters.bytes -= it->second.bytes;
+        recency.erase(it->second.position);
+        entries.erase(it);
+    }
+    recency.push_front(key);
+    entries[key] = Entry{bytes, recency.begin()};
+    counters.bytes += bytes;
+}
+
+void ResultCache::evict() {
+    std::error_code error;
+    while (counters.bytes > options.maxBytes && !recency.empty()) {
+        const std::string &oldest = recency.back();
+        fs::remove(pathOf(oldest), error);
+        auto it = entries.find(oldest);
+        counters.bytes -= it->second.bytes;
+        entries.erase(it);
+        recency.pop_back();
+        ++counters.evictions;
+    }
+}
+
+bool readFileBytes(const std::string &filename, std::vector<std::uint8_t> &bytes) {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    std::streamoff size = in.tellg();
+    if (size < 0)
+        return false;
+    bytes.resize(static_cast<std::size_t>(size));
+    in.seekg(0);
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(bytes.data()), size));
+}
+
+bool writeFileBytes(const std::string &filename, Span<const std::uint8_t> bytes) {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    out.close();
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,145 @@
+#ifndef IMAGE_FILTERS_RESULT_CACHE_H
+#define IMAGE_FILTERS_RESULT_CACHE_H
+
+#include "filter_pipeline.h"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \file
+ * \brief Кеш результатов на диске, адресуемый содержимым входа и параметрами обработки
+ */
+
+/**
+ * @brief Параметры кеша результатов.
+ */
+struct ResultCacheOptions {
+    std::string directory;                      ///< Каталог кеша; создаётся при открытии.
+    std::uint64_t maxBytes = std::uint64_t(1) << 30; ///< Наибольший суммарный размер файлов кеша.
+};
+
+/**
+ * @brief Счётчики кеша результатов.
+ */
+struct ResultCacheStats {
+    std::uint64_t hits = 0;      ///< Успешные lookup().
+    std::uint64_t misses = 0;    ///< Неуспешные lookup().
+    std::uint64_t stores = 0;    ///< Записанные результаты.
+    std::uint64_t evictions = 0; ///< Удалённые при вытеснении файлы.
+    std::uint64_t bytes = 0;     ///< Суммарный размер файлов кеша.
+    std::size_t entries = 0;     ///< Число файлов кеша.
+};
+
+/**
+ * @class ResultCache
+ * @brief Каталог готовых PNG, адресуемых ключом makeKey().
+ *
+ * Каждый результат — отдельный файл <ключ>.png, поэтому при попадании вызывающий
+ * получает готовые байты PNG без декодирования и кодирования. Запись атомарна:
+ * данные пишутся во временный файл того же каталога и переименовываются, так что
+ * читатели, в том числе другие процессы, видят либо старый, либо полный новый файл.
+ *
+ * Когда суммарный размер превышает maxBytes, удаляются давно не использованные
+ * файлы. Порядок использования хранится во времени изменения файлов, поэтому
+ * переживает перезапуск. Методы потокобезопасны.
+ */
+class ResultCache {
+public:
+    /**
+     * @brief Открывает каталог кеша и строит индекс по уже лежащим в нём файлам.
+     *
+     * @param options Параметры.
+     */
+    explicit ResultCache(const ResultCacheOptions &options);
+
+    /**
+     * @brief Проверяет, удалось ли создать или открыть каталог.
+     *
+     * @return true, если кеш можно использовать.
+     */
+    bool isOpen() const { return open; }
+
+    /**
+     * @brief Вычисляет ключ результата.
+     *
+     * Ключ — 128 бит: быстрый 64-битный хеш входных байтов и хеш всех параметров,
+     * влияющих на выходные байты (фильтры с их параметрами и зёрнами, параметры
+     * загрузки и записи, область).
+     *
+     * @param input Исходный файл PNG.
+     * @param pipeline Цепочка фильтров.
+     * @param save Параметры записи результата.
+     * @param load Параметры загрузки.
+     * @param region Обрабатываемая область.
+     * @return 32 шестнадцатеричные цифры.
+     */
+    static std::string makeKey(Span<const std::uint8_t> input, const FilterPipeline &pipeline, const SaveOptions &save,
+                               const LoadOptions &load = {}, const std::optional<Region> &region = std::nullopt);
+
+    /**
+     * @brief Читает результат по ключу и отмечает его как недавно использованный.
+     *
+     * @param key Ключ из makeKey().
+     * @param png Байты PNG.
+     * @return true при попадании.
+     */
+    bool lookup(const std::string &key, std::vector<std::uint8_t> &png);
+
+    /**
+     * @brief Атомарно сохраняет результат и вытесняет старые, если кеш переполнен.
+     *
+     * @param key Ключ из makeKey().
+     * @param png Байты PNG.
+     * @return true, если файл записан; false, если результат больше maxBytes или запись не удалась.
+     */
+    bool store(const std::string &key, Span<const std::uint8_t> png);
+
+    /**
+     * @brief Возвращает счётчики.
+     *
+     * @return Снимок счётчиков.
+     */
+    ResultCacheStats stats() const;
+
+private:
+    struct Entry {
+        std::uint64_t bytes;
+        std::list<std::string>::iterator position;
+    };
+
+    std::string pathOf(const std::string &key) const;
+    void insert(const std::string &key, std::uint64_t bytes);
+    void evict();
+
+    ResultCacheOptions options;
+    bool open = false;
+    mutable std::mutex mutex;
+    std::list<std::string> recency; // в начале — недавно использованные
+    std::unordered_map<std::string, Entry> entries;
+    ResultCacheStats counters;
+};
+
+/**
+ * @brief Читает файл целиком.
+ *
+ * @param filename Путь к файлу.
+ * @param bytes Содержимое.
+ * @return true, если файл прочитан.
+ */
+bool readFileBytes(const std::string &filename, std::vector<std::uint8_t> &bytes);
+
+/**
+ * @brief Записывает байты в файл, заменяя его содержимое.
+ *
+ * @param filename Путь к файлу.
+ * @param bytes Содержимое.
+ * @return true, если файл записан.
+ */
+bool writeFileBytes(const std::string &filename, Span<const std::uint8_t> bytes);
+
+#endif // IMAGE_FILTERS_RESULT_CACHE_H
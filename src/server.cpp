@@ -0,0 +1,236 @@
+#include "server.h"
+#include "stats.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define IMAGE_FILTERS_HAVE_SOCKETS
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+#ifdef IMAGE_FILTERS_HAVE_SOCKETS
+
+namespace {
+
+constexpr std::size_t kHeaderBytes = 8;
+
+void putU32(std::uint8_t *p, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i)
+        p[i] = static_cast<std::uint8_t>(value >> (8 * i));
+}
+
+std::uint32_t getU32(const std::uint8_t *p) {
+    return p[0] | static_cast<std::uint32_t>(p[1]) << 8 | static_cast<std::uint32_t>(p[2]) << 16 |
+           static_cast<std::uint32_t>(p[3]) << 24;
+}
+
+/// Читает ровно size байтов; eof становится true, если поток кончился до первого байта.
+bool readAll(int fd, void *data, std::size_t size, bool *eof = nullptr) {
+    auto *out = static_cast<std::uint8_t *>(data);
+    std::size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::read(fd, out + done, size - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            if (eof)
+                *eof = n == 0 && done == 0;
+            return false;
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+/// Пишет все байты; в сокет — без SIGPIPE, если клиент отключился.
+bool writeAll(int fd, const void *data, std::size_t size) {
+    const auto *in = static_cast<const std::uint8_t *>(data);
+    bool socket = true;
+    while (size > 0) {
+        ssize_t n = socket ? ::send(fd, in, size, MSG_NOSIGNAL) : ::write(fd, in, size);
+        if (n < 0 && socket && errno == ENOTSOCK) {
+            socket = false;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        in += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool writeReply(int fd, ServerStatus status, Span<const std::uint8_t> payload) {
+    std::uint8_t header[kHeaderBytes];
+    putU32(header, static_cast<std::uint32_t>(status));
+    putU32(header + 4, static_cast<std::uint32_t>(payload.size()));
+    return writeAll(fd, header, sizeof(header)) && writeAll(fd, payload.data(), payload.size());
+}
+
+Span<const std::uint8_t> textBytes(const char *text) {
+    return {reinterpret_cast<const std::uint8_t *>(text), std::strlen(text)};
+}
+
+/// Состояние соединения: буферы и разобранная цепочка переживают запросы.
+struct Session {
+    const ServerOptions &options;
+    std::vector<std::uint8_t> request;
+    std::vector<std::uint8_t> reply;
+    Image image;
+    std::string chain;
+    FilterPipeline pipeline;
+    bool chainValid = false;
+};
+
+ServerStatus handleRequest(Session &session, std::size_t chainBytes) {
+    IMAGE_FILTERS_STAT_TIMER("server.request");
+    Span<const std::uint8_t> png(session.request.data() + chainBytes, session.request.size() - chainBytes);
+    IMAGE_FILTERS_STAT_ADD("server.request", bytesIn, session.request.size());
+
+    if (!session.chainValid || session.chain.size() != chainBytes ||
+        !std::equal(session.chain.begin(), session.chain.end(), session.request.begin())) {
+        session.chain.assign(session.request.begin(), session.request.begin() + chainBytes);
+        session.pipeline = FilterPipeline();
+        session.chainValid = FilterPipeline::parse(session.chain, session.pipeline, session.options.seed);
+    }
+    ServerStatus status = ServerStatus::Ok;
+    const char *error = nullptr;
+    if (!session.chainValid) {
+        status = ServerStatus::BadChain;
+        error = "invalid filter chain";
+    } else {
+        const ServerOptions &options = session.options;
+        std::string key = options.cache ? ResultCache::makeKey(png, session.pipeline, options.save, options.load) : "";
+        if (options.cache && options.cache->lookup(key, session.reply)) {
+            // Готовый результат из кеша.
+        } else if (!session.image.loadFromMemory(png, options.load)) {
+            status = ServerStatus::BadImage;
+            error = "cannot decode PNG";
+        } else {
+            session.pipeline.apply(session.image);
+            if (!session.image.saveToBuffer(session.reply, options.save)) {
+                status = ServerStatus::EncodeError;
+                error = "cannot encode PNG";
+            } else if (options.cache) {
+                options.cache->store(key, Span<const std::uint8_t>(session.reply.data(), session.reply.size()));
+            }
+        }
+    }
+    if (error) {
+        Span<const std::uint8_t> text = textBytes(error);
+        session.reply.assign(text.data(), text.data() + text.size());
+    }
+    IMAGE_FILTERS_STAT_ADD("server.request", bytesOut, session.reply.size());
+    return status;
+}
+
+} // namespace
+
+bool serveStream(int inFd, int outFd, const ServerOptions &options) {
+    Session session{options, {}, {}, Image(), {}, FilterPipeline(), false};
+    for (;;) {
+        std::uint8_t header[kHeaderBytes];
+        bool eof = false;
+        if (!readAll(inFd, header, sizeof(header), &eof))
+            return eof;
+        std::size_t chainBytes = getU32(header);
+        std::size_t total = chainBytes + getU32(header + 4);
+        if (total > options.maxRequestBytes) {
+            writeReply(outFd, ServerStatus::TooLarge, textBytes("request too large"));
+            return false;
+        }
+        session.request.resize(total);
+        if (!readAll(inFd, session.request.data(), total))
+            return false;
+        ServerStatus status = handleRequest(session, chainBytes);
+        if (!writeReply(outFd, status, Span<const std::uint8_t>(session.reply.data(), session.reply.size())))
+            return false;
+    }
+}
+
+bool serveUnixSocket(const std::string &path, const ServerOptions &options, const std::atomic<bool> *stop) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+        return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return false;
+    ::unlink(path.c_str());
+    if (::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, SOMAXCONN) != 0) {
+        ::close(listener);
+        return false;
+    }
+
+    // Открытые соединения: при остановке они закрываются, и сервер ждёт их потоки.
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::set<int> clients;
+
+    while (!stop || !stop->load()) {
+        pollfd ready{listener, POLLIN, 0};
+        if (::poll(&ready, 1, 100) <= 0)
+            continue;
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0)
+            continue;
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.insert(client);
+        std::thread([client, &options, &mutex, &finished, &clients] {
+            serveStream(client, client, options);
+            std::lock_guard<std::mutex> lock(mutex);
+            ::close(client);
+            clients.erase(client);
+            finished.notify_all();
+        }).detach();
+    }
+
+    ::close(listener);
+    ::unlink(path.c_str());
+    std::unique_lock<std::mutex> lock(mutex);
+    for (int client : clients)
+        ::shutdown(client, SHUT_RDWR);
+    finished.wait(lock, [&clients] { return clients.empty(); });
+    return true;
+}
+
+bool sendFilterRequest(int fd, const std::string &chain, Span<const std::uint8_t> png, std::vector<std::uint8_t> &reply,
+                       ServerStatus &status) {
+    std::uint8_t header[kHeaderBytes];
+    putU32(header, static_cast<std::uint32_t>(chain.size()));
+    putU32(header + 4, static_cast<std::uint32_t>(png.size()));
+    if (!writeAll(fd, header, sizeof(header)) || !writeAll(fd, chain.data(), chain.size()) ||
+        !writeAll(fd, png.data(), png.size()) || !readAll(fd, header, sizeof(header)))
+        return false;
+    status = static_cast<ServerStatus>(getU32(header));
+    reply.resize(getU32(header + 4));
+    return readAll(fd, reply.data(), reply.size());
+}
+
+#else
+
+bool serveStream(int, int, const ServerOptions &) { return false; }
+
+bool serveUnixSocket(const std::string &, const ServerOptions &, const std::atomic<bool> *) { return false; }
+
+bool sendFilterRequest(int, const std::string &, Span<const std::uint8_t>, std::vector<std::uint8_t> &, ServerStatus &) {
+    return false;
+}
+
+#endif
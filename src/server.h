@@ -0,0 +1,91 @@
+#ifndef IMAGE_FILTERS_SERVER_H
+#define IMAGE_FILTERS_SERVER_H
+
+#include "filter_pipeline.h"
+#include "result_cache.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \brief Долгоживущий режим обработки запросов через Unix-сокет или stdin/stdout
+ *
+ * Протокол — последовательность кадров в одном потоке байтов; все числа 32-битные
+ * беззнаковые в порядке little-endian.
+ *
+ * Запрос: длина описания цепочки, длина PNG, описание цепочки в синтаксисе
+ * FilterPipeline::parse, байты PNG.
+ *
+ * Ответ: код ServerStatus, длина данных, данные — PNG при ServerStatus::Ok, иначе
+ * текст ошибки в UTF-8.
+ *
+ * Пул потоков, таблицы геометрии и SIMD-диспетчер живут всё время работы процесса,
+ * а каждое соединение повторно использует буферы изображения, входа и выхода и
+ * разобранную цепочку, если описание не изменилось.
+ */
+
+/**
+ * @brief Результат обработки запроса.
+ */
+enum class ServerStatus : std::uint32_t {
+    Ok = 0,          ///< Данные ответа — PNG.
+    BadChain = 1,    ///< Описание цепочки не разобрано.
+    BadImage = 2,    ///< PNG не декодирован.
+    EncodeError = 3, ///< Результат не закодирован.
+    TooLarge = 4     ///< Запрос больше ServerOptions::maxRequestBytes; соединение закрывается.
+};
+
+/**
+ * @brief Параметры сервера.
+ */
+struct ServerOptions {
+    SaveOptions save;                   ///< Параметры кодирования ответов.
+    LoadOptions load;                   ///< Формат и область, с которыми декодируются запросы.
+    std::uint64_t seed = 0;             ///< Зерно для фильтров, в описании которых нет seed=.
+    std::size_t maxRequestBytes = 1u << 30; ///< Наибольший суммарный размер описания и PNG.
+    ResultCache *cache = nullptr;       ///< Кеш результатов; при попадании ответ отдаётся без декодирования.
+};
+
+/**
+ * @brief Обслуживает запросы из одного потока байтов, пока он не закончится.
+ *
+ * Запросы обрабатываются по очереди; фильтры и кодирование распараллеливаются общим
+ * пулом потоков.
+ *
+ * @param inFd Дескриптор, из которого читаются запросы.
+ * @param outFd Дескриптор, в который пишутся ответы.
+ * @param options Параметры.
+ * @return true, если поток закончился на границе кадра; false при ошибке ввода-вывода,
+ *         обрыве кадра или слишком большом запросе.
+ */
+bool serveStream(int inFd, int outFd, const ServerOptions &options);
+
+/**
+ * @brief Слушает Unix-сокет и обслуживает каждое соединение в отдельном потоке.
+ *
+ * Существующий файл по пути path заменяется, при завершении сокет удаляется.
+ *
+ * @param path Путь к сокету.
+ * @param options Параметры.
+ * @param stop Флаг остановки; проверяется не реже раза в 100 мс. nullptr — работать бесконечно.
+ * @return false, если сокет не создан или платформа не поддерживает Unix-сокеты.
+ */
+bool serveUnixSocket(const std::string &path, const ServerOptions &options, const std::atomic<bool> *stop = nullptr);
+
+/**
+ * @brief Отправляет запрос серверу и ждёт ответа.
+ *
+ * @param fd Соединённый с сервером дескриптор.
+ * @param chain Описание цепочки фильтров.
+ * @param png Исходное изображение в PNG.
+ * @param reply Данные ответа: PNG или текст ошибки.
+ * @param status Код ответа.
+ * @return false при ошибке ввода-вывода.
+ */
+bool sendFilterRequest(int fd, const std::string &chain, Span<const std::uint8_t> png, std::vector<std::uint8_t> &reply,
+                       ServerStatus &status);
+
+#endif // IMAGE_FILTERS_SERVER_H
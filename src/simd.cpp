@@ -0,0 +1,714 @@
+#include "simd.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define IMAGE_FILTERS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define IMAGE_FILTERS_TARGET_AVX2
+#else
+#define IMAGE_FILTERS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+constexpr int kGrayR = 9798;
+constexpr int kGrayG = 19235;
+constexpr int kGrayB = 3735;
+constexpr int kGrayShift = 15;
+constexpr int kGrayRound = 1 << (kGrayShift - 1);
+
+void grayscaleScalar(Pixel *row, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        Pixel &p = row[i];
+        auto gray = static_cast<std::uint8_t>((kGrayR * p[0] + kGrayG * p[1] + kGrayB * p[2] + kGrayRound) >> kGrayShift);
+        p[0] = p[1] = p[2] = gray;
+    }
+}
+
+void addSaturatedScalar(Pixel *row, const std::uint8_t *add, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        Pixel &p = row[i];
+        for (int c = 0; c < 3; ++c)
+            p[c] = static_cast<std::uint8_t>(std::min(255, p[c] + add[i]));
+    }
+}
+
+void addConstantScalar(Pixel *row, std::size_t count, Pixel addend) {
+    for (std::size_t i = 0; i < count; ++i)
+        for (int c = 0; c < 4; ++c)
+            row[i][c] = static_cast<std::uint8_t>(std::min(255, row[i][c] + addend[c]));
+}
+
+void deinterleaveScalar(const Pixel *row, std::size_t count, std::uint8_t *const *planes) {
+    for (std::size_t i = 0; i < count; ++i)
+        for (int c = 0; c < 4; ++c)
+            planes[c][i] = row[i][c];
+}
+
+void interleaveScalar(const std::uint8_t *const *planes, std::size_t count, Pixel *row) {
+    for (std::size_t i = 0; i < count; ++i)
+        for (int c = 0; c < 4; ++c)
+            row[i][c] = planes[c][i];
+}
+
+void grayscalePlanesScalar(std::uint8_t *r, std::uint8_t *g, std::uint8_t *b, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        auto gray = static_cast<std::uint8_t>((kGrayR * r[i] + kGrayG * g[i] + kGrayB * b[i] + kGrayRound) >> kGrayShift);
+        r[i] = g[i] = b[i] = gray;
+    }
+}
+
+void addSaturatedPlaneScalar(std::uint8_t *plane, const std::uint8_t *add, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i)
+        plane[i] = static_cast<std::uint8_t>(std::min(255, plane[i] + add[i]));
+}
+
+void addConstantPlaneScalar(std::uint8_t *plane, std::size_t count, std::uint8_t addend) {
+    for (std::size_t i = 0; i < count; ++i)
+        plane[i] = static_cast<std::uint8_t>(std::min(255, plane[i] + addend));
+}
+
+void scanColorUsageScalar(const Pixel *row, std::size_t count, ColorUsage &usage) {
+    bool gray = usage.gray, opaque = usage.opaque;
+    for (std::size_t i = 0; i < count; ++i) {
+        gray = gray && row[i][0] == row[i][1] && row[i][1] == row[i][2];
+        opaque = opaque && row[i][3] == 255;
+    }
+    usage.gray = gray;
+    usage.opaque = opaque;
+}
+
+#ifdef IMAGE_FILTERS_X86
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_FILTERS_HAVE_SSE2 1
+
+// Два пикселя RGBA, расширенные до 16 бит на канал: серый повторяется в RGB, альфа сохраняется.
+inline __m128i grayscale2x16(__m128i px) {
+    const __m128i coeff = _mm_setr_epi16(kGrayR, kGrayG, kGrayB, 0, kGrayR, kGrayG, kGrayB, 0);
+    const __m128i round = _mm_set1_epi32(kGrayRound);
+    const __m128i lowDword = _mm_set_epi32(0, -1, 0, -1);
+    const __m128i alphaWord = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+
+    __m128i sum = _mm_madd_epi16(px, coeff);
+    sum = _mm_add_epi32(sum, _mm_srli_epi64(sum, 32));
+    sum = _mm_srli_epi32(_mm_add_epi32(sum, round), kGrayShift);
+    sum = _mm_and_si128(sum, lowDword);
+    __m128i gray = _mm_or_si128(sum, _mm_or_si128(_mm_slli_epi64(sum, 16), _mm_slli_epi64(sum, 32)));
+    return _mm_or_si128(gray, _mm_and_si128(px, alphaWord));
+}
+
+void grayscaleSSE2(Pixel *row, std::size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    auto *bytes = reinterpret_cast<unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i * 4));
+        __m128i lo = grayscale2x16(_mm_unpacklo_epi8(v, zero));
+        __m128i hi = grayscale2x16(_mm_unpackhi_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bytes + i * 4), _mm_packus_epi16(lo, hi));
+    }
+    grayscaleScalar(row + i, count - i);
+}
+
+void addSaturatedSSE2(Pixel *row, const std::uint8_t *add, std::size_t count) {
+    const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+    auto *bytes = reinterpret_cast<unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(add + i));
+        __m128i pairsLo = _mm_unpacklo_epi8(values, values);
+        __m128i pairsHi = _mm_unpackhi_epi8(values, values);
+        __m128i quads[4] = {_mm_unpacklo_epi16(pairsLo, pairsLo), _mm_unpackhi_epi16(pairsLo, pairsLo),
+                            _mm_unpacklo_epi16(pairsHi, pairsHi), _mm_unpackhi_epi16(pairsHi, pairsHi)};
+        for (int q = 0; q < 4; ++q) {
+            auto *dst = reinterpret_cast<__m128i *>(bytes + (i + 4 * q) * 4);
+            __m128i px = _mm_loadu_si128(dst);
+            _mm_storeu_si128(dst, _mm_adds_epu8(px, _mm_and_si128(quads[q], rgbMask)));
+        }
+    }
+    addSaturatedScalar(row + i, add + i, count - i);
+}
+
+void addConstantSSE2(Pixel *row, std::size_t count, Pixel addend) {
+    std::uint32_t packed;
+    std::memcpy(&packed, addend.data(), sizeof(packed));
+    const __m128i add = _mm_set1_epi32(static_cast<int>(packed));
+    auto *bytes = reinterpret_cast<unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto *dst = reinterpret_cast<__m128i *>(bytes + i * 4);
+        _mm_storeu_si128(dst, _mm_adds_epu8(_mm_loadu_si128(dst), add));
+    }
+    addConstantScalar(row + i, count - i, addend);
+}
+
+// Байты 0 и 1 каждого пикселя сравниваются с байтами 1 и 2 (R == G, G == B), а
+// альфа-байты накапливаются побитовым И: у непрозрачной строки они остаются 0xFF.
+void scanColorUsageSSE2(const Pixel *row, std::size_t count, ColorUsage &usage) {
+    const auto *bytes = reinterpret_cast<const unsigned char *>(row);
+    __m128i equal = _mm_set1_epi8(-1);
+    __m128i alpha = _mm_set1_epi8(-1);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i * 4));
+        equal = _mm_and_si128(equal, _mm_cmpeq_epi8(v, _mm_srli_epi32(v, 8)));
+        alpha = _mm_and_si128(alpha, v);
+    }
+    usage.gray = usage.gray && (_mm_movemask_epi8(equal) & 0x3333) == 0x3333;
+    usage.opaque = usage.opaque && (_mm_movemask_epi8(_mm_cmpeq_epi8(alpha, _mm_set1_epi8(-1))) & 0x8888) == 0x8888;
+    scanColorUsageScalar(row + i, count - i, usage);
+}
+
+// Транспонирование 16 пикселей: три шага чередования байтов собирают в каждом регистре
+// по 8 значений двух каналов от двух групп, а чередование 64-битных половин — плоскости.
+void deinterleaveSSE2(const Pixel *row, std::size_t count, std::uint8_t *const *planes) {
+    const auto *bytes = reinterpret_cast<const unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v[4];
+        for (int k = 0; k < 4; ++k)
+            v[k] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + (i + 4 * k) * 4));
+        __m128i w[4];
+        for (int k = 0; k < 4; k += 2) {
+            __m128i t0 = _mm_unpacklo_epi8(v[k], v[k + 1]);
+            __m128i t1 = _mm_unpackhi_epi8(v[k], v[k + 1]);
+            __m128i u0 = _mm_unpacklo_epi8(t0, t1);
+            __m128i u1 = _mm_unpackhi_epi8(t0, t1);
+            w[k] = _mm_unpacklo_epi8(u0, u1);     // R, G
+            w[k + 1] = _mm_unpackhi_epi8(u0, u1); // B, A
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(planes[0] + i), _mm_unpacklo_epi64(w[0], w[2]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(planes[1] + i), _mm_unpackhi_epi64(w[0], w[2]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(planes[2] + i), _mm_unpacklo_epi64(w[1], w[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(planes[3] + i), _mm_unpackhi_epi64(w[1], w[3]));
+    }
+    std::uint8_t *const rest[4] = {planes[0] + i, planes[1] + i, planes[2] + i, planes[3] + i};
+    deinterleaveScalar(row + i, count - i, rest);
+}
+
+void interleaveSSE2(const std::uint8_t *const *planes, std::size_t count, Pixel *row) {
+    auto *bytes = reinterpret_cast<unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(planes[0] + i));
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(planes[1] + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(planes[2] + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(planes[3] + i));
+        __m128i rgLo = _mm_unpacklo_epi8(r, g), rgHi = _mm_unpackhi_epi8(r, g);
+        __m128i baLo = _mm_unpacklo_epi8(b, a), baHi = _mm_unpackhi_epi8(b, a);
+        auto *dst = reinterpret_cast<__m128i *>(bytes + i * 4);
+        _mm_storeu_si128(dst, _mm_unpacklo_epi16(rgLo, baLo));
+        _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(rgLo, baLo));
+        _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(rgHi, baHi));
+        _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(rgHi, baHi));
+    }
+    const std::uint8_t *const rest[4] = {planes[0] + i, planes[1] + i, planes[2] + i, planes[3] + i};
+    interleaveScalar(rest, count - i, row + i);
+}
+
+// Пары (R, G) и (B, 1) раскрываются до 16 бит, и _mm_madd_epi16 даёт
+// 9798R + 19235G и 3735B + 16384 сразу в 32-битных суммах.
+void grayscalePlanesSSE2(std::uint8_t *r, std::uint8_t *g, std::uint8_t *b, std::size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i rgCoeff = _mm_set1_epi32(kGrayG << 16 | kGrayR);
+    const __m128i bCoeff = _mm_set1_epi32(kGrayRound << 16 | kGrayB);
+    auto gray8 = [&](__m128i rg, __m128i b1) {
+        __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(rg, zero), rgCoeff),
+                                   _mm_madd_epi16(_mm_unpacklo_epi8(b1, zero), bCoeff));
+        __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi8(rg, zero), rgCoeff),
+                                   _mm_madd_epi16(_mm_unpackhi_epi8(b1, zero), bCoeff));
+        return _mm_packs_epi32(_mm_srli_epi32(lo, kGrayShift), _mm_srli_epi32(hi, kGrayShift));
+    };
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i vr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r + i));
+        __m128i vg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        __m128i lo = gray8(_mm_unpacklo_epi8(vr, vg), _mm_unpacklo_epi8(vb, one));
+        __m128i hi = gray8(_mm_unpackhi_epi8(vr, vg), _mm_unpackhi_epi8(vb, one));
+        __m128i gray = _mm_packus_epi16(lo, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(r + i), gray);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(g + i), gray);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(b + i), gray);
+    }
+    grayscalePlanesScalar(r + i, g + i, b + i, count - i);
+}
+
+void addSaturatedPlaneSSE2(std::uint8_t *plane, const std::uint8_t *add, std::size_t count) {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto *dst = reinterpret_cast<__m128i *>(plane + i);
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(add + i));
+        _mm_storeu_si128(dst, _mm_adds_epu8(_mm_loadu_si128(dst), values));
+    }
+    addSaturatedPlaneScalar(plane + i, add + i, count - i);
+}
+
+void addConstantPlaneSSE2(std::uint8_t *plane, std::size_t count, std::uint8_t addend) {
+    const __m128i add = _mm_set1_epi8(static_cast<char>(addend));
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto *dst = reinterpret_cast<__m128i *>(plane + i);
+        _mm_storeu_si128(dst, _mm_adds_epu8(_mm_loadu_si128(dst), add));
+    }
+    addConstantPlaneScalar(plane + i, count - i, addend);
+}
+#endif
+
+IMAGE_FILTERS_TARGET_AVX2 inline __m256i grayscale4x16(__m256i px) {
+    const __m256i coeff = _mm256_setr_epi16(kGrayR, kGrayG, kGrayB, 0, kGrayR, kGrayG, kGrayB, 0, kGrayR, kGrayG,
+                                            kGrayB, 0, kGrayR, kGrayG, kGrayB, 0);
+    const __m256i round = _mm256_set1_epi32(kGrayRound);
+    const __m256i lowDword = _mm256_set1_epi64x(0xFFFFFFFFLL);
+    const __m256i alphaWord = _mm256_set1_epi64x(static_cast<long long>(0xFFFF000000000000ULL));
+
+    __m256i sum = _mm256_madd_epi16(px, coeff);
+    sum = _mm256_add_epi32(sum, _mm256_srli_epi64(sum, 32));
+    sum = _mm256_srli_epi32(_mm256_add_epi32(sum, round), kGrayShift);
+    sum = _mm256_and_si256(sum, lowDword);
+    __m256i gray = _mm256_or_si256(sum, _mm256_or_si256(_mm256_slli_epi64(sum, 16), _mm256_slli_epi64(sum, 32)));
+    return _mm256_or_si256(gray, _mm256_and_si256(px, alphaWord));
+}
+
+IMAGE_FILTERS_TARGET_AVX2 void grayscaleAVX2(Pixel *row, std::size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    auto *bytes = reinterpret_cast<unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + i * 4));
+        __m256i lo = grayscale4x16(_mm256_unpacklo_epi8(v, zero));
+        __m256i hi = grayscale4x16(_mm256_unpackhi_epi8(v, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(bytes + i * 4), _mm256_packus_epi16(lo, hi));
+    }
+    grayscaleScalar(row + i, count - i);
+}
+
+IMAGE_FILTERS_TARGET_AVX2 void addSaturatedAVX2(Pixel *row, const std::uint8_t *add, std::size_t count) {
+    const __m256i rgbMask = _mm256_set1_epi32(0x00FFFFFF);
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6,
+                                            6, 6, 6, 7, 7, 7, 7);
+    auto *bytes = reinterpret_cast<unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(add + i));
+        __m256i broadcast = _mm256_broadcastsi128_si256(values);
+        __m256i addend = _mm256_and_si256(_mm256_shuffle_epi8(broadcast, spread), rgbMask);
+        auto *dst = reinterpret_cast<__m256i *>(bytes + i * 4);
+        _mm256_storeu_si256(dst, _mm256_adds_epu8(_mm256_loadu_si256(dst), addend));
+    }
+    addSaturatedScalar(row + i, add + i, count - i);
+}
+
+IMAGE_FILTERS_TARGET_AVX2 void addConstantAVX2(Pixel *row, std::size_t count, Pixel addend) {
+    std::uint32_t packed;
+    std::memcpy(&packed, addend.data(), sizeof(packed));
+    const __m256i add = _mm256_set1_epi32(static_cast<int>(packed));
+    auto *bytes = reinterpret_cast<unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto *dst = reinterpret_cast<__m256i *>(bytes + i * 4);
+        _mm256_storeu_si256(dst, _mm256_adds_epu8(_mm256_loadu_si256(dst), add));
+    }
+    addConstantScalar(row + i, count - i, addend);
+}
+
+IMAGE_FILTERS_TARGET_AVX2 void scanColorUsageAVX2(const Pixel *row, std::size_t count, ColorUsage &usage) {
+    const auto *bytes = reinterpret_cast<const unsigned char *>(row);
+    const __m256i ones = _mm256_set1_epi8(-1);
+    __m256i equal = ones;
+    __m256i alpha = ones;
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + i * 4));
+        equal = _mm256_and_si256(equal, _mm256_cmpeq_epi8(v, _mm256_srli_epi32(v, 8)));
+        alpha = _mm256_and_si256(alpha, v);
+    }
+    auto grayMask = static_cast<unsigned>(_mm256_movemask_epi8(equal));
+    auto alphaMask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(alpha, ones)));
+    usage.gray = usage.gray && (grayMask & 0x33333333u) == 0x33333333u;
+    usage.opaque = usage.opaque && (alphaMask & 0x88888888u) == 0x88888888u;
+    scanColorUsageScalar(row + i, count - i, usage);
+}
+
+// Те же шаги, что в deinterleaveSSE2, идут внутри 128-битных половин; перестановка
+// 32-битных слов затем восстанавливает порядок четвёрок пикселей.
+IMAGE_FILTERS_TARGET_AVX2 void deinterleaveAVX2(const Pixel *row, std::size_t count, std::uint8_t *const *planes) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const auto *bytes = reinterpret_cast<const unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i v[4];
+        for (int k = 0; k < 4; ++k)
+            v[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + (i + 8 * k) * 4));
+        __m256i w[4];
+        for (int k = 0; k < 4; k += 2) {
+            __m256i t0 = _mm256_unpacklo_epi8(v[k], v[k + 1]);
+            __m256i t1 = _mm256_unpackhi_epi8(v[k], v[k + 1]);
+            __m256i u0 = _mm256_unpacklo_epi8(t0, t1);
+            __m256i u1 = _mm256_unpackhi_epi8(t0, t1);
+            w[k] = _mm256_unpacklo_epi8(u0, u1);
+            w[k + 1] = _mm256_unpackhi_epi8(u0, u1);
+        }
+        __m256i channels[4] = {_mm256_unpacklo_epi64(w[0], w[2]), _mm256_unpackhi_epi64(w[0], w[2]),
+                               _mm256_unpacklo_epi64(w[1], w[3]), _mm256_unpackhi_epi64(w[1], w[3])};
+        for (int c = 0; c < 4; ++c)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(planes[c] + i),
+                                _mm256_permutevar8x32_epi32(channels[c], order));
+    }
+    std::uint8_t *const rest[4] = {planes[0] + i, planes[1] + i, planes[2] + i, planes[3] + i};
+    deinterleaveScalar(row + i, count - i, rest);
+}
+
+IMAGE_FILTERS_TARGET_AVX2 void interleaveAVX2(const std::uint8_t *const *planes, std::size_t count, Pixel *row) {
+    const __m256i order = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    auto *bytes = reinterpret_cast<unsigned char *>(row);
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i v[4];
+        for (int c = 0; c < 4; ++c)
+            v[c] = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(planes[c] + i)),
+                                               order);
+        __m256i rgLo = _mm256_unpacklo_epi8(v[0], v[1]), rgHi = _mm256_unpackhi_epi8(v[0], v[1]);
+        __m256i baLo = _mm256_unpacklo_epi8(v[2], v[3]), baHi = _mm256_unpackhi_epi8(v[2], v[3]);
+        auto *dst = reinterpret_cast<__m256i *>(bytes + i * 4);
+        _mm256_storeu_si256(dst, _mm256_unpacklo_epi16(rgLo, baLo));
+        _mm256_storeu_si256(dst + 1, _mm256_unpackhi_epi16(rgLo, baLo));
+        _mm256_storeu_si256(dst + 2, _mm256_unpacklo_epi16(rgHi, baHi));
+        _mm256_storeu_si256(dst + 3, _mm256_unpackhi_epi16(rgHi, baHi));
+    }
+    const std::uint8_t *const rest[4] = {planes[0] + i, planes[1] + i, planes[2] + i, planes[3] + i};
+    interleaveScalar(rest, count - i, row + i);
+}
+
+// Распаковка и упаковка внутри половин взаимно обратны, поэтому порядок пикселей сохраняется.
+IMAGE_FILTERS_TARGET_AVX2 void grayscalePlanesAVX2(std::uint8_t *r, std::uint8_t *g, std::uint8_t *b,
+                                                   std::size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i rgCoeff = _mm256_set1_epi32(kGrayG << 16 | kGrayR);
+    const __m256i bCoeff = _mm256_set1_epi32(kGrayRound << 16 | kGrayB);
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i vr = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(r + i));
+        __m256i vg = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(g + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        __m256i rg[2] = {_mm256_unpacklo_epi8(vr, vg), _mm256_unpackhi_epi8(vr, vg)};
+        __m256i b1[2] = {_mm256_unpacklo_epi8(vb, one), _mm256_unpackhi_epi8(vb, one)};
+        __m256i words[2];
+        for (int k = 0; k < 2; ++k) {
+            __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi8(rg[k], zero), rgCoeff),
+                                          _mm256_madd_epi16(_mm256_unpacklo_epi8(b1[k], zero), bCoeff));
+            __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi8(rg[k], zero), rgCoeff),
+                                          _mm256_madd_epi16(_mm256_unpackhi_epi8(b1[k], zero), bCoeff));
+            words[k] = _mm256_packs_epi32(_mm256_srli_epi32(lo, kGrayShift), _mm256_srli_epi32(hi, kGrayShift));
+        }
+        __m256i gray = _mm256_packus_epi16(words[0], words[1]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(r + i), gray);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(g + i), gray);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(b + i), gray);
+    }
+    grayscalePlanesScalar(r + i, g + i, b + i, count - i);
+}
+
+IMAGE_FILTERS_TARGET_AVX2 void addSaturatedPlaneAVX2(std::uint8_t *plane, const std::uint8_t *add, std::size_t count) {
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        auto *dst = reinterpret_cast<__m256i *>(plane + i);
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(add + i));
+        _mm256_storeu_si256(dst, _mm256_adds_epu8(_mm256_loadu_si256(dst), values));
+    }
+    addSaturatedPlaneScalar(plane + i, add + i, count - i);
+}
+
+IMAGE_FILTERS_TARGET_AVX2 void addConstantPlaneAVX2(std::uint8_t *plane, std::size_t count, std::uint8_t addend) {
+    const __m256i add = _mm256_set1_epi8(static_cast<char>(addend));
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        auto *dst = reinterpret_cast<__m256i *>(plane + i);
+        _mm256_storeu_si256(dst, _mm256_adds_epu8(_mm256_loadu_si256(dst), add));
+    }
+    addConstantPlaneScalar(plane + i, count - i, addend);
+}
+
+bool cpuHasAVX2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool cpuHasSSE2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+#endif // IMAGE_FILTERS_X86
+
+SimdLevel clampToCpu(SimdLevel level) {
+    SimdLevel best = detectSimdLevel();
+    return static_cast<int>(level) > static_cast<int>(best) ? best : level;
+}
+
+std::atomic<SimdLevel> &currentLevel() {
+    static std::atomic<SimdLevel> level{detectSimdLevel()};
+    return level;
+}
+
+} // namespace
+
+SimdLevel detectSimdLevel() {
+#ifdef IMAGE_FILTERS_X86
+    static const SimdLevel detected = [] {
+        if (cpuHasAVX2())
+            return SimdLevel::AVX2;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+        if (cpuHasSSE2())
+            return SimdLevel::SSE2;
+#endif
+        return SimdLevel::Scalar;
+    }();
+    return detected;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel activeSimdLevel() { return currentLevel().load(std::memory_order_relaxed); }
+
+SimdLevel setSimdLevel(SimdLevel level) {
+    level = clampToCpu(level);
+    currentLevel().store(level, std::memory_order_relaxed);
+    return level;
+}
+
+const char *simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::SSE2:
+        return "sse2";
+    case SimdLevel::AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+void grayscaleRow(Pixel *row, std::size_t count) { grayscaleRow(activeSimdLevel(), row, count); }
+
+void grayscaleRow(SimdLevel level, Pixel *row, std::size_t count) {
+    switch (clampToCpu(level)) {
+#ifdef IMAGE_FILTERS_X86
+    case SimdLevel::AVX2:
+        grayscaleAVX2(row, count);
+        return;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+    case SimdLevel::SSE2:
+        grayscaleSSE2(row, count);
+        return;
+#endif
+#endif
+    default:
+        grayscaleScalar(row, count);
+        return;
+    }
+}
+
+void addSaturatedRow(Pixel *row, const std::uint8_t *add, std::size_t count) {
+    addSaturatedRow(activeSimdLevel(), row, add, count);
+}
+
+void addSaturatedRow(SimdLevel level, Pixel *row, const std::uint8_t *add, std::size_t count) {
+    switch (clampToCpu(level)) {
+#ifdef IMAGE_FILTERS_X86
+    case SimdLevel::AVX2:
+        addSaturatedAVX2(row, add, count);
+        return;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+    case SimdLevel::SSE2:
+        addSaturatedSSE2(row, add, count);
+        return;
+#endif
+#endif
+    default:
+        addSaturatedScalar(row, add, count);
+        return;
+    }
+}
+
+void addConstantSaturatedRow(Pixel *row, std::size_t count, Pixel addend) {
+    addConstantSaturatedRow(activeSimdLevel(), row, count, addend);
+}
+
+void addConstantSaturatedRow(SimdLevel level, Pixel *row, std::size_t count, Pixel addend) {
+    switch (clampToCpu(level)) {
+#ifdef IMAGE_FILTERS_X86
+    case SimdLevel::AVX2:
+        addConstantAVX2(row, count, addend);
+        return;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+    case SimdLevel::SSE2:
+        addConstantSSE2(row, count, addend);
+        return;
+#endif
+#endif
+    default:
+        addConstantScalar(row, count, addend);
+        return;
+    }
+}
+
+void scanColorUsage(const Pixel *row, std::size_t count, ColorUsage &usage) {
+    scanColorUsage(activeSimdLevel(), row, count, usage);
+}
+
+void scanColorUsage(SimdLevel level, const Pixel *row, std::size_t count, ColorUsage &usage) {
+    switch (clampToCpu(level)) {
+#ifdef IMAGE_FILTERS_X86
+    case SimdLevel::AVX2:
+        scanColorUsageAVX2(row, count, usage);
+        return;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+    case SimdLevel::SSE2:
+        scanColorUsageSSE2(row, count, usage);
+        return;
+#endif
+#endif
+    default:
+        scanColorUsageScalar(row, count, usage);
+        return;
+    }
+}
+
+void deinterleaveRow(const Pixel *row, std::size_t count, std::uint8_t *const *planes) {
+    deinterleaveRow(activeSimdLevel(), row, count, planes);
+}
+
+void deinterleaveRow(SimdLevel level, const Pixel *row, std::size_t count, std::uint8_t *const *planes) {
+    switch (clampToCpu(level)) {
+#ifdef IMAGE_FILTERS_X86
+    case SimdLevel::AVX2:
+        deinterleaveAVX2(row, count, planes);
+        return;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+    case SimdLevel::SSE2:
+        deinterleaveSSE2(row, count, planes);
+        return;
+#endif
+#endif
+    default:
+        deinterleaveScalar(row, count, planes);
+        return;
+    }
+}
+
+void interleaveRow(const std::uint8_t *const *planes, std::size_t count, Pixel *row) {
+    interleaveRow(activeSimdLevel(), planes, count, row);
+}
+
+void interleaveRow(SimdLevel level, const std::uint8_t *const *planes, std::size_t count, Pixel *row) {
+    switch (clampToCpu(level)) {
+#ifdef IMAGE_FILTERS_X86
+    case SimdLevel::AVX2:
+        interleaveAVX2(planes, count, row);
+        return;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+    case SimdLevel::SSE2:
+        interleaveSSE2(planes, count, row);
+        return;
+#endif
+#endif
+    default:
+        interleaveScalar(planes, count, row);
+        return;
+    }
+}
+
+void grayscalePlanes(std::uint8_t *r, std::uint8_t *g, std::uint8_t *b, std::size_t count) {
+    grayscalePlanes(activeSimdLevel(), r, g, b, count);
+}
+
+void grayscalePlanes(SimdLevel level, std::uint8_t *r, std::uint8_t *g, std::uint8_t *b, std::size_t count) {
+    switch (clampToCpu(level)) {
+#ifdef IMAGE_FILTERS_X86
+    case SimdLevel::AVX2:
+        grayscalePlanesAVX2(r, g, b, count);
+        return;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+    case SimdLevel::SSE2:
+        grayscalePlanesSSE2(r, g, b, count);
+        return;
+#endif
+#endif
+    default:
+        grayscalePlanesScalar(r, g, b, count);
+        return;
+    }
+}
+
+void addSaturatedPlane(std::uint8_t *plane, const std::uint8_t *add, std::size_t count) {
+    addSaturatedPlane(activeSimdLevel(), plane, add, count);
+}
+
+void addSaturatedPlane(SimdLevel level, std::uint8_t *plane, const std::uint8_t *add, std::size_t count) {
+    switch (clampToCpu(level)) {
+#ifdef IMAGE_FILTERS_X86
+    case SimdLevel::AVX2:
+        addSaturatedPlaneAVX2(plane, add, count);
+        return;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+    case SimdLevel::SSE2:
+        addSaturatedPlaneSSE2(plane, add, count);
+        return;
+#endif
+#endif
+    default:
+        addSaturatedPlaneScalar(plane, add, count);
+        return;
+    }
+}
+
+void addConstantSaturatedPlane(std::uint8_t *plane, std::size_t count, std::uint8_t addend) {
+    addConstantSaturatedPlane(activeSimdLevel(), plane, count, addend);
+}
+
+void addConstantSaturatedPlane(SimdLevel level, std::uint8_t *plane, std::size_t count, std::uint8_t addend) {
+    switch (clampToCpu(level)) {
+#ifdef IMAGE_FILTERS_X86
+    case SimdLevel::AVX2:
+        addConstantPlaneAVX2(plane, count, addend);
+        return;
+#ifdef IMAGE_FILTERS_HAVE_SSE2
+    case SimdLevel::SSE2:
+        addConstantPlaneSSE2(plane, count, addend);
+        return;
+#endif
+#endif
+    default:
+        addConstantPlaneScalar(plane, count, addend);
+        return;
+    }
+}
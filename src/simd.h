@@ -0,0 +1,266 @@
+#ifndef IMAGE_FILTERS_SIMD_H
+#define IMAGE_FILTERS_SIMD_H
+
+#include "image_filters.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \file
+ * \brief Векторные ядра фильтров и выбор набора инструкций во время выполнения
+ */
+
+/**
+ * @brief Уровень векторных инструкций, используемый ядрами фильтров.
+ */
+enum class SimdLevel {
+    Scalar, ///< Переносимая скалярная реализация.
+    SSE2,   ///< 128-битные инструкции SSE2.
+    AVX2    ///< 256-битные инструкции AVX2.
+};
+
+/**
+ * @brief Определяет наилучший уровень инструкций, поддерживаемый процессором.
+ *
+ * @return Максимальный доступный уровень; SimdLevel::Scalar на не-x86 платформах.
+ */
+SimdLevel detectSimdLevel();
+
+/**
+ * @brief Возвращает уровень инструкций, которым сейчас пользуются ядра.
+ *
+ * По умолчанию совпадает с detectSimdLevel().
+ *
+ * @return Текущий уровень.
+ */
+SimdLevel activeSimdLevel();
+
+/**
+ * @brief Принудительно задаёт уровень инструкций для ядер.
+ *
+ * Уровень, превышающий возможности процессора, понижается до detectSimdLevel().
+ * Используется в тестах и замерах для сравнения реализаций.
+ *
+ * @param level Желаемый уровень.
+ * @return Фактически установленный уровень.
+ */
+SimdLevel setSimdLevel(SimdLevel level);
+
+/**
+ * @brief Возвращает название уровня инструкций ("scalar", "sse2", "avx2").
+ *
+ * @param level Уровень.
+ * @return Строка с названием.
+ */
+const char *simdLevelName(SimdLevel level);
+
+/**
+ * @brief Переводит строку пикселей в оттенки серого с фиксированной точкой.
+ *
+ * Вычисляет (9798R + 19235G + 3735B + 16384) >> 15, что отличается от
+ * 0.299R + 0.587G + 0.114B не более чем на 1. Альфа-канал не меняется.
+ * Реализация выбирается по activeSimdLevel().
+ *
+ * @param row Указатель на первый пиксель строки.
+ * @param count Количество пикселей.
+ */
+void grayscaleRow(Pixel *row, std::size_t count);
+
+/**
+ * @brief Переводит строку в оттенки серого указанной реализацией.
+ *
+ * Результат всех реализаций побитово совпадает. Уровень, не поддерживаемый
+ * процессором, заменяется на скалярный.
+ *
+ * @param level Реализация.
+ * @param row Указатель на первый пиксель строки.
+ * @param count Количество пикселей.
+ */
+void grayscaleRow(SimdLevel level, Pixel *row, std::size_t count);
+
+/**
+ * @brief Прибавляет к каналам R, G и B пикселей строки значения с насыщением.
+ *
+ * Для каждого i каналы R, G и B пикселя row[i] увеличиваются на add[i] с
+ * ограничением сверху значением 255; альфа-канал не меняется.
+ * Реализация выбирается по activeSimdLevel().
+ *
+ * @param row Указатель на первый пиксель строки.
+ * @param add Прибавляемые значения, по одному на пиксель.
+ * @param count Количество пикселей.
+ */
+void addSaturatedRow(Pixel *row, const std::uint8_t *add, std::size_t count);
+
+/**
+ * @brief Прибавляет значения к каналам R, G и B указанной реализацией.
+ *
+ * @param level Реализация.
+ * @param row Указатель на первый пиксель строки.
+ * @param add Прибавляемые значения, по одному на пиксель.
+ * @param count Количество пикселей.
+ */
+void addSaturatedRow(SimdLevel level, Pixel *row, const std::uint8_t *add, std::size_t count);
+
+/**
+ * @brief Прибавляет ко всем пикселям строки один и тот же пиксель с насыщением.
+ *
+ * Каждый канал c пикселя row[i] увеличивается на addend[c] с ограничением сверху
+ * значением 255. Реализация выбирается по activeSimdLevel().
+ *
+ * @param row Указатель на первый пиксель строки.
+ * @param count Количество пикселей.
+ * @param addend Прибавляемые значения каналов.
+ */
+void addConstantSaturatedRow(Pixel *row, std::size_t count, Pixel addend);
+
+/**
+ * @brief Прибавляет ко всем пикселям строки пиксель указанной реализацией.
+ *
+ * @param level Реализация.
+ * @param row Указатель на первый пиксель строки.
+ * @param count Количество пикселей.
+ * @param addend Прибавляемые значения каналов.
+ */
+void addConstantSaturatedRow(SimdLevel level, Pixel *row, std::size_t count, Pixel addend);
+
+/**
+ * @brief Раскладывает строку пикселей RGBA по четырём плоскостям каналов.
+ *
+ * planes[c][i] = row[i][c] для c от 0 до 3. Реализация выбирается по activeSimdLevel().
+ *
+ * @param row Указатель на первый пиксель строки.
+ * @param count Количество пикселей.
+ * @param planes Четыре указателя на строки плоскостей R, G, B и A.
+ */
+void deinterleaveRow(const Pixel *row, std::size_t count, std::uint8_t *const *planes);
+
+/**
+ * @brief Раскладывает строку по плоскостям указанной реализацией.
+ *
+ * @param level Реализация.
+ * @param row Указатель на первый пиксель строки.
+ * @param count Количество пикселей.
+ * @param planes Четыре указателя на строки плоскостей R, G, B и A.
+ */
+void deinterleaveRow(SimdLevel level, const Pixel *row, std::size_t count, std::uint8_t *const *planes);
+
+/**
+ * @brief Собирает строку пикселей RGBA из четырёх плоскостей каналов.
+ *
+ * Обратна deinterleaveRow. Реализация выбирается по activeSimdLevel().
+ *
+ * @param planes Четыре указателя на строки плоскостей R, G, B и A.
+ * @param count Количество пикселей.
+ * @param row Указатель на первый пиксель строки.
+ */
+void interleaveRow(const std::uint8_t *const *planes, std::size_t count, Pixel *row);
+
+/**
+ * @brief Собирает строку из плоскостей указанной реализацией.
+ *
+ * @param level Реализация.
+ * @param planes Четыре указателя на строки плоскостей R, G, B и A.
+ * @param count Количество пикселей.
+ * @param row Указатель на первый пиксель строки.
+ */
+void interleaveRow(SimdLevel level, const std::uint8_t *const *planes, std::size_t count, Pixel *row);
+
+/**
+ * @brief Переводит в оттенки серого строки плоскостей R, G и B.
+ *
+ * Результат побитово совпадает с grayscaleRow для тех же пикселей.
+ * Реализация выбирается по activeSimdLevel().
+ *
+ * @param r Строка плоскости R.
+ * @param g Строка плоскости G.
+ * @param b Строка плоскости B.
+ * @param count Количество пикселей.
+ */
+void grayscalePlanes(std::uint8_t *r, std::uint8_t *g, std::uint8_t *b, std::size_t count);
+
+/**
+ * @brief Переводит строки плоскостей в оттенки серого указанной реализацией.
+ *
+ * @param level Реализация.
+ * @param r Строка плоскости R.
+ * @param g Строка плоскости G.
+ * @param b Строка плоскости B.
+ * @param count Количество пикселей.
+ */
+void grayscalePlanes(SimdLevel level, std::uint8_t *r, std::uint8_t *g, std::uint8_t *b, std::size_t count);
+
+/**
+ * @brief Прибавляет к строке плоскости значения с насыщением.
+ *
+ * plane[i] увеличивается на add[i] с ограничением сверху значением 255.
+ * Реализация выбирается по activeSimdLevel().
+ *
+ * @param plane Строка плоскости.
+ * @param add Прибавляемые значения.
+ * @param count Количество значений.
+ */
+void addSaturatedPlane(std::uint8_t *plane, const std::uint8_t *add, std::size_t count);
+
+/**
+ * @brief Прибавляет к строке плоскости значения указанной реализацией.
+ *
+ * @param level Реализация.
+ * @param plane Строка плоскости.
+ * @param add Прибавляемые значения.
+ * @param count Количество значений.
+ */
+void addSaturatedPlane(SimdLevel level, std::uint8_t *plane, const std::uint8_t *add, std::size_t count);
+
+/**
+ * @brief Прибавляет ко всем значениям строки плоскости одно число с насыщением.
+ *
+ * Реализация выбирается по activeSimdLevel().
+ *
+ * @param plane Строка плоскости.
+ * @param count Количество значений.
+ * @param addend Прибавляемое значение.
+ */
+void addConstantSaturatedPlane(std::uint8_t *plane, std::size_t count, std::uint8_t addend);
+
+/**
+ * @brief Прибавляет число к строке плоскости указанной реализацией.
+ *
+ * @param level Реализация.
+ * @param plane Строка плоскости.
+ * @param count Количество значений.
+ * @param addend Прибавляемое значение.
+ */
+void addConstantSaturatedPlane(SimdLevel level, std::uint8_t *plane, std::size_t count, std::uint8_t addend);
+
+/**
+ * @brief Свойства цветов набора пикселей, по которым выбирается наименьший тип цвета PNG.
+ */
+struct ColorUsage {
+    bool gray = true;   ///< У всех пикселей R == G == B.
+    bool opaque = true; ///< У всех пикселей альфа равна 255.
+};
+
+/**
+ * @brief Уточняет свойства цветов по строке пикселей.
+ *
+ * Сбрасывает флаги usage, которые нарушаются хотя бы одним пикселем строки; уже
+ * сброшенные флаги не восстанавливаются, поэтому строки можно просматривать по очереди.
+ * Реализация выбирается по activeSimdLevel().
+ *
+ * @param row Указатель на первый пиксель строки.
+ * @param count Количество пикселей.
+ * @param usage Накопленные свойства.
+ */
+void scanColorUsage(const Pixel *row, std::size_t count, ColorUsage &usage);
+
+/**
+ * @brief Уточняет свойства цветов по строке указанной реализацией.
+ *
+ * @param level Реализация.
+ * @param row Указатель на первый пиксель строки.
+ * @param count Количество пикселей.
+ * @param usage Накопленные свойства.
+ */
+void scanColorUsage(SimdLevel level, const Pixel *row, std::size_t count, ColorUsage &usage);
+
+#endif // IMAGE_FILTERS_SIMD_H
@@ -0,0 +1,83 @@
+#include "stats.h"
+#include "buffer_pool.h"
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <mutex>
+
+namespace {
+
+std::mutex registryMutex;
+std::deque<StatCounter> counters;
+std::map<std::string, StatCounter *> counterByName;
+
+} // namespace
+
+StatCounter &statCounter(const char *name) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    StatCounter *&counter = counterByName[name];
+    if (!counter)
+        counter = &counters.emplace_back();
+    return *counter;
+}
+
+std::vector<StatValues> statsSnapshot() {
+    std::vector<StatValues> values;
+    if (!statsEnabled())
+        return values;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto &[name, counter] : counterByName) {
+        StatValues v;
+        v.name = name;
+        v.calls = counter->calls.load(std::memory_order_relaxed);
+        v.nanoseconds = counter->nanoseconds.load(std::memory_order_relaxed);
+        v.bytesIn = counter->bytesIn.load(std::memory_order_relaxed);
+        v.bytesOut = counter->bytesOut.load(std::memory_order_relaxed);
+        v.pixels = counter->pixels.load(std::memory_order_relaxed);
+        v.allocations = counter->allocations.load(std::memory_order_relaxed);
+        values.push_back(std::move(v));
+    }
+    return values;
+}
+
+void resetStats() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (StatCounter &counter : counters) {
+        counter.calls = 0;
+        counter.nanoseconds = 0;
+        counter.bytesIn = 0;
+        counter.bytesOut = 0;
+        counter.pixels = 0;
+        counter.allocations = 0;
+    }
+}
+
+void printStats(std::ostream &out) {
+    std::vector<StatValues> values = statsSnapshot();
+    if (values.empty()) {
+        out << (statsEnabled() ? "Статистика пуста\n" : "Статистика отключена при сборке\n");
+        return;
+    }
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::left << std::setw(20) << "stage" << std::right << std::setw(10) << "calls" << std::setw(12) << "ms"
+        << std::setw(14) << "bytes_in" << std::setw(14) << "bytes_out" << std::setw(14) << "pixels" << std::setw(10)
+        << "allocs" << "\n";
+    for (const StatValues &v : values)
+        out << std::left << std::setw(20) << v.name << std::right << std::setw(10) << v.calls << std::setw(12)
+            << std::fixed << std::setprecision(3) << v.nanoseconds / 1e6 << std::setw(14) << v.bytesIn
+            << std::setw(14) << v.bytesOut << std::setw(14) << v.pixels << std::setw(10) << v.allocations << "\n";
+    BufferPoolStats pool = BufferPool::shared().stats();
+    out << "pool: requests " << pool.requests << ", hit rate " << std::setprecision(1) << pool.hitRate() * 100
+        << "%, in use " << pool.inUse << " B, cached " << pool.cached << " B, high water " << pool.highWater << " B\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool statsEnabled() {
+#ifdef IMAGE_FILTERS_STATS
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,126 @@
+#ifndef IMAGE_FILTERS_STATS_H
+#define IMAGE_FILTERS_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \brief Счётчики и таймеры этапов обработки
+ *
+ * Этапы (чтение и запись PNG, фильтры, выделение памяти) отмечаются макросами
+ * IMAGE_FILTERS_STAT_TIMER и IMAGE_FILTERS_STAT_ADD. Без определения
+ * IMAGE_FILTERS_STATS (опция CMake IMAGE_FILTERS_STATS) макросы не порождают кода,
+ * а statsSnapshot() возвращает пустой список.
+ */
+
+/**
+ * @brief Счётчики одного этапа; обновляются атомарно из любых потоков.
+ */
+struct StatCounter {
+    std::atomic<std::uint64_t> calls{0};       ///< Число завершённых замеров времени.
+    std::atomic<std::uint64_t> nanoseconds{0}; ///< Суммарное время замеров.
+    std::atomic<std::uint64_t> bytesIn{0};     ///< Прочитанные байты.
+    std::atomic<std::uint64_t> bytesOut{0};    ///< Записанные байты.
+    std::atomic<std::uint64_t> pixels{0};      ///< Обработанные пиксели.
+    std::atomic<std::uint64_t> allocations{0}; ///< Выделения буферов.
+};
+
+/**
+ * @brief Снимок счётчиков одного этапа.
+ */
+struct StatValues {
+    std::string name;
+    std::uint64_t calls = 0;
+    std::uint64_t nanoseconds = 0;
+    std::uint64_t bytesIn = 0;
+    std::uint64_t bytesOut = 0;
+    std::uint64_t pixels = 0;
+    std::uint64_t allocations = 0;
+};
+
+/**
+ * @brief Возвращает счётчики этапа, регистрируя его при первом обращении.
+ *
+ * Ссылка действительна до конца программы. Регистрация берёт блокировку, поэтому
+ * макросы кешируют ссылку в статической переменной.
+ *
+ * @param name Имя этапа, например "load.decode".
+ * @return Счётчики этапа.
+ */
+StatCounter &statCounter(const char *name);
+
+/**
+ * @brief Возвращает значения всех зарегистрированных этапов, упорядоченные по имени.
+ *
+ * @return Снимок счётчиков; пуст, если статистика отключена при сборке.
+ */
+std::vector<StatValues> statsSnapshot();
+
+/**
+ * @brief Обнуляет все счётчики.
+ */
+void resetStats();
+
+/**
+ * @brief Печатает снимок счётчиков таблицей, по строке на этап.
+ *
+ * Последняя строка — счётчики BufferPool::shared(): доля попаданий в кеш и пик занятой памяти.
+ *
+ * @param out Поток вывода.
+ */
+void printStats(std::ostream &out);
+
+/**
+ * @brief Сообщает, собрана ли библиотека со статистикой.
+ *
+ * @return true, если определён IMAGE_FILTERS_STATS.
+ */
+bool statsEnabled();
+
+/**
+ * @class ScopedStatTimer
+ * @brief Прибавляет время жизни объекта к счётчикам этапа.
+ */
+class ScopedStatTimer {
+public:
+    explicit ScopedStatTimer(StatCounter &counter) : counter(counter), start(std::chrono::steady_clock::now()) {}
+    ScopedStatTimer(const ScopedStatTimer &) = delete;
+    ScopedStatTimer &operator=(const ScopedStatTimer &) = delete;
+
+    ~ScopedStatTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        counter.nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                      std::memory_order_relaxed);
+        counter.calls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    StatCounter &counter;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define IMAGE_FILTERS_STAT_CONCAT2(a, b) a##b
+#define IMAGE_FILTERS_STAT_CONCAT(a, b) IMAGE_FILTERS_STAT_CONCAT2(a, b)
+
+#ifdef IMAGE_FILTERS_STATS
+/// Замеряет время до конца текущей области видимости.
+#define IMAGE_FILTERS_STAT_TIMER(name)                                                                                \
+    static StatCounter &IMAGE_FILTERS_STAT_CONCAT(statCounter_, __LINE__) = statCounter(name);                       \
+    ScopedStatTimer IMAGE_FILTERS_STAT_CONCAT(statTimer_, __LINE__)(IMAGE_FILTERS_STAT_CONCAT(statCounter_, __LINE__))
+/// Прибавляет value к полю field (bytesIn, bytesOut, pixels, allocations) этапа name.
+#define IMAGE_FILTERS_STAT_ADD(name, field, value)                                                                    \
+    do {                                                                                                              \
+        static StatCounter &counter_ = statCounter(name);                                                             \
+        counter_.field.fetch_add(static_cast<std::uint64_t>(value), std::memory_order_relaxed);                       \
+    } while (0)
+#else
+#define IMAGE_FILTERS_STAT_TIMER(name) static_cast<void>(0)
+#define IMAGE_FILTERS_STAT_ADD(name, field, value) static_cast<void>(0)
+#endif
+
+#endif // IMAGE_FILTERS_STATS_H
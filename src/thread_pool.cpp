@@ -0,0 +1,188 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <exception>
+
+namespace {
+
+thread_local bool insideParallelFor = false;
+
+std::mutex sharedPoolMutex;
+std::unique_ptr<ThreadPool> sharedPool;
+
+} // namespace
+
+struct ThreadPool::Job {
+    struct Range {
+        std::mutex mutex;
+        int next = 0;
+        int end = 0;
+    };
+
+    Job(int begin, int end, int chunkSize, int participants, const std::function<void(int, int)> &fn)
+        : ranges(new Range[participants]), count(participants), grain(chunkSize), body(fn) {
+        long long total = static_cast<long long>(end) - begin;
+        for (int i = 0; i < participants; ++i) {
+            ranges[i].next = begin + static_cast<int>(total * i / participants);
+            ranges[i].end = begin + static_cast<int>(total * (i + 1) / participants);
+        }
+    }
+
+    bool takeOwn(int index, int &chunkBegin, int &chunkEnd) {
+        Range &own = ranges[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.next >= own.end)
+            return false;
+        chunkBegin = own.next;
+        chunkEnd = std::min(own.next + grain, own.end);
+        own.next = chunkEnd;
+        return true;
+    }
+
+    bool steal(int index) {
+        for (;;) {
+            int victim = -1;
+            int largest = 0;
+            for (int i = 0; i < count; ++i) {
+                if (i == index)
+                    continue;
+                std::lock_guard<std::mutex> lock(ranges[i].mutex);
+                int remaining = ranges[i].end - ranges[i].next;
+                if (remaining > largest) {
+                    largest = remaining;
+                    victim = i;
+                }
+            }
+            if (victim < 0)
+                return false;
+
+            int stolenBegin, stolenEnd;
+            {
+                std::lock_guard<std::mutex> lock(ranges[victim].mutex);
+                int remaining = ranges[victim].end - ranges[victim].next;
+                if (remaining <= 0)
+                    continue;
+                stolenBegin = remaining <= grain ? ranges[victim].next : ranges[victim].next + remaining / 2;
+                stolenEnd = ranges[victim].end;
+                ranges[victim].end = stolenBegin;
+            }
+            std::lock_guard<std::mutex> lock(ranges[index].mutex);
+            ranges[index].next = stolenBegin;
+            ranges[index].end = stolenEnd;
+            return true;
+        }
+    }
+
+    void run(int index) {
+        int chunkBegin, chunkEnd;
+        do {
+            while (takeOwn(index, chunkBegin, chunkEnd)) {
+                try {
+                    body(chunkBegin, chunkEnd);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+        } while (steal(index));
+    }
+
+    std::unique_ptr<Range[]> ranges;
+    int count;
+    int grain;
+    const std::function<void(int, int)> &body;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0)
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(threads, 1);
+    workers.reserve(threads - 1);
+    for (int i = 0; i < threads - 1; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i + 1);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::workerLoop(int index) {
+    insideParallelFor = true;
+    std::size_t seen = 0;
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wakeWorkers.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            job = currentJob;
+        }
+        job->run(index);
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (--activeWorkers == 0)
+                jobDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body) {
+    if (end <= begin)
+        return;
+    grain = std::max(grain, 1);
+
+    bool serial = workers.empty() || insideParallelFor || end - begin <= grain;
+    if (serial || !submitMutex.try_lock()) {
+        for (int chunk = begin; chunk < end; chunk += grain)
+            body(chunk, std::min(chunk + grain, end));
+        return;
+    }
+
+    auto job = std::make_shared<Job>(begin, end, grain, size(), body);
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        currentJob = job;
+        activeWorkers = static_cast<int>(workers.size());
+        ++generation;
+    }
+    wakeWorkers.notify_all();
+
+    insideParallelFor = true;
+    job->run(0);
+    insideParallelFor = false;
+
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        jobDone.wait(lock, [&] { return activeWorkers == 0; });
+        currentJob.reset();
+    }
+    submitMutex.unlock();
+
+    if (job->error)
+        std::rethrow_exception(job->error);
+}
+
+ThreadPool &ThreadPool::shared() {
+    std::lock_guard<std::mutex> lock(sharedPoolMutex);
+    if (!sharedPool)
+        sharedPool = std::make_unique<ThreadPool>();
+    return *sharedPool;
+}
+
+void setThreadCount(int threads) {
+    std::lock_guard<std::mutex> lock(sharedPoolMutex);
+    sharedPool.reset();
+    sharedPool = std::make_unique<ThreadPool>(threads);
+}
+
+int getThreadCount() { return ThreadPool::shared().size(); }
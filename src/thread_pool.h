@@ -0,0 +1,149 @@
+#ifndef IMAGE_FILTERS_THREAD_POOL_H
+#define IMAGE_FILTERS_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \file
+ * \brief Общий пул потоков и разбиение изображения на полосы строк
+ */
+
+/**
+ * @class ThreadPool
+ * @brief Пул потоков с планировщиком диапазонов и перехватом работы (work stealing).
+ *
+ * Диапазон [begin, end) делится между участниками на непрерывные части; участник,
+ * закончивший свою часть, забирает вторую половину самой большой оставшейся части
+ * другого участника. Вызывающий поток тоже участвует в работе.
+ *
+ * Пул выполняет одну работу за раз, очереди работ нет. Вложенные вызовы и вызовы из
+ * других потоков, пришедшие во время уже идущей работы, не ждут пул, а выполняют
+ * весь свой диапазон в вызывающем потоке. Поэтому при нескольких одновременных
+ * источниках работы (потоки записи пакетной обработки с SaveOptions::parallel,
+ * соединения сервера, поток записи последовательности кадров) пул ускоряет только
+ * тот вызов, который успел его занять; остальные параллельны лишь за счёт
+ * собственных потоков вызывающих.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Создаёт пул с заданным числом участников.
+     *
+     * @param threads Число потоков, включая вызывающий; 0 означает число аппаратных потоков.
+     */
+    explicit ThreadPool(int threads = 0);
+
+    /**
+     * @brief Останавливает и дожидается рабочие потоки.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Возвращает число участников, включая вызывающий поток.
+     *
+     * @return Число потоков, не меньше 1.
+     */
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    /**
+     * @brief Параллельно выполняет body над частями диапазона [begin, end).
+     *
+     * Диапазон режется на куски не длиннее grain; body вызывается для каждого куска
+     * ровно один раз. Возвращается после обработки всего диапазона.
+     *
+     * Куски выполняются последовательно в вызывающем потоке, без ожидания пула, если
+     * пул уже занят работой другого потока, если вызов сделан изнутри body или если
+     * диапазон не длиннее grain.
+     *
+     * @param begin Начало диапазона.
+     * @param end Конец диапазона (не включается).
+     * @param grain Максимальная длина куска, не меньше 1.
+     * @param body Функция вида body(int chunkBegin, int chunkEnd).
+     */
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body);
+
+    /**
+     * @brief Возвращает общий пул, используемый фильтрами.
+     *
+     * @return Ссылка на общий пул.
+     */
+    static ThreadPool &shared();
+
+private:
+    struct Job;
+
+    void workerLoop(int index);
+
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;
+    std::mutex stateMutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable jobDone;
+    std::shared_ptr<Job> currentJob;
+    std::size_t generation = 0;
+    int activeWorkers = 0;
+    bool stopping = false;
+};
+
+/**
+ * @brief Задаёт число потоков общего пула.
+ *
+ * Пересоздаёт общий пул; нельзя вызывать, пока фильтры выполняются в других потоках.
+ *
+ * @param threads Число потоков; 0 означает число аппаратных потоков, 1 отключает многопоточность.
+ */
+void setThreadCount(int threads);
+
+/**
+ * @brief Возвращает число потоков общего пула.
+ *
+ * @return Число потоков, не меньше 1.
+ */
+int getThreadCount();
+
+/**
+ * @brief Параллельно делит строки [0, height) на полосы и обрабатывает их в общем пуле.
+ *
+ * Полоса занимает около 64 КБ данных, но полос не меньше четырёх на поток, чтобы
+ * перехват работы выравнивал нагрузку при неравномерной стоимости строк.
+ *
+ * @param height Число строк.
+ * @param rowBytes Примерный объём данных одной строки в байтах.
+ * @param f Функция вида f(int y0, int y1), вызываемая для каждой полосы [y0, y1).
+ */
+template <typename F> void parallelBands(int height, std::size_t rowBytes, F &&f) {
+    constexpr std::size_t kTargetBandBytes = 64 * 1024;
+    if (height <= 0)
+        return;
+    int grain = static_cast<int>(kTargetBandBytes / (rowBytes ? rowBytes : 1));
+    grain = grain < 1 ? 1 : grain;
+    ThreadPool &pool = ThreadPool::shared();
+    int maxGrain = (height + pool.size() * 4 - 1) / (pool.size() * 4);
+    grain = grain > maxGrain ? maxGrain : grain;
+    pool.parallelFor(0, height, grain, [&f](int y0, int y1) { f(y0, y1); });
+}
+
+/**
+ * @brief Параллельно обрабатывает строки [0, height) полосами в общем пуле (см. parallelBands).
+ *
+ * @param height Число строк.
+ * @param rowBytes Примерный объём данных одной строки в байтах.
+ * @param f Функция вида f(int y), вызываемая для каждой строки.
+ */
+template <typename F> void parallelRows(int height, std::size_t rowBytes, F &&f) {
+    parallelBands(height, rowBytes, [&f](int y0, int y1) {
+        for (int y = y0; y < y1; ++y)
+            f(y);
+    });
+}
+
+#endif // IMAGE_FILTERS_THREAD_POOL_H
@@ -0,0 +1,359 @@
+#include "tiled_image.h"
+#include "filter_kernels.h"
+#include "png_encoder.h"
+#include "png_io.h"
+#include "stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define IMAGE_FILTERS_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Построчное ядро для строки формата изображения: f(row, y).
+using TileRowKernel = std::function<void(std::uint8_t *, int)>;
+
+TileRowKernel makeTileKernel(const FilterStage &stage, const TiledImage &img) {
+    PixelFormat format = img.getFormat();
+    int width = img.getWidth();
+    switch (stage.type) {
+    case FilterType::SolarRays: {
+        // Таблица на всё изображение не должна занимать память: яркость считается по строкам.
+        SolarRaysKernel kernel(width, img.getHeight(), false);
+        return [kernel, format, width](std::uint8_t *row, int y) { kernel.apply(format, row, width, y); };
+    }
+    case FilterType::ColorNoise: {
+        ColorNoiseKernel kernel{stage.params.intensity, stage.params.seed};
+        return [kernel, format, width](std::uint8_t *row, int y) { kernel.apply(format, row, width, y); };
+    }
+    case FilterType::Glitch: {
+        GlitchKernel kernel{stage.params.seed, stage.params.glitch};
+        return [kernel, format, width](std::uint8_t *row, int y) {
+            if (kernel.touches(y))
+                kernel.apply(format, row, width, y);
+        };
+    }
+    case FilterType::Grayscale:
+        return [format, width](std::uint8_t *row, int y) { GrayscaleKernel{}.apply(format, row, width, y); };
+    default:
+        return {};
+    }
+}
+
+/// Вызывает f(y0, y1) для каждой плитки; одновременно в работе не больше residentTiles() плиток.
+template <typename F> void forEachTile(const TiledImage &img, F &&f) {
+    int tiles = img.tileCount();
+    int group = img.residentTiles();
+    int rows = img.tileRows();
+    for (int first = 0; first < tiles; first += group) {
+        ThreadPool::shared().parallelFor(first, std::min(first + group, tiles), 1, [&](int t0, int t1) {
+            for (int t = t0; t < t1; ++t)
+                f(t * rows, std::min((t + 1) * rows, img.getHeight()));
+        });
+    }
+}
+
+void applyRowLocal(TiledImage &img, const std::vector<TileRowKernel> &kernels) {
+    forEachTile(img, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y)
+            for (const TileRowKernel &kernel : kernels)
+                kernel(img.row(y), y);
+        img.release(y0, y1);
+    });
+}
+
+void applyWave(TiledImage &img, float amplitude) {
+    int width = img.getWidth();
+    int height = img.getHeight();
+    if (width == 0 || height == 0)
+        return;
+    TiledImage target(img.getOptions());
+    if (!target.create(width, height, img.getFormat()))
+        throw std::bad_alloc();
+
+    WaveKernel kernel(amplitude, width, height);
+    int reach = kernel.reach();
+    forEachTile(img, [&](int y0, int y1) {
+        PooledVector<const std::uint8_t *> window(2 * reach + 1);
+        for (int y = y0; y < y1; ++y) {
+            for (int k = 0; k <= 2 * reach; ++k) {
+                int sy = y - reach + k;
+                window[k] = sy >= 0 && sy < height ? img.row(sy) : nullptr;
+            }
+            kernel.apply(img.getFormat(), target.row(y), y, window.data());
+        }
+        img.release(std::max(y0 - reach, 0), std::min(y1 + reach, height));
+        target.release(y0, y1);
+    });
+    img.swapStorage(target);
+}
+
+} // namespace
+
+TiledImage::~TiledImage() { unmap(); }
+
+TiledImage::TiledImage(TiledImage &&other) noexcept : options(other.options) { swapStorage(other); }
+
+TiledImage &TiledImage::operator=(TiledImage &&other) noexcept {
+    if (this != &other) {
+        unmap();
+        options = other.options;
+        swapStorage(other);
+    }
+    return *this;
+}
+
+void TiledImage::swapStorage(TiledImage &other) noexcept {
+    std::swap(width, other.width);
+    std::swap(height, other.height);
+    std::swap(format, other.format);
+    std::swap(stride, other.stride);
+    std::swap(bytes, other.bytes);
+    std::swap(fd, other.fd);
+    std::swap(mapped, other.mapped);
+}
+
+void TiledImage::unmap() noexcept {
+#ifdef IMAGE_FILTERS_HAVE_MMAP
+    if (mapped)
+        munmap(mapped, bytes);
+    if (fd >= 0)
+        close(fd);
+#endif
+    width = height = 0;
+    stride = bytes = 0;
+    fd = -1;
+    mapped = nullptr;
+}
+
+int TiledImage::residentTiles() const {
+    return options.maxResidentTiles > 0 ? options.maxResidentTiles : getThreadCount();
+}
+
+bool TiledImage::create(int newWidth, int newHeight, PixelFormat newFormat) {
+    unmap();
+#ifdef IMAGE_FILTERS_HAVE_MMAP
+    std::error_code error;
+    std::filesystem::path dir =
+        options.scratchDir.empty() ? std::filesystem::temp_directory_path(error) : std::filesystem::path(options.scratchDir);
+    std::string name = (dir / "image_filters_tile_XXXXXX").string();
+    int file = mkstemp(name.data());
+    if (file < 0)
+        return false;
+    // Имя сразу удаляется: место на диске освобождается вместе с дескриптором.
+    unlink(name.c_str());
+
+    std::size_t rowBytes = static_cast<std::size_t>(std::max(newWidth, 0)) * bytesPerPixel(newFormat);
+    std::size_t newStride = (rowBytes + Image::kRowAlignment - 1) / Image::kRowAlignment * Image::kRowAlignment;
+    std::size_t newBytes = newStride * std::max(newHeight, 0);
+    void *memory = nullptr;
+    if (newBytes > 0) {
+        memory = ftruncate(file, static_cast<off_t>(newBytes)) == 0
+                     ? mmap(nullptr, newBytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0)
+                     : MAP_FAILED;
+        if (memory == MAP_FAILED) {
+            close(file);
+            return false;
+        }
+    }
+    width = std::max(newWidth, 0);
+    height = std::max(newHeight, 0);
+    format = newFormat;
+    stride = newStride;
+    bytes = newBytes;
+    fd = file;
+    mapped = static_cast<unsigned char *>(memory);
+    IMAGE_FILTERS_STAT_ADD("tiled.create", allocations, 1);
+    IMAGE_FILTERS_STAT_ADD("tiled.create", bytesOut, bytes);
+    return true;
+#else
+    static_cast<void>(newWidth);
+    static_cast<void>(newHeight);
+    static_cast<void>(newFormat);
+    return false;
+#endif
+}
+
+void TiledImage::release(int y0, int y1) const {
+#ifdef IMAGE_FILTERS_HAVE_MMAP
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, height);
+    if (!mapped || y0 >= y1)
+        return;
+    // madvise требует адрес, выровненный по странице; крайние неполные страницы остаются.
+    auto pageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto begin = reinterpret_cast<std::uintptr_t>(row(y0));
+    auto end = reinterpret_cast<std::uintptr_t>(row(y0)) + static_cast<std::size_t>(y1 - y0) * stride;
+    begin = (begin + pageSize - 1) / pageSize * pageSize;
+    end = end / pageSize * pageSize;
+    if (begin >= end)
+        return;
+    msync(reinterpret_cast<void *>(begin), end - begin, MS_ASYNC);
+    madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+#else
+    static_cast<void>(y0);
+    static_cast<void>(y1);
+#endif
+}
+
+bool TiledImage::copyFrom(const Image &img) {
+    if (!create(img.getWidth(), img.getHeight(), img.getFormat()))
+        return false;
+    std::size_t rowBytes = static_cast<std::size_t>(width) * bytesPerPixel(format);
+    forEachTile(*this, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y)
+            std::memcpy(row(y), img.row(y), rowBytes);
+        release(y0, y1);
+    });
+    return true;
+}
+
+Image TiledImage::readRows(int y0, int y1) const {
+    y0 = std::clamp(y0, 0, height);
+    y1 = std::clamp(y1, y0, height);
+    Image rows(width, y1 - y0, format);
+    std::size_t rowBytes = static_cast<std::size_t>(width) * bytesPerPixel(format);
+    for (int y = y0; y < y1; ++y)
+        std::memcpy(rows.row(y - y0), row(y), rowBytes);
+    return rows;
+}
+
+bool TiledImage::load(const std::string &filename) {
+    IMAGE_FILTERS_STAT_TIMER("tiled.load");
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file)
+        return false;
+    png_structp png = createPngReadStruct();
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!png || !info || setjmp(png_jmpbuf(png))) {
+        if (png) png_destroy_read_struct(&png, &info, nullptr);
+        fclose(file);
+        unmap();
+        return false;
+    }
+
+    png_init_io(png, file);
+    png_read_info(png, info);
+    int newWidth = png_get_image_width(png, info);
+    int newHeight = png_get_image_height(png, info);
+    PixelFormat newFormat = setNativeReadTransforms(png, info);
+    int passes = png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+    if (!create(newWidth, newHeight, newFormat))
+        png_error(png, "cannot create scratch file");
+
+    // Для Adam7 каждый проход дополняет уже прочитанные строки.
+    for (int pass = 0; pass < passes; ++pass) {
+        for (int y0 = 0; y0 < height; y0 += tileRows()) {
+            int y1 = std::min(y0 + tileRows(), height);
+            for (int y = y0; y < y1; ++y)
+                png_read_row(png, row(y), nullptr);
+            release(y0, y1);
+        }
+    }
+    png_read_end(png, nullptr);
+    IMAGE_FILTERS_STAT_ADD("tiled.load", bytesIn, ftell(file));
+    IMAGE_FILTERS_STAT_ADD("tiled.load", pixels, static_cast<std::size_t>(width) * height);
+    png_destroy_read_struct(&png, &info, nullptr);
+    fclose(file);
+    return true;
+}
+
+bool TiledImage::save(const std::string &filename, const SaveOptions &options) const {
+    IMAGE_FILTERS_STAT_TIMER("tiled.save");
+    if (!mapped)
+        return false;
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file)
+        return false;
+    png_structp png = createPngWriteStruct();
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!png || !info || setjmp(png_jmpbuf(png))) {
+        if (png) png_destroy_write_struct(&png, &info);
+        fclose(file);
+        return false;
+    }
+
+    png_init_io(png, file);
+    png_set_compression_level(png, std::clamp(options.compressionLevel, 0, 9));
+    if (options.strategy != ZlibStrategy::Auto)
+        png_set_compression_strategy(png, toZlibStrategy(options.strategy, options.rowFilters));
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, options.rowFilters & PNG_ALL_FILTERS ? options.rowFilters : PNG_FILTER_NONE);
+    int colorType, bitDepth;
+    pngColorType(format, colorType, bitDepth);
+    png_set_IHDR(png, info, width, height, bitDepth, colorType, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    if (bitDepth == 16 && hostIsLittleEndian())
+        png_set_swap(png);
+
+    for (int y0 = 0; y0 < height; y0 += tileRows()) {
+        int y1 = std::min(y0 + tileRows(), height);
+        for (int y = y0; y < y1; ++y)
+            png_write_row(png, const_cast<png_bytep>(row(y)));
+        release(y0, y1);
+    }
+    png_write_end(png, nullptr);
+    IMAGE_FILTERS_STAT_ADD("tiled.save", bytesOut, ftell(file));
+    IMAGE_FILTERS_STAT_ADD("tiled.save", pixels, static_cast<std::size_t>(width) * height);
+    png_destroy_write_struct(&png, &info);
+    return fclose(file) == 0;
+}
+
+void applySolarRays(TiledImage &img) { applyFilter(img, FilterType::SolarRays); }
+
+void applyWaveDistortion(TiledImage &img, float amplitude) {
+    FilterParams params;
+    params.amplitude = amplitude;
+    applyFilter(img, FilterType::WaveDistortion, params);
+}
+
+void applyColorNoise(TiledImage &img, float intensity, std::uint64_t seed) {
+    FilterParams params;
+    params.intensity = intensity;
+    params.seed = seed;
+    applyFilter(img, FilterType::ColorNoise, params);
+}
+
+void applyGlitch(TiledImage &img, std::uint64_t seed, const GlitchOptions &options) {
+    FilterParams params;
+    params.seed = seed;
+    params.glitch = options;
+    applyFilter(img, FilterType::Glitch, params);
+}
+
+void applyGrayscale(TiledImage &img) { applyFilter(img, FilterType::Grayscale); }
+
+void applyFilter(TiledImage &img, FilterType type, const FilterParams &params) {
+    applyPipeline(img, FilterPipeline().add(type, params));
+}
+
+void applyPipeline(TiledImage &img, const FilterPipeline &pipeline) {
+    IMAGE_FILTERS_STAT_TIMER("tiled.filter");
+    IMAGE_FILTERS_STAT_ADD("tiled.filter", pixels,
+                           static_cast<std::size_t>(img.getWidth()) * img.getHeight() * pipeline.stages().size());
+    const std::vector<FilterStage> &stages = pipeline.stages();
+    std::size_t i = 0;
+    while (i < stages.size()) {
+        if (!isRowLocal(stages[i].type)) {
+            applyWave(img, stages[i].params.amplitude);
+            ++i;
+            continue;
+        }
+        std::vector<TileRowKernel> fused;
+        for (; i < stages.size() && isRowLocal(stages[i].type); ++i)
+            fused.push_back(makeTileKernel(stages[i], img));
+        applyRowLocal(img, fused);
+    }
+}
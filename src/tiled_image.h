@@ -0,0 +1,252 @@
+#ifndef IMAGE_FILTERS_TILED_IMAGE_H
+#define IMAGE_FILTERS_TILED_IMAGE_H
+
+#include "filter_pipeline.h"
+#include "image_filters.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * \file
+ * \brief Изображения больше оперативной памяти: пиксели в отображённом в память файле, обработка плитками
+ */
+
+/**
+ * @brief Параметры хранения и обработки TiledImage.
+ */
+struct TiledOptions {
+    std::string scratchDir; ///< Каталог для временных файлов; пустой — std::filesystem::temp_directory_path().
+    int tileRows = 256;     ///< Высота плитки в строках; плитка занимает всю ширину изображения.
+    /**
+     * Сколько плиток обрабатывается одновременно; 0 — по числу потоков общего пула.
+     * Обработанные плитки выгружаются из памяти процесса, поэтому резидентный объём
+     * ограничен примерно maxResidentTiles * tileRows * getStride() байтами (для
+     * волнового искажения — вдвое больше плюс ореол в 2 * |amplitude| строк).
+     */
+    int maxResidentTiles = 0;
+};
+
+/**
+ * @class TiledImage
+ * @brief Изображение, пиксели которого хранятся во временном файле на локальном диске.
+ *
+ * Файл отображается в память (mmap) и удаляется из каталога сразу после создания,
+ * поэтому освобождается при уничтожении объекта или аварийном завершении. Раскладка
+ * строк та же, что у Image: шаг getStride() кратен Image::kRowAlignment.
+ *
+ * Фильтры (см. перегрузки applySolarRays и др. ниже) обрабатывают изображение
+ * горизонтальными плитками во всю ширину, так как глитч поворачивает строки
+ * целиком. Построчные фильтры работают на месте; волновое искажение читает плитку
+ * с ореолом в reach() строк из исходного файла и пишет во второй временный файл.
+ * Результат совпадает с обработкой того же изображения в Image.
+ *
+ * На платформах без mmap create() и load() возвращают false.
+ */
+class TiledImage {
+public:
+    /**
+     * @brief Создаёт пустое изображение с параметрами по умолчанию.
+     */
+    TiledImage() = default;
+
+    /**
+     * @brief Создаёт пустое изображение с заданными параметрами хранения.
+     *
+     * @param options Параметры.
+     */
+    explicit TiledImage(const TiledOptions &options) : options(options) {}
+
+    ~TiledImage();
+
+    TiledImage(const TiledImage &) = delete;
+    TiledImage &operator=(const TiledImage &) = delete;
+    TiledImage(TiledImage &&other) noexcept;
+    TiledImage &operator=(TiledImage &&other) noexcept;
+
+    /**
+     * @brief Выделяет временный файл под изображение, заполненное нулями.
+     *
+     * @param width Ширина в пикселях.
+     * @param height Высота в пикселях.
+     * @param format Формат пикселей.
+     * @return true, если файл создан и отображён в память.
+     */
+    bool create(int width, int height, PixelFormat format = PixelFormat::RGBA8);
+
+    /**
+     * @brief Копирует изображение из памяти во временный файл.
+     *
+     * @param img Изображение.
+     * @return true, если файл создан.
+     */
+    bool copyFrom(const Image &img);
+
+    /**
+     * @brief Построчно распаковывает PNG во временный файл, сохраняя формат источника.
+     *
+     * Форматы преобразуются так же, как в Image::load(filename). В памяти процесса
+     * одновременно находится не больше одной плитки.
+     *
+     * @param filename Путь к файлу PNG.
+     * @return true, если загрузка прошла успешно.
+     */
+    bool load(const std::string &filename);
+
+    /**
+     * @brief Построчно записывает изображение в PNG.
+     *
+     * Используются уровень, стратегия и фильтры строк из options; параллельное сжатие
+     * и reduceFormat требуют изображения в памяти и здесь не применяются.
+     *
+     * @param filename Путь к файлу результата.
+     * @param options Параметры записи.
+     * @return true, если запись прошла успешно.
+     */
+    bool save(const std::string &filename, const SaveOptions &options = SaveOptions{}) const;
+
+    /**
+     * @brief Копирует строки [y0, y1) в изображение в памяти.
+     *
+     * @param y0 Первая строка.
+     * @param y1 Строка после последней; значения вне [0, getHeight()] ограничиваются.
+     * @return Изображение шириной getWidth() и высотой y1 - y0.
+     */
+    Image readRows(int y0, int y1) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    PixelFormat getFormat() const { return format; }
+    std::size_t getStride() const { return stride; }
+    const TiledOptions &getOptions() const { return options; }
+
+    /**
+     * @brief Возвращает высоту плитки в строках.
+     *
+     * @return Не меньше 1.
+     */
+    int tileRows() const { return options.tileRows > 0 ? options.tileRows : 1; }
+
+    /**
+     * @brief Возвращает число плиток.
+     *
+     * @return Число горизонтальных плиток, покрывающих изображение.
+     */
+    int tileCount() const { return (height + tileRows() - 1) / tileRows(); }
+
+    /**
+     * @brief Возвращает число плиток, обрабатываемых одновременно.
+     *
+     * @return Не меньше 1.
+     */
+    int residentTiles() const;
+
+    /**
+     * @brief Возвращает указатель на начало строки y без проверки границ.
+     *
+     * @param y Номер строки.
+     * @return Указатель в отображённый файл.
+     */
+    unsigned char *row(int y) { return mapped + static_cast<std::size_t>(y) * stride; }
+
+    /**
+     * @brief Возвращает указатель на начало строки y без проверки границ (только чтение).
+     *
+     * @param y Номер строки.
+     * @return Указатель в отображённый файл.
+     */
+    const unsigned char *row(int y) const { return mapped + static_cast<std::size_t>(y) * stride; }
+
+    /**
+     * @brief Выгружает строки [y0, y1) из памяти процесса.
+     *
+     * Изменённые страницы остаются в страничном кеше и записываются в файл ядром.
+     *
+     * @param y0 Первая строка.
+     * @param y1 Строка после последней.
+     */
+    void release(int y0, int y1) const;
+
+    /**
+     * @brief Меняет местами хранилища двух изображений одинакового размера.
+     *
+     * Используется фильтрами, которые пишут результат во второй временный файл.
+     *
+     * @param other Другое изображение.
+     */
+    void swapStorage(TiledImage &other) noexcept;
+
+private:
+    void unmap() noexcept;
+
+    TiledOptions options;
+    int width = 0;
+    int height = 0;
+    PixelFormat format = PixelFormat::RGBA8;
+    std::size_t stride = 0;
+    std::size_t bytes = 0;
+    int fd = -1;
+    unsigned char *mapped = nullptr;
+};
+
+/**
+ * @brief Применяет эффект солнечных лучей к изображению на диске.
+ *
+ * @param img Изображение.
+ */
+void applySolarRays(TiledImage &img);
+
+/**
+ * @brief Применяет волновое искажение к изображению на диске.
+ *
+ * @param img Изображение.
+ * @param amplitude Амплитуда искажения.
+ */
+void applyWaveDistortion(TiledImage &img, float amplitude = 10.0f);
+
+/**
+ * @brief Добавляет цветовой шум к изображению на диске.
+ *
+ * @param img Изображение.
+ * @param intensity Интенсивность шума.
+ * @param seed Зерно генератора.
+ */
+void applyColorNoise(TiledImage &img, float intensity = 0.1f, std::uint64_t seed = 0);
+
+/**
+ * @brief Применяет эффект глитча к изображению на диске.
+ *
+ * @param img Изображение.
+ * @param seed Зерно генератора.
+ * @param options Параметры эффекта.
+ */
+void applyGlitch(TiledImage &img, std::uint64_t seed = 0, const GlitchOptions &options = GlitchOptions{});
+
+/**
+ * @brief Переводит изображение на диске в оттенки серого.
+ *
+ * @param img Изображение.
+ */
+void applyGrayscale(TiledImage &img);
+
+/**
+ * @brief Применяет фильтр заданного вида к изображению на диске.
+ *
+ * @param img Изображение.
+ * @param type Вид фильтра.
+ * @param params Параметры фильтра.
+ */
+void applyFilter(TiledImage &img, FilterType type, const FilterParams &params = {});
+
+/**
+ * @brief Применяет цепочку фильтров к изображению на диске.
+ *
+ * Соседние построчные фильтры объединяются в один проход по каждой плитке, как в
+ * FilterPipeline::apply, поэтому плитка читается с диска один раз на проход.
+ *
+ * @param img Изображение.
+ * @param pipeline Цепочка фильтров.
+ */
+void applyPipeline(TiledImage &img, const FilterPipeline &pipeline);
+
+#endif // IMAGE_FILTERS_TILED_IMAGE_H
@@ -1,8 +1,40 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "../external/doctest.h"
 #include "../src/image_filters.h"
+#include "../src/batch.h"
+#include "../src/buffer_pool.h"
+#include "../src/filter_kernels.h"
+#include "../src/filter_pipeline.h"
+#include "../src/frame_sequence.h"
+#include "../src/geometry_cache.h"
+#include "../src/philox.h"
+#include "../src/planar_image.h"
+#include "../src/png_reduce.h"
+#include "../src/png_stream.h"
+#include "../src/remap.h"
+#include "../src/result_cache.h"
+#include "../src/server.h"
+#include "../src/simd.h"
+#include "../src/stats.h"
+#include "../src/tiled_image.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
 #include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 namespace fs = std::filesystem;
 
 bool loadImage(Image &img, const std::string &filename = "input.png") {
@@ -13,6 +45,16 @@ bool loadImage(Image &img, const std::string &filename = "input.png") {
     return loaded;
 }
 
+bool samePixels(const Image &a, const Image &b) {
+    if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight() || a.getFormat() != b.getFormat())
+        return false;
+    std::size_t rowBytes = static_cast<std::size_t>(a.getWidth()) * a.getBytesPerPixel();
+    for (int y = 0; y < a.getHeight(); ++y)
+        if (!std::equal(a.row(y), a.row(y) + rowBytes, b.row(y)))
+            return false;
+    return true;
+}
+
 TEST_CASE("Image::load - положительный и отрицательный") {
     Image img;
     CHECK_FALSE(img.load("nonexistent.png"));
@@ -52,6 +94,52 @@ TEST_CASE("Image::setPixel - положительный и отрицатель
     CHECK(img.getPixel(img.getWidth(), img.getHeight()) == std::vector<unsigned char>{0, 0, 0, 255});
 }
 
+TEST_CASE("Image - непрерывный выровненный буфер и сохранение без копирования") {
+    Image img(37, 5);
+    REQUIRE(img.getWidth() == 37);
+    REQUIRE(img.getHeight() == 5);
+    CHECK(img.getStride() >= 37 * 4);
+    CHECK(img.getStride() % Image::kRowAlignment == 0);
+    CHECK(reinterpret_cast<std::uintptr_t>(img.data()) % Image::kRowAlignment == 0);
+    CHECK(img.row(1) == img.data() + img.getStride());
+
+    std::vector<unsigned char> color{10, 20, 30, 40};
+    img.setPixel(36, 4, color);
+    CHECK(img.row(4)[36 * 4 + 2] == 30);
+    REQUIRE(img.save("flat_roundtrip.png"));
+
+    Image loaded;
+    REQUIRE(loaded.load("flat_roundtrip.png"));
+    CHECK(loaded.getWidth() == 37);
+    CHECK(loaded.getPixel(36, 4) == color);
+    CHECK(loaded.getPixel(0, 0) == std::vector<unsigned char>{0, 0, 0, 0});
+}
+
+TEST_CASE("Pixel, rowPixels и forEachPixel - доступ без копирования") {
+    Image img(8, 3);
+    forEachPixel(img, [](Pixel &p, int x, int y) { p = Pixel{static_cast<std::uint8_t>(x), static_cast<std::uint8_t>(y), 7, 255}; });
+    CHECK(img.getPixel(5, 2) == std::vector<unsigned char>{5, 2, 7, 255});
+    CHECK(&img.pixelAt(3, 1) == &img.rowPixels(1)[3]);
+
+    int rows = 0;
+    transformRows(img, [&rows](Span<Pixel> row, int y) {
+        CHECK(row.size() == 8);
+        for (Pixel &p : row)
+            p[2] = static_cast<std::uint8_t>(y * 10);
+        ++rows;
+    });
+    CHECK(rows == 3);
+    CHECK(img.pixelAt(0, 2)[2] == 20);
+
+    forEachPixel(img, [](Pixel &p) { p[3] = 0; });
+    CHECK(img.getPixel(7, 0) == std::vector<unsigned char>{7, 0, 0, 0});
+
+    Image empty;
+    int calls = 0;
+    forEachPixel(empty, [&calls](Pixel &) { ++calls; });
+    CHECK(calls == 0);
+}
+
 TEST_CASE("applyWaveDistortion - положительный и отрицательный тесты") {
     Image img;
     REQUIRE(loadImage(img));
@@ -194,3 +282,1483 @@ TEST_CASE("applyColorNoise - положительный и отрицатель
     }
     CHECK(isUnchanged);
 }
+
+TEST_CASE("grayscaleRow - SIMD-реализации совпадают со скалярной и эталоном в пределах 1") {
+    std::mt19937 gen(12345);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<Pixel> source(1027);
+    for (Pixel &p : source)
+        for (auto &c : p)
+            c = static_cast<std::uint8_t>(byte(gen));
+    source[0] = Pixel{255, 255, 255, 17};
+    source[1] = Pixel{0, 0, 0, 200};
+
+    std::vector<Pixel> scalar = source;
+    grayscaleRow(SimdLevel::Scalar, scalar.data(), scalar.size());
+    int maxError = 0;
+    bool layoutKept = true;
+    for (std::size_t i = 0; i < source.size(); ++i) {
+        const Pixel &s = source[i];
+        int reference = static_cast<int>(0.299 * s[0] + 0.587 * s[1] + 0.114 * s[2]);
+        maxError = std::max(maxError, std::abs(scalar[i][0] - reference));
+        layoutKept = layoutKept && scalar[i][0] == scalar[i][1] && scalar[i][1] == scalar[i][2] && scalar[i][3] == s[3];
+    }
+    CHECK(maxError <= 1);
+    CHECK(layoutKept);
+
+    for (SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+        std::vector<Pixel> vectorized = source;
+        grayscaleRow(level, vectorized.data(), vectorized.size());
+        CHECK(vectorized == scalar);
+    }
+
+    SimdLevel previous = activeSimdLevel();
+    CHECK(setSimdLevel(SimdLevel::Scalar) == SimdLevel::Scalar);
+    CHECK(activeSimdLevel() == SimdLevel::Scalar);
+    CHECK(setSimdLevel(SimdLevel::AVX2) == detectSimdLevel());
+    setSimdLevel(previous);
+}
+
+TEST_CASE("ThreadPool::parallelFor - каждый индекс обрабатывается ровно один раз") {
+    for (int threads : {1, 3, 8}) {
+        ThreadPool pool(threads);
+        CHECK(pool.size() == threads);
+        std::vector<std::atomic<int>> hits(1000);
+        std::atomic<int> longestChunk{0};
+        pool.parallelFor(0, 1000, 7, [&](int begin, int end) {
+            longestChunk = std::max(longestChunk.load(), end - begin);
+            for (int i = begin; i < end; ++i)
+                hits[i].fetch_add(1);
+        });
+        CHECK(longestChunk.load() <= 7);
+        bool exactlyOnce = true;
+        for (auto &h : hits)
+            exactlyOnce = exactlyOnce && h.load() == 1;
+        CHECK(exactlyOnce);
+
+        int calls = 0;
+        pool.parallelFor(5, 5, 1, [&calls](int, int) { ++calls; });
+        CHECK(calls == 0);
+    }
+}
+
+TEST_CASE("Многопоточные фильтры - результат не зависит от числа потоков") {
+    Image source;
+    REQUIRE(loadImage(source));
+    int previous = getThreadCount();
+
+    setThreadCount(1);
+    CHECK(getThreadCount() == 1);
+    Image solar1 = source, wave1 = source, gray1 = source;
+    applySolarRays(solar1);
+    applyWaveDistortion(wave1, 12.0f);
+    applyGrayscale(gray1);
+
+    setThreadCount(4);
+    CHECK(getThreadCount() == 4);
+    Image solar4 = source, wave4 = source, gray4 = source;
+    applySolarRays(solar4);
+    applyWaveDistortion(wave4, 12.0f);
+    applyGrayscale(gray4);
+
+    CHECK(samePixels(solar1, solar4));
+    CHECK(samePixels(wave1, wave4));
+    CHECK(samePixels(gray1, gray4));
+
+    setThreadCount(previous);
+}
+
+TEST_CASE("philox4x32 - известные значения и построчное заполнение") {
+    CHECK(philox4x32({0, 0, 0, 0}, {0, 0}) == PhiloxCounter{0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u});
+    CHECK(philox4x32({0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}, {0xffffffffu, 0xffffffffu}) ==
+          PhiloxCounter{0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu});
+
+    std::vector<std::uint32_t> words(4 * 37);
+    philoxFillRow(99, 3, 5, 11, 37, words.data());
+    bool matches = true;
+    for (int i = 0; i < 37; ++i) {
+        PhiloxCounter expected = philoxAt(99, 3, 5 + i, 11);
+        for (int c = 0; c < 4; ++c)
+            matches = matches && words[4 * i + c] == expected[c];
+    }
+    CHECK(matches);
+
+    CHECK(philoxUniformInt(0, -250, 250) == -250);
+    CHECK(philoxUniformInt(0xffffffffu, -250, 250) == 250);
+}
+
+TEST_CASE("applyColorNoise/applyGlitch - воспроизводимость по зерну при любом числе потоков") {
+    Image source;
+    REQUIRE(loadImage(source));
+    int previous = getThreadCount();
+
+    setThreadCount(1);
+    Image noise1 = source, glitch1 = source;
+    applyColorNoise(noise1, 0.3f, 42);
+    applyGlitch(glitch1, 42);
+
+    setThreadCount(5);
+    Image noise5 = source, glitch5 = source, otherSeed = source;
+    applyColorNoise(noise5, 0.3f, 42);
+    applyGlitch(glitch5, 42);
+    applyColorNoise(otherSeed, 0.3f, 43);
+    setThreadCount(previous);
+
+    CHECK(samePixels(noise1, noise5));
+    CHECK(samePixels(glitch1, glitch5));
+    CHECK_FALSE(samePixels(noise5, otherSeed));
+}
+
+TEST_CASE("streamFilter - потоковая обработка совпадает с обработкой в памяти") {
+    std::string input = fs::exists("input.png") ? "input.png" : "../input.png";
+    Image source;
+    REQUIRE(source.load(input));
+
+    FilterParams params;
+    params.amplitude = 7.0f;
+    params.intensity = 0.4f;
+    params.seed = 7;
+    for (FilterType type : {FilterType::SolarRays, FilterType::WaveDistortion, FilterType::ColorNoise,
+                            FilterType::Glitch, FilterType::Grayscale}) {
+        Image expected = source;
+        applyFilter(expected, type, params);
+        REQUIRE(streamFilter(input, "streamed.png", type, params));
+        Image streamed;
+        REQUIRE(streamed.load("streamed.png"));
+        CHECK(samePixels(streamed, expected));
+    }
+
+    // Параметры записи применяются и в потоковом режиме.
+    SaveOptions stored;
+    stored.compressionLevel = 0;
+    stored.rowFilters = PNG_FILTER_NONE;
+    REQUIRE(streamFilter(input, "streamed_stored.png", FilterType::Grayscale, params, stored));
+    REQUIRE(streamFilter(input, "streamed_fast.png", FilterType::Grayscale, params, SaveOptions::fast()));
+    CHECK(fs::file_size("streamed_stored.png") > fs::file_size("streamed_fast.png"));
+    CHECK(fs::file_size("streamed_stored.png") >=
+          static_cast<std::uintmax_t>(source.getWidth()) * source.getHeight() * source.getBytesPerPixel());
+    Image grayExpected = source, storedImage, fastImage;
+    applyGrayscale(grayExpected);
+    REQUIRE(storedImage.load("streamed_stored.png"));
+    REQUIRE(fastImage.load("streamed_fast.png"));
+    CHECK(samePixels(storedImage, grayExpected));
+    CHECK(samePixels(fastImage, grayExpected));
+
+    // Формат файла сохраняется так же, как при загрузке в память: 16 бит не урезаются, серый не расширяется.
+    Image wide(73, 41, PixelFormat::G16);
+    for (int y = 0; y < wide.getHeight(); ++y) {
+        auto *samples = reinterpret_cast<std::uint16_t *>(wide.row(y));
+        for (int x = 0; x < wide.getWidth(); ++x)
+            samples[x] = static_cast<std::uint16_t>(x * 811 + y * 97);
+    }
+    REQUIRE(wide.save("stream_wide.png"));
+    for (const char *spec : {"solar,noise:0.3:seed=2,glitch:seed=5:block=4", "wave:6"}) {
+        FilterPipeline chain;
+        REQUIRE(FilterPipeline::parse(spec, chain));
+        Image expected = wide;
+        chain.apply(expected);
+        REQUIRE(streamFilter("stream_wide.png", "streamed_wide.png", chain));
+        Image streamed;
+        REQUIRE(streamed.load("streamed_wide.png"));
+        CHECK(streamed.getFormat() == PixelFormat::G16);
+        CHECK_MESSAGE(samePixels(streamed, expected), spec);
+    }
+
+    CHECK_FALSE(streamFilter("nonexistent.png", "streamed.png", FilterType::Grayscale));
+    CHECK_FALSE(streamFilter(input, "/nonexistent_directory/streamed.png", FilterType::Grayscale));
+}
+
+TEST_CASE("FilterPipeline - разбор описания цепочки") {
+    FilterPipeline pipeline;
+    REQUIRE(FilterPipeline::parse("grayscale, noise:0.3:seed=7,solar,wave:15,glitch", pipeline, 5));
+    REQUIRE(pipeline.stages().size() == 5);
+    CHECK(pipeline.stages()[1].type == FilterType::ColorNoise);
+    CHECK(pipeline.stages()[1].params.intensity == doctest::Approx(0.3f));
+    CHECK(pipeline.stages()[1].params.seed == 7);
+    CHECK(pipeline.stages()[3].params.amplitude == doctest::Approx(15.0f));
+    CHECK(pipeline.stages()[4].params.seed == 5);
+    CHECK(pipeline.passCount() == 3);
+    CHECK(pipeline.toString() == "grayscale,noise:0.3:seed=7,solar,wave:15,glitch:seed=5");
+
+    FilterPipeline reparsed;
+    REQUIRE(FilterPipeline::parse(pipeline.toString(), reparsed));
+    CHECK(reparsed.toString() == pipeline.toString());
+
+    FilterPipeline untouched;
+    CHECK_FALSE(FilterPipeline::parse("", untouched));
+    CHECK_FALSE(FilterPipeline::parse("blur", untouched));
+    CHECK_FALSE(FilterPipeline::parse("grayscale:3", untouched));
+    CHECK_FALSE(FilterPipeline::parse("wave:abc", untouched));
+    CHECK_FALSE(FilterPipeline::parse("solar,,gray", untouched));
+    CHECK(untouched.empty());
+}
+
+TEST_CASE("FilterPipeline::apply - объединённые проходы совпадают с последовательными фильтрами") {
+    Image source;
+    REQUIRE(loadImage(source));
+
+    FilterPipeline pipeline;
+    REQUIRE(FilterPipeline::parse("grayscale,noise:0.2:seed=3,solar,wave:9,glitch:seed=4,gray", pipeline));
+    Image fused = source;
+    pipeline.apply(fused);
+
+    Image sequential = source;
+    applyGrayscale(sequential);
+    applyColorNoise(sequential, 0.2f, 3);
+    applySolarRays(sequential);
+    applyWaveDistortion(sequential, 9.0f);
+    applyGlitch(sequential, 4);
+    applyGrayscale(sequential);
+    CHECK(samePixels(fused, sequential));
+
+    std::string input = fs::exists("input.png") ? "input.png" : "../input.png";
+    FilterPipeline rowLocal;
+    REQUIRE(FilterPipeline::parse("solar,noise:0.2:seed=3,glitch", rowLocal));
+    Image expected = source;
+    rowLocal.apply(expected);
+    REQUIRE(streamFilter(input, "streamed_chain.png", rowLocal));
+    Image streamed;
+    REQUIRE(streamed.load("streamed_chain.png"));
+    CHECK(samePixels(streamed, expected));
+}
+
+TEST_CASE("runBatch - пакетная обработка каталога и списка файлов") {
+    Image source;
+    REQUIRE(loadImage(source));
+    fs::remove_all("batch_in");
+    fs::remove_all("batch_out");
+    fs::create_directories("batch_in");
+    for (const char *name : {"a.png", "b.png", "c.png"})
+        REQUIRE(source.save(std::string("batch_in/") + name));
+    std::ofstream("batch_in/notes.txt") << "not an image";
+
+    BatchOptions options;
+    REQUIRE(collectInputs("batch_in", options.inputs));
+    REQUIRE(options.inputs.size() == 3);
+    CHECK(fs::path(options.inputs[0]).filename() == "a.png");
+    options.outputDir = "batch_out";
+    options.jobs = 2;
+    options.queueDepth = 1;
+    REQUIRE(FilterPipeline::parse("gray,noise:0.2:seed=1", options.pipeline));
+
+    BatchResult result = runBatch(options);
+    CHECK(result.processed == 3);
+    CHECK(result.failed == 0);
+    CHECK(result.megapixels == doctest::Approx(3.0 * source.getWidth() * source.getHeight() / 1e6));
+
+    Image expected = source;
+    options.pipeline.apply(expected);
+    Image produced;
+    REQUIRE(produced.load("batch_out/b.png"));
+    CHECK(samePixels(produced, expected));
+
+    std::ofstream("batch_list.txt") << "batch_in/a.png\n\nbatch_in/missing.png\n";
+    BatchOptions fromList;
+    REQUIRE(collectInputs("batch_list.txt", fromList.inputs));
+    CHECK(fromList.inputs.size() == 2);
+    fromList.outputDir = "batch_out";
+    fromList.pipeline = options.pipeline;
+    BatchResult partial = runBatch(fromList);
+    CHECK(partial.processed == 1);
+    CHECK(partial.failed == 1);
+
+    // Одинаковые имена из разных каталогов дали бы один путь результата.
+    fs::remove_all("batch_dup_out");
+    fs::create_directories("batch_in/a");
+    fs::create_directories("batch_in/b");
+    REQUIRE(source.save("batch_in/a/x.png"));
+    REQUIRE(source.save("batch_in/b/x.png"));
+    BatchOptions duplicates;
+    duplicates.inputs = {"batch_in/a/x.png", "batch_in/b/x.png", "batch_in/c.png"};
+    duplicates.outputDir = "batch_dup_out";
+    duplicates.jobs = 2;
+    duplicates.pipeline = options.pipeline;
+    BatchResult clashing = runBatch(duplicates);
+    CHECK(clashing.processed == 1);
+    CHECK(clashing.failed == 2);
+    CHECK_FALSE(fs::exists("batch_dup_out/x.png"));
+    CHECK(fs::exists("batch_dup_out/c.png"));
+
+    std::vector<std::string> none;
+    CHECK_FALSE(collectInputs("nonexistent_list.txt", none));
+}
+
+TEST_CASE("SolarRaysField - таблица совпадает с тригонометрическим расчётом и кешируется") {
+    const int width = 301, height = 157;
+    SolarRaysField field(width, height);
+    int centerX = width / 2, centerY = height / 2;
+    float maxDist = std::sqrt(centerX * centerX + centerY * centerY);
+    int maxError = 0, mismatches = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float dx = x - centerX, dy = y - centerY;
+            float dist = std::sqrt(dx * dx + dy * dy);
+            float intensity = std::max(0.0f, std::sin(std::atan2(dy, dx) * 10) * (1.0f - dist / maxDist)) * 100;
+            int error = std::abs(field.row(y)[x] - static_cast<int>(intensity));
+            maxError = std::max(maxError, error);
+            mismatches += error != 0;
+        }
+    }
+    CHECK(maxError <= 1);
+    CHECK(mismatches * 1000 < width * height);
+
+    clearGeometryCache();
+    auto first = cachedSolarRaysField(width, height);
+    auto second = cachedSolarRaysField(width, height);
+    REQUIRE(first);
+    CHECK(first == second);
+    CHECK(geometryCacheBytes() == static_cast<std::size_t>(width) * height);
+    setGeometryCacheLimit(1000);
+    CHECK(geometryCacheBytes() == 0);
+    CHECK_FALSE(cachedSolarRaysField(width, height));
+    setGeometryCacheLimit(256 * 1024 * 1024);
+
+    Image cached(width, height), uncached(width, height);
+    forEachPixel(cached, [](Pixel &p, int x, int y) { p = Pixel{static_cast<std::uint8_t>(x), static_cast<std::uint8_t>(y), 200, 9}; });
+    uncached = cached;
+    applySolarRays(cached);
+    SolarRaysKernel kernel(width, height, false);
+    CHECK_FALSE(kernel.field);
+    transformRows(uncached, kernel);
+    CHECK(samePixels(cached, uncached));
+    CHECK(cached.pixelAt(0, 0)[3] == 9);
+}
+
+TEST_CASE("addSaturatedRow - SIMD-реализации совпадают со скалярной") {
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<Pixel> source(203);
+    std::vector<std::uint8_t> add(source.size());
+    for (std::size_t i = 0; i < source.size(); ++i) {
+        for (auto &c : source[i])
+            c = static_cast<std::uint8_t>(byte(gen));
+        add[i] = static_cast<std::uint8_t>(byte(gen) % 101);
+    }
+    std::vector<Pixel> scalar = source;
+    addSaturatedRow(SimdLevel::Scalar, scalar.data(), add.data(), scalar.size());
+    CHECK(scalar[5][0] == std::min(255, source[5][0] + add[5]));
+    CHECK(scalar[5][3] == source[5][3]);
+    for (SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+        std::vector<Pixel> vectorized = source;
+        addSaturatedRow(level, vectorized.data(), add.data(), vectorized.size());
+        CHECK(vectorized == scalar);
+    }
+}
+
+TEST_CASE("applyWaveDistortion - обработка на месте совпадает с прямым расчётом при любом числе полос") {
+    Image source(53, 41);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x * 5), static_cast<std::uint8_t>(y * 6), static_cast<std::uint8_t>(x ^ y), 255};
+    });
+    int previous = getThreadCount();
+    for (float amplitude : {0.0f, 3.0f, 17.5f, -30.0f}) {
+        Image expected(source.getWidth(), source.getHeight());
+        for (int y = 0; y < source.getHeight(); y++) {
+            for (int x = 0; x < source.getWidth(); x++) {
+                float offsetX = amplitude * std::sin(2 * M_PI * y / 128.0f);
+                float offsetY = amplitude * std::cos(2 * M_PI * x / 128.0f);
+                expected.setPixel(x, y, source.getPixel(x + static_cast<int>(offsetX), y + static_cast<int>(offsetY)));
+            }
+        }
+        for (int threads : {1, 3, 7}) {
+            setThreadCount(threads);
+            Image img = source;
+            applyWaveDistortion(img, amplitude);
+            CHECK(samePixels(img, expected));
+        }
+    }
+    setThreadCount(previous);
+
+    Image empty;
+    applyWaveDistortion(empty, 10.0f);
+    CHECK(empty.getWidth() == 0);
+}
+
+TEST_CASE("applyGlitch - строки сдвигаются циклически, блочный режим воспроизводим") {
+    Image source(37, 61);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x * 7), static_cast<std::uint8_t>(220 + y % 30), static_cast<std::uint8_t>(y * 3), 255};
+    });
+
+    Image img = source;
+    applyGlitch(img, 11);
+    bool rowsOk = true;
+    for (int y = 0; y < img.getHeight(); ++y) {
+        std::uint8_t boostR = y % 10 == 0 && y % 20 == 0 ? 50 : 0;
+        std::uint8_t boostG = y % 10 == 0 && y % 20 != 0 && y % 15 == 0 ? 50 : 0;
+        int shift = y % 10 == 0 ? -1 : 0;
+        for (int candidate = 0; shift < 0 && candidate <= 20; ++candidate) {
+            bool match = true;
+            for (int x = 0; x < img.getWidth() && match; ++x) {
+                Pixel expected = source.pixelAt((x - candidate + img.getWidth()) % img.getWidth(), y);
+                expected[0] = static_cast<std::uint8_t>(std::min(255, expected[0] + boostR));
+                expected[1] = static_cast<std::uint8_t>(std::min(255, expected[1] + boostG));
+                match = img.pixelAt(x, y) == expected;
+            }
+            if (match)
+                shift = candidate;
+        }
+        for (int x = 0; x < img.getWidth() && shift == 0 && y % 10 != 0; ++x)
+            rowsOk = rowsOk && img.pixelAt(x, y) == source.pixelAt(x, y);
+        rowsOk = rowsOk && shift >= 0;
+    }
+    CHECK(rowsOk);
+
+    GlitchOptions options;
+    options.blockHeight = 8;
+    options.blockChance = 0.5f;
+    options.channelOffset = 5;
+    int previous = getThreadCount();
+    setThreadCount(1);
+    Image expected = source;
+    applyGlitch(expected, 3, options);
+    CHECK_FALSE(samePixels(expected, source));
+    for (int threads : {2, 5}) {
+        setThreadCount(threads);
+        Image other = source;
+        applyGlitch(other, 3, options);
+        CHECK(samePixels(other, expected));
+    }
+    setThreadCount(previous);
+
+    FilterPipeline pipeline;
+    REQUIRE(FilterPipeline::parse("glitch:seed=3:step=10:block=8:chance=0.5:offset=5", pipeline));
+    CHECK(pipeline.toString() == "glitch:seed=3:block=8:chance=0.5:offset=5");
+    Image piped = source;
+    pipeline.apply(piped);
+    CHECK(samePixels(piped, expected));
+}
+
+TEST_CASE("addConstantSaturatedRow - SIMD-реализации совпадают со скалярной") {
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<Pixel> source(131);
+    for (auto &p : source)
+        for (auto &c : p)
+            c = static_cast<std::uint8_t>(byte(gen));
+    Pixel addend{200, 0, 17, 0};
+    std::vector<Pixel> scalar = source;
+    addConstantSaturatedRow(SimdLevel::Scalar, scalar.data(), scalar.size(), addend);
+    CHECK(scalar[3][0] == std::min(255, source[3][0] + 200));
+    CHECK(scalar[3][1] == source[3][1]);
+    for (SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+        std::vector<Pixel> vectorized = source;
+        addConstantSaturatedRow(level, vectorized.data(), vectorized.size(), addend);
+        CHECK(vectorized == scalar);
+    }
+}
+
+TEST_CASE("statsSnapshot - счётчики этапов загрузки, фильтров и сохранения") {
+    resetStats();
+    Image img;
+    REQUIRE(loadImage(img));
+    applyGrayscale(img);
+    applyGrayscale(img);
+    fs::path output = fs::temp_directory_path() / "image_filters_stats.png";
+    REQUIRE(img.save(output.string()));
+    fs::remove(output);
+
+    std::vector<StatValues> values = statsSnapshot();
+    if (!statsEnabled()) {
+        CHECK(values.empty());
+        return;
+    }
+    auto find = [&values](const std::string &name) {
+        auto it = std::find_if(values.begin(), values.end(), [&name](const StatValues &v) { return v.name == name; });
+        REQUIRE(it != values.end());
+        return *it;
+    };
+    std::uint64_t pixels = static_cast<std::uint64_t>(img.getWidth()) * img.getHeight();
+    CHECK(find("load").calls >= 1);
+    CHECK(find("load").bytesIn > 0);
+    CHECK(find("load").bytesOut == pixels * img.getBytesPerPixel());
+    CHECK(find("load.decode").nanoseconds <= find("load").nanoseconds);
+    CHECK(find("filter.grayscale").calls == 2);
+    CHECK(find("filter.grayscale").pixels == 2 * pixels);
+    CHECK(find("save").bytesIn == pixels * img.getBytesPerPixel());
+    CHECK(find("save").bytesOut > 0);
+    CHECK(find("image.allocate").allocations >= 1);
+
+    resetStats();
+    values = statsSnapshot();
+    CHECK(find("filter.grayscale").calls == 0);
+}
+
+TEST_CASE("Image::save - параметры сжатия и параллельная запись читаются libpng") {
+    Image source(301, 257);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x * y), static_cast<std::uint8_t>(x >> 2), static_cast<std::uint8_t>(y * 3),
+                  static_cast<std::uint8_t>(255 - x % 7)};
+    });
+    fs::path output = fs::temp_directory_path() / "image_filters_save.png";
+
+    SaveOptions options;
+    options.parallel = true;
+    for (int filters : {PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH, PNG_ALL_FILTERS}) {
+        for (int level : {0, 1, 9}) {
+            options.rowFilters = filters;
+            options.compressionLevel = level;
+            REQUIRE(source.save(output.string(), options));
+            Image loaded;
+            REQUIRE(loaded.load(output.string()));
+            CHECK(samePixels(loaded, source));
+        }
+    }
+
+    Image tall(3, 40000);
+    forEachPixel(tall, [](Pixel &p, int x, int y) { p = Pixel{static_cast<std::uint8_t>(y), static_cast<std::uint8_t>(x), 7, 255}; });
+    auto readFile = [](const fs::path &path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    int previous = getThreadCount();
+    setThreadCount(1);
+    REQUIRE(tall.save(output.string(), SaveOptions::fast()));
+    std::vector<char> serial = readFile(output);
+    setThreadCount(4);
+    REQUIRE(tall.save(output.string(), SaveOptions::fast()));
+    CHECK(readFile(output) == serial);
+    setThreadCount(previous);
+    Image loaded;
+    REQUIRE(loaded.load(output.string()));
+    CHECK(samePixels(loaded, tall));
+
+    // Потоковая обработка читает файл до IEND и проверяет все контрольные суммы.
+    fs::path filtered = fs::temp_directory_path() / "image_filters_save_gray.png";
+    CHECK(streamFilter(output.string(), filtered.string(), FilterType::Grayscale, FilterParams{}));
+    fs::remove(filtered);
+
+    options = SaveOptions{};
+    options.compressionLevel = 1;
+    options.strategy = ZlibStrategy::HuffmanOnly;
+    options.rowFilters = PNG_FILTER_SUB;
+    REQUIRE(source.save(output.string(), options));
+    REQUIRE(loaded.load(output.string()));
+    CHECK(samePixels(loaded, source));
+    fs::remove(output);
+}
+
+TEST_CASE("Image::loadFromMemory/saveToBuffer - работа без временных файлов") {
+    Image source(640, 480);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        std::uint32_t h = static_cast<std::uint32_t>(x * 2654435761u ^ y * 2246822519u);
+        p = Pixel{static_cast<std::uint8_t>(h), static_cast<std::uint8_t>(h >> 8), static_cast<std::uint8_t>(y), 255};
+    });
+
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(source.saveToBuffer(encoded));
+    REQUIRE(encoded.size() > 64 * 1024);
+    Image loaded;
+    REQUIRE(loaded.loadFromMemory(Span<const std::uint8_t>(encoded.data(), encoded.size())));
+    CHECK(samePixels(loaded, source));
+
+    // Файл больше порога читается через mmap и должен совпадать с буфером.
+    fs::path output = fs::temp_directory_path() / "image_filters_memory.png";
+    REQUIRE(source.save(output.string()));
+    std::ifstream in(output, std::ios::binary);
+    std::vector<std::uint8_t> fromFile((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(fromFile == encoded);
+    Image mapped;
+    REQUIRE(mapped.load(output.string()));
+    CHECK(samePixels(mapped, source));
+    fs::remove(output);
+
+    std::vector<std::uint8_t> fast;
+    REQUIRE(source.saveToBuffer(fast, SaveOptions::fast()));
+    REQUIRE(loaded.loadFromMemory(Span<const std::uint8_t>(fast.data(), fast.size())));
+    CHECK(samePixels(loaded, source));
+
+    CHECK_FALSE(loaded.loadFromMemory(Span<const std::uint8_t>(encoded.data(), encoded.size() / 2)));
+    CHECK(loaded.getWidth() == 0);
+    CHECK_FALSE(loaded.loadFromMemory(Span<const std::uint8_t>()));
+}
+
+TEST_CASE("PixelFormat - загрузка сохраняет формат и глубину, фильтры работают в каждом формате") {
+    Image wide(97, 33, PixelFormat::G16);
+    REQUIRE(wide.getBytesPerPixel() == 2);
+    for (int y = 0; y < wide.getHeight(); ++y) {
+        auto *samples = reinterpret_cast<std::uint16_t *>(wide.row(y));
+        for (int x = 0; x < wide.getWidth(); ++x)
+            samples[x] = static_cast<std::uint16_t>(x * 613 + y * 37);
+    }
+    fs::path output = fs::temp_directory_path() / "image_filters_format.png";
+    for (bool parallel : {false, true}) {
+        SaveOptions options;
+        options.parallel = parallel;
+        REQUIRE(wide.save(output.string(), options));
+        Image loaded;
+        REQUIRE(loaded.load(output.string()));
+        CHECK(loaded.getFormat() == PixelFormat::G16);
+        CHECK(samePixels(loaded, wide));
+    }
+
+    Image rgba;
+    REQUIRE(rgba.load(output.string(), PixelFormat::RGBA8));
+    CHECK(rgba.getPixel(5, 2) == std::vector<unsigned char>{static_cast<unsigned char>((5 * 613 + 2 * 37) >> 8),
+                                                            static_cast<unsigned char>((5 * 613 + 2 * 37) >> 8),
+                                                            static_cast<unsigned char>((5 * 613 + 2 * 37) >> 8), 255});
+
+    for (PixelFormat format : {PixelFormat::G8, PixelFormat::GA8, PixelFormat::RGB8, PixelFormat::RGBA16}) {
+        Image converted = rgba.convertTo(format);
+        CHECK(converted.getFormat() == format);
+        CHECK(converted.getPixel(5, 2) == rgba.getPixel(5, 2));
+        REQUIRE(converted.save(output.string()));
+        Image loaded;
+        REQUIRE(loaded.load(output.string()));
+        CHECK(samePixels(loaded, converted));
+    }
+    fs::remove(output);
+
+    Image gray = wide;
+    applyGrayscale(gray);
+    CHECK(samePixels(gray, wide));
+    applySolarRays(gray);
+    CHECK_FALSE(samePixels(gray, wide));
+    CHECK(gray.getFormat() == PixelFormat::G16);
+
+    Image color(64, 48);
+    forEachPixel(color, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x * 3), static_cast<std::uint8_t>(y * 5), static_cast<std::uint8_t>(x ^ y), 255};
+    });
+    FilterPipeline pipeline;
+    REQUIRE(FilterPipeline::parse("solar,noise:0.2:seed=3,wave:5,glitch:seed=4:block=8:offset=3", pipeline));
+    Image expected = color;
+    pipeline.apply(expected);
+    Image native = color.convertTo(PixelFormat::RGB8);
+    pipeline.apply(native);
+    CHECK(native.getFormat() == PixelFormat::RGB8);
+    CHECK(samePixels(native.convertTo(PixelFormat::RGBA8), expected));
+
+    // Построчные фильтры объединяются в один проход в любом формате, а не только в RGBA8.
+    FilterPipeline rowLocal;
+    REQUIRE(FilterPipeline::parse("solar,noise:0.2:seed=3,glitch:seed=4:block=8,gray", rowLocal));
+    const Region area{7, 5, 40, 30};
+    for (PixelFormat format : {PixelFormat::G8, PixelFormat::GA8, PixelFormat::RGB8, PixelFormat::G16,
+                               PixelFormat::RGBA16}) {
+        Image fused = color.convertTo(format), sequential = fused;
+        rowLocal.apply(fused, area);
+        for (const FilterStage &stage : rowLocal.stages())
+            applyFilter(sequential, stage.type, stage.params, area);
+        CHECK_MESSAGE(samePixels(fused, sequential), pixelFormatName(format));
+    }
+
+    PixelFormat parsed;
+    CHECK(parsePixelFormat(pixelFormatName(PixelFormat::GA8), parsed));
+    CHECK(parsed == PixelFormat::GA8);
+    CHECK_FALSE(parsePixelFormat("cmyk", parsed));
+}
+
+TEST_CASE("Region - фильтры области и загрузка с обрезкой") {
+    Image source(200, 150);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        std::uint32_t h = static_cast<std::uint32_t>(x * 2654435761u ^ y * 2246822519u);
+        p = Pixel{static_cast<std::uint8_t>(h), static_cast<std::uint8_t>(h >> 8), static_cast<std::uint8_t>(x + y),
+                  static_cast<std::uint8_t>(h >> 16 | 128)};
+    });
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(source.saveToBuffer(encoded));
+    Span<const std::uint8_t> data(encoded.data(), encoded.size());
+
+    Region region{30, 40, 90, 50};
+    LoadOptions options;
+    options.crop = region;
+    Image crop;
+    REQUIRE(crop.loadFromMemory(data, options));
+    CHECK(samePixels(crop, source.cropped(region)));
+    options.format = PixelFormat::RGB8;
+    REQUIRE(crop.loadFromMemory(data, options));
+    CHECK(samePixels(crop, source.cropped(region).convertTo(PixelFormat::RGB8)));
+
+    options = LoadOptions{};
+    options.crop = Region{150, 100, 500, 500};
+    REQUIRE(crop.loadFromMemory(data, options));
+    CHECK(crop.getWidth() == 50);
+    CHECK(crop.getHeight() == 50);
+    options.crop = Region{250, 0, 10, 10};
+    CHECK_FALSE(crop.loadFromMemory(data, options));
+
+    // Строки ниже области не читаются, поэтому обрезанный конец файла не мешает.
+    Span<const std::uint8_t> head(encoded.data(), encoded.size() / 2);
+    CHECK_FALSE(crop.loadFromMemory(head));
+    options.crop = Region{0, 0, 200, 10};
+    REQUIRE(crop.loadFromMemory(head, options));
+    CHECK(samePixels(crop, source.cropped(*options.crop)));
+
+    FilterPipeline pipeline;
+    REQUIRE(FilterPipeline::parse("solar,noise:0.2:seed=3,wave:5,glitch:seed=4:block=8:offset=3", pipeline));
+    for (PixelFormat format : {PixelFormat::RGBA8, PixelFormat::RGB8}) {
+        Image original = source.convertTo(format);
+        Image expected = original.cropped(region);
+        pipeline.apply(expected);
+        Image img = original;
+        pipeline.apply(img, region);
+        CHECK(samePixels(img.cropped(region), expected));
+        bool outsideUnchanged = true;
+        for (int y = 0; y < img.getHeight(); ++y)
+            for (int x = 0; x < img.getWidth(); ++x)
+                if ((x < region.x || x >= region.x + region.width || y < region.y || y >= region.y + region.height) &&
+                    img.getPixel(x, y) != original.getPixel(x, y))
+                    outsideUnchanged = false;
+        CHECK(outsideUnchanged);
+    }
+
+    Image whole = source;
+    applyGrayscale(whole, Region{-10, -10, 1000, 1000});
+    Image gray = source;
+    applyGrayscale(gray);
+    CHECK(samePixels(whole, gray));
+    applySolarRays(whole, Region{0, 0, 0, 10});
+    CHECK(samePixels(whole, gray));
+}
+
+TEST_CASE("SaveOptions::reduceFormat - наименьший тип цвета без потерь") {
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<Pixel> row(77);
+    for (Pixel &p : row) {
+        auto v = static_cast<std::uint8_t>(byte(gen));
+        p = Pixel{v, v, v, 255};
+    }
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2}) {
+        ColorUsage usage;
+        scanColorUsage(level, row.data(), row.size(), usage);
+        CHECK((usage.gray && usage.opaque));
+        std::vector<Pixel> changed = row;
+        changed[70][1] ^= 1;
+        changed[3][3] = 254;
+        usage = ColorUsage{};
+        scanColorUsage(level, changed.data(), changed.size(), usage);
+        CHECK_FALSE(usage.gray);
+        CHECK_FALSE(usage.opaque);
+    }
+
+    Image gray(120, 90);
+    forEachPixel(gray, [](Pixel &p, int x, int y) {
+        auto v = static_cast<std::uint8_t>(x * 2 + y);
+        p = Pixel{v, v, v, 255};
+    });
+    Image translucent = gray;
+    translucent.pixelAt(4, 4)[3] = 10;
+    Image colored = gray;
+    forEachPixel(colored, [](Pixel &p, int x, int) { p[0] = static_cast<std::uint8_t>(x * 40); });
+    Image few(120, 90);
+    forEachPixel(few, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x % 5 * 50), static_cast<std::uint8_t>(y % 3 * 90), 9,
+                  static_cast<std::uint8_t>(x % 7 == 0 ? 128 : 255)};
+    });
+
+    struct Case {
+        const Image *image;
+        PixelFormat loaded;
+    };
+    fs::path output = fs::temp_directory_path() / "image_filters_reduce.png";
+    for (bool parallel : {false, true}) {
+        SaveOptions options;
+        options.parallel = parallel;
+        options.reduceFormat = true;
+        for (Case c : {Case{&gray, PixelFormat::G8}, Case{&translucent, PixelFormat::GA8},
+                       Case{&colored, PixelFormat::RGB8}, Case{&few, PixelFormat::RGBA8}}) {
+            REQUIRE(c.image->save(output.string(), options));
+            std::uintmax_t reducedSize = fs::file_size(output);
+            Image loaded;
+            REQUIRE(loaded.load(output.string()));
+            CHECK(loaded.getFormat() == c.loaded);
+            CHECK(samePixels(loaded.convertTo(PixelFormat::RGBA8), *c.image));
+
+            SaveOptions plain = options;
+            plain.reduceFormat = false;
+            REQUIRE(c.image->save(output.string(), plain));
+            CHECK(reducedSize < fs::file_size(output));
+        }
+    }
+    fs::remove(output);
+
+    Image reduced;
+    std::vector<Pixel> palette;
+    REQUIRE(reduceForPng(few, reduced, palette));
+    CHECK(reduced.getFormat() == PixelFormat::G8);
+    CHECK(palette.size() == 30);
+    CHECK(paletteAlphaCount(palette) == 15);
+    CHECK(palette[reduced.row(2)[14]] == few.pixelAt(14, 2));
+    CHECK_FALSE(reduceForPng(reduced, reduced, palette));
+    CHECK(palette.empty());
+}
+
+TEST_CASE("TiledImage - обработка плитками совпадает с обработкой в памяти") {
+    Image source(83, 150);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x * 3), static_cast<std::uint8_t>(y * 5), static_cast<std::uint8_t>(x ^ y),
+                  static_cast<std::uint8_t>(255 - y % 4)};
+    });
+    FilterPipeline pipeline;
+    REQUIRE(FilterPipeline::parse("solar,noise:0.2:seed=3,wave:12,glitch:seed=4:block=8:offset=3,gray", pipeline));
+    Image expected = source;
+    pipeline.apply(expected);
+
+    TiledOptions options;
+    options.tileRows = 7;
+    options.maxResidentTiles = 3;
+    TiledImage tiled(options);
+    REQUIRE(tiled.copyFrom(source));
+    CHECK(tiled.tileCount() == 22);
+    CHECK(tiled.getStride() % Image::kRowAlignment == 0);
+    CHECK(samePixels(tiled.readRows(0, tiled.getHeight()), source));
+    applyPipeline(tiled, pipeline);
+    CHECK(samePixels(tiled.readRows(0, tiled.getHeight()), expected));
+
+    Image wave = source;
+    applyWaveDistortion(wave, -9.0f);
+    REQUIRE(tiled.copyFrom(source));
+    applyWaveDistortion(tiled, -9.0f);
+    CHECK(samePixels(tiled.readRows(0, tiled.getHeight()), wave));
+    CHECK(tiled.readRows(140, 200).getHeight() == 10);
+
+    fs::path output = fs::temp_directory_path() / "image_filters_tiled.png";
+    Image gray = source.convertTo(PixelFormat::G16);
+    REQUIRE(gray.save(output.string()));
+    TiledImage loaded(options);
+    REQUIRE(loaded.load(output.string()));
+    CHECK(loaded.getFormat() == PixelFormat::G16);
+    applySolarRays(loaded);
+    applySolarRays(gray);
+    CHECK(samePixels(loaded.readRows(0, loaded.getHeight()), gray));
+    REQUIRE(loaded.save(output.string()));
+    Image saved;
+    REQUIRE(saved.load(output.string()));
+    CHECK(samePixels(saved, gray));
+    fs::remove(output);
+
+    TiledImage moved = std::move(loaded);
+    CHECK(moved.getWidth() == 83);
+    CHECK(loaded.getWidth() == 0);
+    CHECK_FALSE(loaded.save(output.string()));
+    CHECK_FALSE(moved.load("nonexistent.png"));
+}
+
+TEST_CASE("BufferPool - повторное использование блоков и обработка без новых выделений") {
+    BufferPool &pool = BufferPool::shared();
+    void *block = pool.allocate(1000);
+    REQUIRE(block != nullptr);
+    CHECK(reinterpret_cast<std::uintptr_t>(block) % BufferPool::kAlignment == 0);
+    pool.deallocate(block, 1000);
+    pool.resetStats();
+    void *again = pool.allocate(1010);
+    CHECK(again == block);
+    CHECK(pool.stats().hits == 1);
+    pool.deallocate(again, 1010);
+
+    void *c = poolMalloc(100);
+    REQUIRE(c != nullptr);
+    std::memset(c, 0xAB, 100);
+    poolFree(c);
+
+    Image source(256, 192);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x), static_cast<std::uint8_t>(y), static_cast<std::uint8_t>(x * y), 255};
+    });
+    std::vector<std::uint8_t> png;
+    REQUIRE(source.saveToBuffer(png));
+    FilterPipeline pipeline;
+    REQUIRE(FilterPipeline::parse("solar,wave:6,noise:0.1,glitch", pipeline));
+    std::vector<std::uint8_t> out;
+    auto process = [&](const SaveOptions &options) {
+        Image img;
+        REQUIRE(img.loadFromMemory(Span<const std::uint8_t>(png.data(), png.size()), PixelFormat::RGBA8));
+        pipeline.apply(img);
+        REQUIRE(img.saveToBuffer(out, options));
+    };
+    SaveOptions parallel = SaveOptions::fast();
+    for (int i = 0; i < 20; ++i) {
+        process(SaveOptions{});
+        process(parallel);
+    }
+    pool.resetStats();
+    BufferPoolStats warm = pool.stats();
+    for (int i = 0; i < 5; ++i) {
+        process(SaveOptions{});
+        process(parallel);
+    }
+    BufferPoolStats steady = pool.stats();
+    CHECK(steady.requests > 0);
+    CHECK(steady.hits == steady.requests);
+    CHECK(steady.hitRate() == 1.0);
+    CHECK(steady.highWater == warm.highWater);
+
+    pool.trim();
+    CHECK(pool.stats().cached <= BufferPool::kThreadCacheMaxBytes * 64);
+    // Ошибка в данных (longjmp из libpng) не должна оставлять выданных блоков пула.
+    Image noisy(512, 512);
+    forEachPixel(noisy, [](Pixel &p, int x, int y) {
+        std::uint32_t h = static_cast<std::uint32_t>(x * 2654435761u ^ y * 2246822519u);
+        p = Pixel{static_cast<std::uint8_t>(h), static_cast<std::uint8_t>(h >> 8), static_cast<std::uint8_t>(h >> 16), 255};
+    });
+    std::vector<std::uint8_t> truncated;
+    REQUIRE(noisy.saveToBuffer(truncated));
+    truncated.resize(truncated.size() / 2);
+    Span<const std::uint8_t> corrupt(truncated.data(), truncated.size());
+    LoadOptions cropped;
+    cropped.crop = Region{16, 16, 200, 400};
+    auto decodeCorrupt = [&] {
+        Image img;
+        CHECK_FALSE(img.loadFromMemory(corrupt));
+        CHECK_FALSE(img.loadFromMemory(corrupt, PixelFormat::RGBA8));
+        CHECK_FALSE(img.loadFromMemory(corrupt, cropped));
+    };
+    decodeCorrupt();
+    std::size_t inUse = pool.stats().inUse;
+    for (int i = 0; i < 10; ++i)
+        decodeCorrupt();
+    CHECK(pool.stats().inUse == inUse);
+}
+
+TEST_CASE("ResultCache - ключ, попадания, вытеснение и пакетная обработка из кеша") {
+    Image source(64, 48);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x * 3), static_cast<std::uint8_t>(y * 5), static_cast<std::uint8_t>(x + y), 255};
+    });
+    std::vector<std::uint8_t> png;
+    REQUIRE(source.saveToBuffer(png));
+    Span<const std::uint8_t> input(png.data(), png.size());
+
+    FilterPipeline gray, noise1, noise2, wave;
+    REQUIRE(FilterPipeline::parse("gray", gray));
+    REQUIRE(FilterPipeline::parse("noise:0.3:seed=1", noise1));
+    REQUIRE(FilterPipeline::parse("noise:0.3:seed=2", noise2));
+    REQUIRE(FilterPipeline::parse("wave:10", wave));
+    SaveOptions save;
+    std::string key = ResultCache::makeKey(input, gray, save);
+    CHECK(key.size() == 32);
+    CHECK(key == ResultCache::makeKey(input, gray, save));
+    CHECK(key != ResultCache::makeKey(input, wave, save));
+    CHECK(ResultCache::makeKey(input, noise1, save) != ResultCache::makeKey(input, noise2, save));
+    CHECK(key != ResultCache::makeKey(input, gray, SaveOptions::fast()));
+    CHECK(key != ResultCache::makeKey(input, gray, save, {}, Region{0, 0, 8, 8}));
+    CHECK(key != ResultCache::makeKey(Span<const std::uint8_t>(png.data(), png.size() - 1), gray, save));
+
+    fs::remove_all("cache_dir");
+    ResultCacheOptions options;
+    options.directory = "cache_dir";
+    options.maxBytes = png.size() * 2 + png.size() / 2;
+    std::vector<std::uint8_t> stored;
+    {
+        ResultCache cache(options);
+        REQUIRE(cache.isOpen());
+        CHECK_FALSE(cache.lookup(key, stored));
+        CHECK(cache.store(key, input));
+        REQUIRE(cache.lookup(key, stored));
+        CHECK(stored == png);
+        std::string second = ResultCache::makeKey(input, wave, save);
+        std::string third = ResultCache::makeKey(input, noise1, save);
+        CHECK(cache.store(second, input));
+        CHECK(cache.lookup(key, stored));
+        CHECK(cache.store(third, input));
+        CHECK(cache.lookup(key, stored));
+        CHECK_FALSE(cache.lookup(second, stored));
+        ResultCacheStats counters = cache.stats();
+        CHECK(counters.evictions == 1);
+        CHECK(counters.entries == 2);
+        CHECK(counters.bytes <= options.maxBytes);
+        std::vector<std::uint8_t> huge(options.maxBytes + 1);
+        CHECK_FALSE(cache.store(key, Span<const std::uint8_t>(huge.data(), huge.size())));
+    }
+    ResultCache reopened(options);
+    CHECK(reopened.stats().entries == 2);
+    CHECK(reopened.lookup(key, stored));
+    for (const fs::directory_entry &entry : fs::directory_iterator("cache_dir"))
+        CHECK(entry.path().extension() == ".png");
+
+    fs::remove_all("cache_in");
+    fs::remove_all("cache_out");
+    fs::remove_all("cache_batch");
+    ResultCache batchCache(ResultCacheOptions{"cache_batch"});
+    fs::create_directories("cache_in");
+    REQUIRE(source.save("cache_in/a.png"));
+    BatchOptions batch;
+    REQUIRE(collectInputs("cache_in", batch.inputs));
+    batch.outputDir = "cache_out";
+    REQUIRE(FilterPipeline::parse("gray,noise:0.2:seed=3", batch.pipeline));
+    batch.cache = &batchCache;
+    CHECK(runBatch(batch).processed == 1);
+    fs::remove("cache_out/a.png");
+    CHECK(runBatch(batch).processed == 1);
+    CHECK(batchCache.stats().hits == 1);
+    CHECK(batchCache.stats().stores == 1);
+    Image expected;
+    REQUIRE(expected.load("cache_in/a.png"));
+    batch.pipeline.apply(expected);
+    Image produced;
+    REQUIRE(produced.load("cache_out/a.png"));
+    CHECK(samePixels(produced, expected));
+}
+
+TEST_CASE("deinterleaveRow/interleaveRow и ядра плоскостей - SIMD-реализации совпадают со скалярной") {
+    std::mt19937 gen(23);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<Pixel> source(1029);
+    for (Pixel &p : source)
+        for (auto &c : p)
+            c = static_cast<std::uint8_t>(byte(gen));
+    std::size_t count = source.size();
+    std::vector<std::uint8_t> add(count);
+    for (auto &a : add)
+        a = static_cast<std::uint8_t>(byte(gen));
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2}) {
+        std::vector<std::uint8_t> storage(4 * count);
+        std::uint8_t *planes[4] = {&storage[0], &storage[count], &storage[2 * count], &storage[3 * count]};
+        deinterleaveRow(level, source.data(), count, planes);
+        bool split = true;
+        for (std::size_t i = 0; i < count; ++i)
+            for (int c = 0; c < 4; ++c)
+                split = split && planes[c][i] == source[i][c];
+        CHECK(split);
+        std::vector<Pixel> joined(count);
+        interleaveRow(level, planes, count, joined.data());
+        CHECK(joined == source);
+
+        std::vector<Pixel> gray = source;
+        grayscaleRow(SimdLevel::Scalar, gray.data(), count);
+        grayscalePlanes(level, planes[0], planes[1], planes[2], count);
+        interleaveRow(SimdLevel::Scalar, planes, count, joined.data());
+        CHECK(joined == gray);
+
+        std::vector<std::uint8_t> plane(source.size()), expected(source.size());
+        for (std::size_t i = 0; i < count; ++i) {
+            plane[i] = source[i][0];
+            expected[i] = static_cast<std::uint8_t>(std::min(255, std::min(255, plane[i] + add[i]) + 77));
+        }
+        addSaturatedPlane(level, plane.data(), add.data(), count);
+        addConstantSaturatedPlane(level, plane.data(), count, 77);
+        CHECK(plane == expected);
+    }
+}
+
+TEST_CASE("PlanarImage - плоскости каналов дают тот же результат, что и Image") {
+    Image source(203, 157);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x * 5), static_cast<std::uint8_t>(y * 3), static_cast<std::uint8_t>(x ^ y),
+                  static_cast<std::uint8_t>(200 + x % 50)};
+    });
+    PlanarImage planar(source);
+    CHECK(planar.getWidth() == source.getWidth());
+    CHECK(planar.getStride() % Image::kRowAlignment == 0);
+    CHECK(planar.row(2, 10)[7] == source.pixelAt(7, 10)[2]);
+    CHECK(samePixels(planar.toImage(), source));
+
+    for (const char *spec : {"solar,noise:0.3:seed=4,gray", "glitch:seed=9:block=8:chance=0.9:offset=12,wave:7",
+                             "wave:-5,glitch:seed=2:step=3:shift=50,solar"}) {
+        FilterPipeline pipeline;
+        REQUIRE(FilterPipeline::parse(spec, pipeline));
+        Image expected = source;
+        pipeline.apply(expected);
+        PlanarImage processed(source);
+        applyPipeline(processed, pipeline);
+        CHECK_MESSAGE(samePixels(processed.toImage(), expected), spec);
+    }
+
+    Image gray(40, 30, PixelFormat::G8);
+    PlanarImage fromGray(gray);
+    CHECK(samePixels(fromGray.toImage(), gray.convertTo(PixelFormat::RGBA8)));
+
+    REQUIRE(source.save("planar.png"));
+    PlanarImage loaded;
+    REQUIRE(loaded.load("planar.png"));
+    applyGrayscale(loaded);
+    REQUIRE(loaded.save("planar_out.png"));
+    Image saved, expected = source;
+    applyGrayscale(expected);
+    REQUIRE(saved.load("planar_out.png", PixelFormat::RGBA8));
+    CHECK(samePixels(saved, expected));
+    CHECK_FALSE(loaded.load("nonexistent.png"));
+}
+
+// Дописывает чанк PNG с CRC-32 (полином 0xEDB88320).
+static void appendPngChunk(std::vector<std::uint8_t> &out, const char *type, const std::vector<std::uint8_t> &data) {
+    std::vector<std::uint8_t> body(type, type + 4);
+    body.insert(body.end(), data.begin(), data.end());
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (std::uint8_t byte : body) {
+        crc ^= byte;
+        for (int k = 0; k < 8; ++k)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    crc ^= 0xFFFFFFFFu;
+    auto put32 = [&out](std::uint32_t v) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(static_cast<std::uint8_t>(v >> shift));
+    };
+    put32(static_cast<std::uint32_t>(data.size()));
+    out.insert(out.end(), body.begin(), body.end());
+    put32(crc);
+}
+
+// Возвращает содержимое всех IDAT сжатого изображения.
+static std::vector<std::uint8_t> idatOf(const Image &img) {
+    std::vector<std::uint8_t> png, data;
+    SaveOptions options;
+    REQUIRE(img.saveToBuffer(png, options));
+    for (std::size_t pos = 8; pos + 12 <= png.size();) {
+        std::size_t length = (png[pos] << 24) | (png[pos + 1] << 16) | (png[pos + 2] << 8) | png[pos + 3];
+        if (std::memcmp(&png[pos + 4], "IDAT", 4) == 0)
+            data.insert(data.end(), png.begin() + pos + 8, png.begin() + pos + 8 + length);
+        pos += length + 12;
+    }
+    return data;
+}
+
+TEST_CASE("ApngReader/ApngWriter/runSequence - анимированный PNG и каталоги кадров") {
+    std::vector<Image> frames;
+    for (int i = 0; i < 3; ++i) {
+        Image frame(61, 37);
+        forEachPixel(frame, [i](Pixel &p, int x, int y) {
+            p = Pixel{static_cast<std::uint8_t>(x * 4 + i * 50), static_cast<std::uint8_t>(y * 6), static_cast<std::uint8_t>(i * 80),
+                      static_cast<std::uint8_t>(255 - i)};
+        });
+        frames.push_back(frame);
+    }
+    {
+        ApngWriter writer(SaveOptions::fast(), 3);
+        REQUIRE(writer.open("sequence.png"));
+        for (std::size_t i = 0; i < frames.size(); ++i)
+            REQUIRE(writer.add(frames[i], FrameTiming{static_cast<std::uint16_t>(i + 1), 25}));
+        CHECK_FALSE(writer.add(Image(10, 10), FrameTiming{}));
+        CHECK(writer.frameCount() == 3);
+    }
+    ApngReader reader;
+    REQUIRE(reader.open("sequence.png"));
+    CHECK(reader.frameCount() == 3);
+    CHECK(reader.loopCount() == 3);
+    Image frame;
+    FrameTiming timing;
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        REQUIRE(reader.next(frame, timing));
+        CHECK(samePixels(frame, frames[i]));
+        CHECK(timing.delayNum == i + 1);
+        CHECK(timing.delayDen == 25);
+    }
+    CHECK_FALSE(reader.next(frame, timing));
+    Image still;
+    REQUIRE(still.load("sequence.png", PixelFormat::RGBA8));
+    CHECK(samePixels(still, frames[0]));
+
+    // Подкадры: наложение OVER, очистка области (BACKGROUND) и копирование (SOURCE).
+    auto u32 = [](std::vector<std::uint8_t> &v, std::uint32_t x) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            v.push_back(static_cast<std::uint8_t>(x >> shift));
+    };
+    auto control = [&u32](std::uint32_t sequence, int w, int h, int x, int y, std::uint8_t dispose, std::uint8_t blend) {
+        std::vector<std::uint8_t> v;
+        for (std::uint32_t field : {sequence, std::uint32_t(w), std::uint32_t(h), std::uint32_t(x), std::uint32_t(y)})
+            u32(v, field);
+        v.insert(v.end(), {0, 1, 0, 10, dispose, blend});
+        return v;
+    };
+    Image red(8, 8), blue(4, 4), green(2, 2);
+    forEachPixel(red, [](Pixel &p, int, int) { p = Pixel{255, 0, 0, 255}; });
+    forEachPixel(blue, [](Pixel &p, int, int) { p = Pixel{0, 0, 255, 128}; });
+    forEachPixel(green, [](Pixel &p, int, int) { p = Pixel{0, 255, 0, 255}; });
+    std::vector<std::uint8_t> apng = {137, 80, 78, 71, 13, 10, 26, 10}, header, actl, fdat;
+    u32(header, 8);
+    u32(header, 8);
+    header.insert(header.end(), {8, 6, 0, 0, 0});
+    u32(actl, 3);
+    u32(actl, 0);
+    appendPngChunk(apng, "IHDR", header);
+    appendPngChunk(apng, "acTL", actl);
+    appendPngChunk(apng, "fcTL", control(0, 8, 8, 0, 0, 0, 0));
+    appendPngChunk(apng, "IDAT", idatOf(red));
+    appendPngChunk(apng, "fcTL", control(1, 4, 4, 2, 2, 1, 1));
+    u32(fdat, 2);
+    std::vector<std::uint8_t> data = idatOf(blue);
+    fdat.insert(fdat.end(), data.begin(), data.end());
+    appendPngChunk(apng, "fdAT", fdat);
+    appendPngChunk(apng, "fcTL", control(3, 2, 2, 0, 0, 0, 0));
+    fdat.clear();
+    u32(fdat, 4);
+    data = idatOf(green);
+    fdat.insert(fdat.end(), data.begin(), data.end());
+    appendPngChunk(apng, "fdAT", fdat);
+    appendPngChunk(apng, "IEND", {});
+
+    REQUIRE(reader.openFromMemory(apng));
+    REQUIRE(reader.next(frame, timing));
+    CHECK(samePixels(frame, red));
+    REQUIRE(reader.next(frame, timing));
+    CHECK(frame.pixelAt(0, 0) == Pixel{255, 0, 0, 255});
+    CHECK(frame.pixelAt(3, 3) == Pixel{127, 0, 128, 255});
+    REQUIRE(reader.next(frame, timing));
+    CHECK(frame.pixelAt(1, 1) == Pixel{0, 255, 0, 255});
+    CHECK(frame.pixelAt(3, 3) == Pixel{0, 0, 0, 0});
+    CHECK(frame.pixelAt(7, 7) == Pixel{255, 0, 0, 255});
+    apng[40] ^= 1;
+    CHECK_FALSE(reader.openFromMemory(apng));
+
+    // Конвейер: APNG -> каталог кадров -> APNG; таблицы волны общие для всех кадров.
+    FilterPipeline pipeline;
+    REQUIRE(FilterPipeline::parse("solar,wave:6,noise:0.2:seed=5", pipeline));
+    fs::remove_all("sequence_frames");
+    SequenceOptions options;
+    options.input = "sequence.png";
+    options.output = "sequence_frames";
+    options.pipeline = pipeline;
+    options.varySeed = true;
+    SequenceResult result = runSequence(options);
+    REQUIRE(result.ok);
+    CHECK(result.frames == 3);
+    CHECK(cachedWaveField(6.0f, 61, 37) == cachedWaveField(6.0f, 61, 37));
+    CHECK(sequenceFrameName(42) == "frame_00042.png");
+    CHECK(sequenceFrameName(1234567) == "frame_1234567.png");
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        fs::path name = fs::path("sequence_frames") / sequenceFrameName(i);
+        Image expected = frames[i], saved;
+        FilterPipeline shifted;
+        REQUIRE(FilterPipeline::parse("solar,wave:6,noise:0.2:seed=" + std::to_string(5 + i), shifted));
+        shifted.apply(expected);
+        REQUIRE(saved.load(name.string(), PixelFormat::RGBA8));
+        CHECK(samePixels(saved, expected));
+    }
+
+    options.input = "sequence_frames";
+    options.output = "sequence_out.png";
+    options.pipeline = FilterPipeline().add(FilterType::Grayscale);
+    options.varySeed = false;
+    options.timing = FrameTiming{1, 30};
+    result = runSequence(options);
+    REQUIRE(result.ok);
+    CHECK(result.frames == 3);
+    REQUIRE(reader.open("sequence_out.png"));
+    CHECK(reader.frameCount() == 3);
+    REQUIRE(reader.next(frame, timing));
+    CHECK(timing.delayDen == 30);
+    Image first;
+    REQUIRE(first.load("sequence_frames/frame_00000.png", PixelFormat::RGBA8));
+    applyGrayscale(first);
+    CHECK(samePixels(frame, first));
+
+    // Номера без ведущих нулей: 1, 2, 10 идут по значению, а не как строки.
+    fs::remove_all("sequence_numbered");
+    fs::remove_all("sequence_numbered_out");
+    fs::create_directories("sequence_numbered");
+    for (int number : {10, 1, 2}) {
+        Image numbered(5, 4);
+        auto level = static_cast<std::uint8_t>(number * 10);
+        forEachPixel(numbered, [level](Pixel &p) { p = Pixel{level, level, level, 255}; });
+        REQUIRE(numbered.save("sequence_numbered/" + std::to_string(number) + ".png"));
+    }
+    options.input = "sequence_numbered";
+    options.output = "sequence_numbered_out";
+    REQUIRE(runSequence(options).ok);
+    int order = 0;
+    for (int number : {1, 2, 10}) {
+        Image saved;
+        REQUIRE(saved.load("sequence_numbered_out/" + sequenceFrameName(order++), PixelFormat::RGBA8));
+        CHECK(saved.pixelAt(2, 2)[0] == number * 10);
+    }
+
+    options.input = "nonexistent.png";
+    CHECK_FALSE(runSequence(options).ok);
+}
+
+TEST_CASE("remap/DisplacementField - выборка по полю смещений") {
+    const int width = 67, height = 45;
+    Image source(width, height);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x * 3), static_cast<std::uint8_t>(y * 5), static_cast<std::uint8_t>(x ^ y), 255};
+    });
+    auto shiftField = [](int w, int h, float dx, float dy) {
+        return DisplacementField::separable(std::vector<std::int32_t>(w, DisplacementField::toFixed(dx)),
+                                            std::vector<std::int32_t>(w, DisplacementField::toFixed(dy)),
+                                            std::vector<std::int32_t>(h, 0), std::vector<std::int32_t>(h, 0));
+    };
+
+    Image identity = source;
+    remap(identity, DisplacementField(width, height));
+    CHECK(samePixels(identity, source));
+
+    // Целый сдвиг при всех способах обработки краёв.
+    const DisplacementField shift = shiftField(width, height, 3.0f, -2.0f);
+    const Pixel border{9, 8, 7, 6};
+    for (EdgeMode edge : {EdgeMode::Constant, EdgeMode::Clamp, EdgeMode::Wrap}) {
+        Image img = source;
+        remap(img, shift, RemapOptions{SampleMode::Nearest, edge, border});
+        bool same = true;
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x) {
+                int sx = x + 3, sy = y - 2;
+                Pixel expected = border;
+                if (edge == EdgeMode::Clamp)
+                    expected = source.pixelAt(std::clamp(sx, 0, width - 1), std::clamp(sy, 0, height - 1));
+                else if (edge == EdgeMode::Wrap)
+                    expected = source.pixelAt((sx + width) % width, (sy + height) % height);
+                else if (sx < width && sy >= 0)
+                    expected = source.pixelAt(sx, sy);
+                same = same && img.pixelAt(x, y) == expected;
+            }
+        CHECK_MESSAGE(same, static_cast<int>(edge));
+    }
+
+    // Полпикселя по x билинейно — среднее соседей, у правого края Clamp повторяет последний столбец.
+    Image ramp(16, 4);
+    forEachPixel(ramp, [](Pixel &p, int x, int) { p = Pixel{static_cast<std::uint8_t>(x * 4), 100, 0, 255}; });
+    remap(ramp, shiftField(16, 4, 0.5f, 0.0f), RemapOptions{SampleMode::Bilinear, EdgeMode::Clamp});
+    CHECK(ramp.pixelAt(0, 1)[0] == 2);
+    CHECK(ramp.pixelAt(7, 2)[0] == 30);
+    CHECK(ramp.pixelAt(15, 3)[0] == 60);
+    CHECK(ramp.pixelAt(7, 2)[1] == 100);
+
+    // Другие форматы: сдвиг коммутирует с переводом формата.
+    for (PixelFormat format : {PixelFormat::G16, PixelFormat::RGB8}) {
+        Image converted = source.convertTo(format);
+        Image expected = source;
+        remap(converted, shift, RemapOptions{SampleMode::Nearest, EdgeMode::Clamp});
+        remap(expected, shift, RemapOptions{SampleMode::Nearest, EdgeMode::Clamp});
+        CHECK(samePixels(converted, expected.convertTo(format)));
+    }
+
+    // Область: поле отсчитывается от её угла, остальное изображение не меняется.
+    const Region region{10, 5, 30, 20};
+    Image partial = source;
+    remap(partial, shiftField(region.width, region.height, -4.0f, 1.0f), RemapOptions{}, region);
+    bool regionOk = true;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            int rx = x - region.x, ry = y - region.y;
+            Pixel expected = source.pixelAt(x, y);
+            if (rx >= 0 && rx < region.width && ry >= 0 && ry < region.height) {
+                int sx = rx - 4, sy = ry + 1;
+                expected = sx >= 0 && sy < region.height ? source.pixelAt(region.x + sx, region.y + sy)
+                                                         : Pixel{0, 0, 0, 255};
+            }
+            regionOk = regionOk && partial.pixelAt(x, y) == expected;
+        }
+    CHECK(regionOk);
+
+    // Полосы на месте (малый reach) и плитки по копии (большой reach) совпадают с построчным remapRow.
+    int previous = getThreadCount();
+    setThreadCount(3);
+    const DisplacementField ripple = rippleField(width, height, 1.5f, 9.0f);
+    const DisplacementField swirl = swirlField(width, height, 2.5f);
+    CHECK(2 * ripple.reach() * 3 < height);
+    CHECK(2 * swirl.reach() * 3 >= height);
+    CHECK(lensField(width, height, 0.0f).reach() == 0);
+    for (const DisplacementField *field : {&ripple, &swirl}) {
+        for (RemapOptions options : {RemapOptions{SampleMode::Nearest, EdgeMode::Constant, border},
+                                     RemapOptions{SampleMode::Bilinear, EdgeMode::Clamp}}) {
+            Image img = source;
+            remap(img, *field, options);
+            int reach = field->reach();
+            std::vector<const std::uint8_t *> window(2 * reach + 1);
+            std::vector<Pixel> row(width);
+            bool same = true;
+            for (int y = 0; y < height; ++y) {
+                for (int k = 0; k <= 2 * reach; ++k) {
+                    int sy = y - reach + k;
+                    window[k] = sy >= 0 && sy < height ? source.row(sy) : nullptr;
+                }
+                remapRow(PixelFormat::RGBA8, *field, options, reinterpret_cast<std::uint8_t *>(row.data()), y,
+                         window.data());
+                same = same && std::memcmp(row.data(), img.row(y), width * sizeof(Pixel)) == 0;
+            }
+            CHECK(same);
+
+            // Плоскости проходят через тот же сэмплер: на месте и построчно.
+            PlanarImage planar(source);
+            remap(planar, *field, options);
+            CHECK(samePixels(planar.toImage(), img));
+            PlanarImage planarSource(source), planarRow(width, 1);
+            std::vector<PlanarRow> planarWindow(2 * reach + 1);
+            bool samePlanar = true;
+            for (int y = 0; y < height; ++y) {
+                for (int k = 0; k <= 2 * reach; ++k) {
+                    int sy = y - reach + k;
+                    planarWindow[k] = sy >= 0 && sy < height ? planarSource.rowPlanes(sy) : PlanarRow{};
+                }
+                remapRow(*field, options, planarRow.rowPlanes(0), y, planarWindow.data());
+                for (int x = 0; x < width; ++x)
+                    for (int c = 0; c < PlanarImage::kPlanes; ++c)
+                        samePlanar = samePlanar && planarRow.row(c, 0)[x] == img.pixelAt(x, y)[c];
+            }
+            CHECK(samePlanar);
+        }
+    }
+    setThreadCount(previous);
+
+    // Центр завихрения неподвижен, а волна совпадает с applyWaveDistortion.
+    Image swirled = source;
+    remap(swirled, swirl);
+    CHECK(swirled.pixelAt(width / 2, height / 2) == source.pixelAt(width / 2, height / 2));
+    Image waved = source, expectedWave = source;
+    remap(waved, waveField(6.0f, width, height));
+    applyWaveDistortion(expectedWave, 6.0f);
+    CHECK(samePixels(waved, expectedWave));
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("serveStream/serveUnixSocket - запросы к долгоживущему серверу") {
+    Image source(120, 90);
+    forEachPixel(source, [](Pixel &p, int x, int y) {
+        p = Pixel{static_cast<std::uint8_t>(x * 2), static_cast<std::uint8_t>(y * 3), static_cast<std::uint8_t>(x ^ y), 255};
+    });
+    std::vector<std::uint8_t> png;
+    REQUIRE(source.saveToBuffer(png));
+    Span<const std::uint8_t> request(png.data(), png.size());
+
+    ServerOptions options;
+    options.seed = 11;
+    options.save = SaveOptions::fast();
+    const std::string chain = "solar,noise:0.2,wave:4,glitch";
+    FilterPipeline pipeline;
+    REQUIRE(FilterPipeline::parse(chain, pipeline, options.seed));
+    Image expected = source.convertTo(PixelFormat::RGBA8);
+    pipeline.apply(expected);
+
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    bool served = false;
+    std::thread server([&] { served = serveStream(fds[1], fds[1], options); });
+
+    std::vector<std::uint8_t> reply;
+    ServerStatus status = ServerStatus::EncodeError;
+    for (int i = 0; i < 2; ++i) {
+        REQUIRE(sendFilterRequest(fds[0], chain, request, reply, status));
+        CHECK(status == ServerStatus::Ok);
+        Image result;
+        REQUIRE(result.loadFromMemory(Span<const std::uint8_t>(reply.data(), reply.size())));
+        CHECK(samePixels(result, expected));
+    }
+    REQUIRE(sendFilterRequest(fds[0], "blur", request, reply, status));
+    CHECK(status == ServerStatus::BadChain);
+    REQUIRE(sendFilterRequest(fds[0], chain, Span<const std::uint8_t>(png.data(), 100), reply, status));
+    CHECK(status == ServerStatus::BadImage);
+    CHECK_FALSE(reply.empty());
+    shutdown(fds[0], SHUT_WR);
+    server.join();
+    CHECK(served);
+    close(fds[0]);
+    close(fds[1]);
+
+    fs::path path = fs::temp_directory_path() / "image_filters_test.sock";
+    std::atomic<bool> stop{false};
+    bool listening = false;
+    std::thread daemon([&] { listening = serveUnixSocket(path.string(), options, &stop); });
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(client >= 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    bool connected = false;
+    for (int attempt = 0; attempt < 200 && !connected; ++attempt) {
+        connected = connect(client, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+        if (!connected)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(connected);
+    REQUIRE(sendFilterRequest(client, chain, request, reply, status));
+    CHECK(status == ServerStatus::Ok);
+    stop = true;
+    daemon.join();
+    CHECK(listening);
+    CHECK_FALSE(fs::exists(path));
+    close(client);
+}
+#endif